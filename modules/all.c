@@ -23,12 +23,22 @@
 #include "vlock_plugin.h"
 #include "console_switch.h"
 
-bool vlock_start(void __attribute__((unused)) **ctx_ptr)
+static bool console_start(void __attribute__((unused)) **ctx_ptr)
 {
   return lock_console_switch();
 }
 
-bool vlock_end(void __attribute__((unused)) **ctx_ptr)
+static bool console_end(void __attribute__((unused)) **ctx_ptr)
 {
   return unlock_console_switch();
 }
+
+/* Console switching is disabled before the terminal is secured. */
+const struct vlock_module_descriptor vlock_module_descriptor = {
+  .abi_version = VLOCK_MODULE_ABI_VERSION,
+  .capabilities = VLOCK_MODULE_LOCK_CRITICAL,
+  .hooks = {
+    [VLOCK_HOOK_START] = console_start,
+    [VLOCK_HOOK_END] = console_end,
+  },
+};
@@ -31,6 +31,7 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -84,7 +85,16 @@ void handle_sigterm(int __attribute__((unused)) signum)
 
 static int caca_main(void *argument);
 
-bool vlock_save(void **ctx_ptr)
+/* The PID of a killed screen saver that was not collected yet or 0. */
+static pid_t dead_child = 0;
+
+static void reap_dead_child(int options)
+{
+  if (dead_child > 0 && waitpid(dead_child, NULL, options) != 0)
+    dead_child = 0;
+}
+
+static bool caca_save(void **ctx_ptr)
 {
   static struct child_process child = {
     .function = caca_main,
@@ -92,12 +102,15 @@ bool vlock_save(void **ctx_ptr)
     .stdin_fd = REDIRECT_DEV_NULL,
     .stdout_fd = NO_REDIRECT,
     .stderr_fd = NO_REDIRECT,
+    .background = true,
   };
 
+  reap_dead_child(WNOHANG);
+
   /* Initialize ncurses. */
   initscr();
 
-  if (!create_child(&child))
+  if (!create_child(&child, NULL))
     return false;
 
   *ctx_ptr = &child;
@@ -105,12 +118,16 @@ bool vlock_save(void **ctx_ptr)
   return true;
 }
 
-bool vlock_save_abort(void **ctx_ptr)
+static bool caca_save_abort(void **ctx_ptr)
 {
   struct child_process *child = *ctx_ptr;
 
   if (child != NULL) {
-    ensure_death(child->pid);
+    /* Do not wait for the demo to finish its frame and clean up, it would
+     * only draw over the prompt.  It is collected later. */
+    (void) kill(child->pid, SIGKILL);
+    reap_dead_child(0);
+    dead_child = child->pid;
     /* Restore sane terminal and uninitialize ncurses. */
     curs_set(1);
     refresh();
@@ -121,6 +138,22 @@ bool vlock_save_abort(void **ctx_ptr)
   return true;
 }
 
+static bool caca_end(void __attribute__((unused)) **ctx_ptr)
+{
+  reap_dead_child(0);
+  return true;
+}
+
+const struct vlock_module_descriptor vlock_module_descriptor = {
+  .abi_version = VLOCK_MODULE_ABI_VERSION,
+  .capabilities = VLOCK_MODULE_DISPLAY,
+  .hooks = {
+    [VLOCK_HOOK_END] = caca_end,
+    [VLOCK_HOOK_SAVE] = caca_save,
+    [VLOCK_HOOK_SAVE_ABORT] = caca_save_abort,
+  },
+};
+
 static int caca_main(void __attribute__((unused)) *argument)
 {
     static caca_display_t *dp;
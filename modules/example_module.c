@@ -23,13 +23,10 @@
 #include "vlock_plugin.h"
 
 /* Declare dependencies.  Please see PLUGINS for their meaning.  Empty
- * dependencies can be left out. */
-const char *preceeds[] = { "new", "all", NULL };
-/* const char *succeeds[]; */
-/* const char *requires[]; */
-/* const char *needs[]; */
-const char *depends[] = { "all", NULL };
-/* const char *conflicts[]; */
+ * dependencies can be left out of the descriptor at the end of this
+ * file. */
+static const char *const example_preceeds[] = { "new", "all", NULL };
+static const char *const example_depends[] = { "all", NULL };
 
 /* Every hook has a void** argument ctx_ptr.  When they are called
  * ctx_ptr points to the same location and *ctx_ptr is initially set to
@@ -45,7 +42,7 @@ struct example_context {
 
 /* Do something that should happen at vlock's start here.  An error in
  * this hook aborts vlock. */
-bool vlock_start(void **ctx_ptr)
+static bool example_start(void **ctx_ptr)
 {
   struct example_context *ctx = malloc(sizeof *ctx);
 
@@ -61,18 +58,18 @@ bool vlock_start(void **ctx_ptr)
   return true;
 }
 
-/* Hooks that are not implemented should not be defined. */
+/* Hooks that are not implemented should be left out of the descriptor. */
 
 /* Start a screensaver type action before the password prompt after a
  * timeout.  This hook must not block! */
-/* bool vlock_save(void **); */
+/* static bool example_save(void **); */
 
 /* Abort a screensaver type action before the password prompt after a
  * timeout.  This hook must not block! */
-/* bool vlock_save_abort(void **); */
+/* static bool example_save_abort(void **); */
 
 /* Do something at the end of vlock.  Error returns are ignored here. */
-bool vlock_end(void **ctx_ptr)
+static bool example_end(void **ctx_ptr)
 {
   struct example_context *ctx = *ctx_ptr;
   bool result = true;
@@ -88,3 +85,19 @@ bool vlock_end(void **ctx_ptr)
 
   return result;
 }
+
+/* Export everything through a single descriptor.  Its name and layout are
+ * defined by vlock_plugin.h.  The capabilities tell vlock that the hooks may
+ * run on another thread and that the (missing) save hooks are cheap. */
+const struct vlock_module_descriptor vlock_module_descriptor = {
+  .abi_version = VLOCK_MODULE_ABI_VERSION,
+  .capabilities = VLOCK_MODULE_THREAD_SAFE | VLOCK_MODULE_CHEAP_SAVE,
+  .hooks = {
+    [VLOCK_HOOK_START] = example_start,
+    [VLOCK_HOOK_END] = example_end,
+  },
+  .dependencies = {
+    [VLOCK_DEPENDENCY_PRECEEDS] = example_preceeds,
+    [VLOCK_DEPENDENCY_DEPENDS] = example_depends,
+  },
+};
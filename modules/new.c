@@ -29,8 +29,8 @@
 
 #include "vlock_plugin.h"
 
-const char *preceeds[] = { "all", NULL };
-const char *requires[] = { "all", NULL };
+static const char *const new_preceeds[] = { "all", NULL };
+static const char *const new_requires[] = { "all", NULL };
 
 /* name of the virtual console device */
 #if defined(__FreeBSD__) || defined(__FreeBSD_kernel__)
@@ -118,7 +118,7 @@ struct new_console_context {
 };
 
 /* Run switch to a new console and redirect stdio there. */
-bool vlock_start(void **ctx_ptr)
+static bool new_start(void **ctx_ptr)
 {
   struct new_console_context *ctx;
   int vtfd;
@@ -204,7 +204,7 @@ err:
 }
 
 /* Redirect stdio back und switch to the previous console. */
-bool vlock_end(void **ctx_ptr)
+static bool new_end(void **ctx_ptr)
 {
   struct new_console_context *ctx = *ctx_ptr;
 
@@ -231,3 +231,17 @@ bool vlock_end(void **ctx_ptr)
 
   return true;
 }
+
+/* The new console must be active before the terminal is secured. */
+const struct vlock_module_descriptor vlock_module_descriptor = {
+  .abi_version = VLOCK_MODULE_ABI_VERSION,
+  .capabilities = VLOCK_MODULE_LOCK_CRITICAL,
+  .hooks = {
+    [VLOCK_HOOK_START] = new_start,
+    [VLOCK_HOOK_END] = new_end,
+  },
+  .dependencies = {
+    [VLOCK_DEPENDENCY_PRECEEDS] = new_preceeds,
+    [VLOCK_DEPENDENCY_REQUIRES] = new_requires,
+  },
+};
@@ -19,8 +19,8 @@
 
 #include "vlock_plugin.h"
 
-const char *preceeds[] = { "new", "all", NULL };
-const char *depends[] = { "all", NULL };
+static const char *const sysrq_preceeds[] = { "new", "all", NULL };
+static const char *const sysrq_depends[] = { "all", NULL };
 
 #define SYSRQ_PATH "/proc/sys/kernel/sysrq"
 #define SYSRQ_DISABLE_VALUE "0\n"
@@ -31,7 +31,7 @@ struct sysrq_context {
 };
 
 /* Disable SysRq and save old value in context. */
-bool vlock_start(void **ctx_ptr)
+static bool sysrq_start(void **ctx_ptr)
 {
   struct sysrq_context *ctx;
 
@@ -92,7 +92,7 @@ err:
 
 
 /* Restore old SysRq value. */
-bool vlock_end(void **ctx_ptr)
+static bool sysrq_end(void **ctx_ptr)
 {
   struct sysrq_context *ctx = *ctx_ptr;
 
@@ -108,3 +108,17 @@ bool vlock_end(void **ctx_ptr)
   free(ctx);
   return true;
 }
+
+/* SysRq is disabled before the terminal is secured. */
+const struct vlock_module_descriptor vlock_module_descriptor = {
+  .abi_version = VLOCK_MODULE_ABI_VERSION,
+  .capabilities = VLOCK_MODULE_LOCK_CRITICAL,
+  .hooks = {
+    [VLOCK_HOOK_START] = sysrq_start,
+    [VLOCK_HOOK_END] = sysrq_end,
+  },
+  .dependencies = {
+    [VLOCK_DEPENDENCY_PRECEEDS] = sysrq_preceeds,
+    [VLOCK_DEPENDENCY_DEPENDS] = sysrq_depends,
+  },
+};
@@ -19,17 +19,31 @@
 
 #include "vlock_plugin.h"
 
-const char *depends[] = { "all", NULL };
-const char *conflicts[] = { "blank", NULL };
+static const char *const blank_depends[] = { "all", NULL };
+static const char *const blank_conflicts[] = { "blank", NULL };
 
-bool vlock_save(void __attribute__ ((__unused__)) ** ctx)
+static bool blank_save(void __attribute__ ((__unused__)) ** ctx)
 {
   char arg[] = { TIOCL_SETVESABLANK, 2 };
   return ioctl(STDIN_FILENO, TIOCLINUX, arg) == 0;
 }
 
-bool vlock_save_abort(void __attribute__ ((__unused__)) ** ctx)
+static bool blank_save_abort(void __attribute__ ((__unused__)) ** ctx)
 {
   char arg[] = { TIOCL_SETVESABLANK, 0 };
   return ioctl(STDIN_FILENO, TIOCLINUX, arg) == 0;
 }
+
+/* The monitor is powered up again before the prompt is shown. */
+const struct vlock_module_descriptor vlock_module_descriptor = {
+  .abi_version = VLOCK_MODULE_ABI_VERSION,
+  .capabilities = VLOCK_MODULE_CHEAP_SAVE | VLOCK_MODULE_DISPLAY,
+  .hooks = {
+    [VLOCK_HOOK_SAVE] = blank_save,
+    [VLOCK_HOOK_SAVE_ABORT] = blank_save_abort,
+  },
+  .dependencies = {
+    [VLOCK_DEPENDENCY_DEPENDS] = blank_depends,
+    [VLOCK_DEPENDENCY_CONFLICTS] = blank_conflicts,
+  },
+};
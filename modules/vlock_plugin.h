@@ -12,6 +12,37 @@
  */
 #include <stdbool.h>
 
+/* When a module is compiled into vlock-main (see --with-builtin-modules) all
+ * of its symbols are prefixed with "vlock_builtin_<module>_" so that several
+ * modules can be linked together.  VLOCK_BUILTIN_MODULE is set to the name of
+ * the module by the Makefile. */
+#ifdef VLOCK_BUILTIN_MODULE
+#define VLOCK_BUILTIN_SYMBOL(module, symbol) \
+  VLOCK_BUILTIN_SYMBOL_(module, symbol)
+#define VLOCK_BUILTIN_SYMBOL_(module, symbol) \
+  vlock_builtin_ ## module ## _ ## symbol
+
+#define preceeds VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, preceeds)
+#define succeeds VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, succeeds)
+#define requires VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, requires)
+#define needs VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, needs)
+#define depends VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, depends)
+#define conflicts VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, conflicts)
+
+#define vlock_start VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, vlock_start)
+#define vlock_end VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, vlock_end)
+#define vlock_save VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, vlock_save)
+#define vlock_save_abort \
+  VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, vlock_save_abort)
+
+#define vlock_module_descriptor \
+  VLOCK_BUILTIN_SYMBOL(VLOCK_BUILTIN_MODULE, vlock_module_descriptor)
+#endif
+
+/* Module ABI version 1:  every dependency and every hook is a separate global
+ * symbol with the names below.  Only the symbols that are needed have to be
+ * defined. */
+
 extern const char *preceeds[];
 extern const char *succeeds[];
 extern const char *requires[];
@@ -23,3 +54,89 @@ bool vlock_start(void **);
 bool vlock_end(void **);
 bool vlock_save(void **);
 bool vlock_save_abort(void **);
+
+/* Module ABI version 2:  the module exports a single descriptor that holds
+ * everything vlock needs, so loading it takes one symbol lookup and the
+ * dependency arrays are used in place.  If a module defines
+ * vlock_module_descriptor the version 1 symbols are ignored. */
+#define VLOCK_MODULE_ABI_VERSION 2
+
+/* Indices into the hook table. */
+enum vlock_hook_id {
+  VLOCK_HOOK_START,
+  VLOCK_HOOK_END,
+  VLOCK_HOOK_SAVE,
+  VLOCK_HOOK_SAVE_ABORT,
+  VLOCK_NR_HOOKS
+};
+
+/* Indices into the dependency table. */
+enum vlock_dependency_id {
+  VLOCK_DEPENDENCY_SUCCEEDS,
+  VLOCK_DEPENDENCY_PRECEEDS,
+  VLOCK_DEPENDENCY_REQUIRES,
+  VLOCK_DEPENDENCY_NEEDS,
+  VLOCK_DEPENDENCY_DEPENDS,
+  VLOCK_DEPENDENCY_CONFLICTS,
+  VLOCK_NR_DEPENDENCIES
+};
+
+/* Capability flags. */
+/* The hooks may be called from a thread other than the main thread. */
+#define VLOCK_MODULE_THREAD_SAFE (1 << 0)
+/* vlock_save and vlock_save_abort return quickly and may be called often. */
+#define VLOCK_MODULE_CHEAP_SAVE (1 << 1)
+/* The module draws on or blanks the screen while the terminal is locked.  Its
+ * vlock_save_abort hook is called before the prompt is shown and must not
+ * wait, e.g. for a screen saver process to exit. */
+#define VLOCK_MODULE_DISPLAY (1 << 2)
+/* The terminal is not locked before the module's vlock_start hook succeeded,
+ * e.g. because it disables console switching.  vlock_start hooks of other
+ * modules are called after the terminal was secured and the lock message was
+ * shown, and their failure does not stop vlock. */
+#define VLOCK_MODULE_LOCK_CRITICAL (1 << 3)
+
+/* Asynchronous hooks start an action that may take long, e.g. fading a
+ * backlight, and return at once.  They return a file descriptor that becomes
+ * readable (or is hung up) when the action is finished, or one of these: */
+/* The action is already finished successfully. */
+#define VLOCK_ASYNC_DONE (-1)
+/* The action could not be started. */
+#define VLOCK_ASYNC_FAILED (-2)
+
+/* vlock waits for the file descriptor together with those of the other
+ * plugins' hooks and then calls async_finish with cancelled set to false.  If
+ * the action is not finished before the timeout, or for vlock_save when a key
+ * is pressed, async_finish is called with cancelled set to true and should
+ * stop the action.  In both cases async_finish must close the file descriptor
+ * and returns the result of the hook.  Hooks of later plugins do not wait for
+ * asynchronous hooks of earlier plugins. */
+#define VLOCK_ASYNC_DEFAULT_TIMEOUT 5000
+
+struct vlock_module_descriptor
+{
+  /* Must be VLOCK_MODULE_ABI_VERSION. */
+  unsigned int abi_version;
+
+  /* Bitwise or of the capability flags. */
+  unsigned int capabilities;
+
+  /* Hook functions or NULL for unimplemented hooks. */
+  bool (*hooks[VLOCK_NR_HOOKS])(void **);
+
+  /* NULL terminated arrays of plugin names or NULL for empty lists. */
+  const char *const *dependencies[VLOCK_NR_DEPENDENCIES];
+
+  /* Asynchronous hook functions or NULL.  If a hook is given here the entry
+   * in hooks is ignored. */
+  int (*async_hooks[VLOCK_NR_HOOKS])(void **);
+
+  /* Must be given if there are asynchronous hooks. */
+  bool (*async_finish)(void **, enum vlock_hook_id, bool cancelled);
+
+  /* Milliseconds to wait for an asynchronous hook or 0 for
+   * VLOCK_ASYNC_DEFAULT_TIMEOUT. */
+  unsigned int async_timeout;
+};
+
+extern const struct vlock_module_descriptor vlock_module_descriptor;
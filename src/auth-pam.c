@@ -51,6 +51,8 @@
 
 #include "auth.h"
 #include "prompt.h"
+#include "output.h"
+#include "trace.h"
 
 GQuark vlock_auth_error_quark(void)
 {
@@ -102,9 +104,10 @@ static int conversation(int num_msg, const struct pam_message **msg, struct
       case PAM_ERROR_MSG:
         {
           size_t msg_len = strlen(msg[i]->msg);
-          (void) fputs(msg[i]->msg, stderr);
+          /* The message is not ours to keep. */
+          output_printf("%s", msg[i]->msg);
           if (msg_len > 0 && msg[i]->msg[msg_len - 1] != '\n')
-            (void) fputc('\n', stderr);
+            output_add("\n");
         }
         break;
       default:
@@ -180,16 +183,17 @@ bool auth(const char *user, struct timespec *timeout, const char *vlock_password
 
   /* Print vlock password prompt message if there is one. */
   if (vlock_password_prompt_message && *vlock_password_prompt_message) {
-    fputs(vlock_password_prompt_message, stderr);
-    fputc('\n', stderr);
+    output_add(vlock_password_prompt_message);
+    output_add("\n");
   }
 
   /* put the username before the password prompt */
-  fprintf(stderr, "%s's ", user);
-  fflush(stderr);
+  output_printf("%s's ", user);
 
   /* authenticate the user */
+  VLOCK_PROBE1(auth__begin, user);
   pam_status = pam_authenticate(pamh, 0);
+  VLOCK_PROBE2(auth__end, user, pam_status == PAM_SUCCESS);
 
   if (pam_status == PAM_CONV_ERR ||
 	     pam_status == PAM_AUTH_ERR ||
@@ -32,13 +32,16 @@
 
 #include "auth.h"
 #include "prompt.h"
+#include "output.h"
+#include "trace.h"
 
 GQuark vlock_auth_error_quark(void)
 {
   return g_quark_from_static_string("vlock-auth-shadow-error-quark");
 }
 
-bool auth(const char *user, struct timespec *timeout, GError **error)
+bool auth(const char *user, struct timespec *timeout,
+          const char *vlock_password_prompt_message, GError **error)
 {
   char *pwd;
   char *cryptpw;
@@ -48,6 +51,12 @@ bool auth(const char *user, struct timespec *timeout, GError **error)
 
   g_return_val_if_fail(error == NULL || *error == NULL, false);
 
+  /* Print vlock password prompt message if there is one. */
+  if (vlock_password_prompt_message && *vlock_password_prompt_message) {
+    output_add(vlock_password_prompt_message);
+    output_add("\n");
+  }
+
   /* format the prompt */
   if (asprintf(&msg, "%s's Password: ", user) < 0) {
     g_propagate_error(error,
@@ -61,6 +70,8 @@ bool auth(const char *user, struct timespec *timeout, GError **error)
   if ((pwd = prompt_echo_off(msg, timeout, error)) == NULL)
     goto prompt_error;
 
+  VLOCK_PROBE1(auth__begin, user);
+
   errno = 0;
 
   /* get the shadow password */
@@ -102,6 +113,8 @@ shadow_error:
   /* deallocate shadow resources */
   endspent();
 
+  VLOCK_PROBE2(auth__end, user, result);
+
   /* free the password */
   free(pwd);
 
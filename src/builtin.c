@@ -0,0 +1,141 @@
+/* builtin.c -- built-in modules for vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Modules selected with --with-builtin-modules are compiled into vlock-main
+ * with their symbols renamed (see vlock_plugin.h).  This file collects them in
+ * a static table that is searched before the module directory.
+ *
+ * The Makefile defines VLOCK_BUILTIN_MODULES as a list of
+ * BUILTIN(name, restricted) entries.  The symbols are declared weak because
+ * modules only define the hooks and dependencies they need or only a
+ * descriptor. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <grp.h>
+#include <sys/types.h>
+
+#include <glib.h>
+
+#include "builtin.h"
+
+#ifndef VLOCK_BUILTIN_MODULES
+#define VLOCK_BUILTIN_MODULES
+#endif
+
+#define BUILTIN_SYMBOL(module, symbol) vlock_builtin_ ## module ## _ ## symbol
+
+#define BUILTIN_HOOK(module, hook) \
+  extern bool BUILTIN_SYMBOL(module, hook)(void **) __attribute__((weak));
+#define BUILTIN_DEPENDENCY(module, dependency) \
+  extern const char *BUILTIN_SYMBOL(module, dependency)[] __attribute__((weak));
+#define BUILTIN_DESCRIPTOR(module) \
+  extern const struct vlock_module_descriptor \
+    BUILTIN_SYMBOL(module, vlock_module_descriptor) __attribute__((weak));
+
+/* Declare the symbols of all built-in modules. */
+#define BUILTIN(module, restricted) \
+  BUILTIN_HOOK(module, vlock_start) \
+  BUILTIN_HOOK(module, vlock_end) \
+  BUILTIN_HOOK(module, vlock_save) \
+  BUILTIN_HOOK(module, vlock_save_abort) \
+  BUILTIN_DEPENDENCY(module, succeeds) \
+  BUILTIN_DEPENDENCY(module, preceeds) \
+  BUILTIN_DEPENDENCY(module, requires) \
+  BUILTIN_DEPENDENCY(module, needs) \
+  BUILTIN_DEPENDENCY(module, depends) \
+  BUILTIN_DEPENDENCY(module, conflicts) \
+  BUILTIN_DESCRIPTOR(module)
+
+VLOCK_BUILTIN_MODULES
+
+#undef BUILTIN
+
+/* The order of the hooks and dependencies must match the global arrays hooks
+ * and dependency_names in plugins.c. */
+#define BUILTIN(module, is_restricted) \
+  { \
+    .name = #module, \
+    .restricted = is_restricted, \
+    .descriptor = &BUILTIN_SYMBOL(module, vlock_module_descriptor), \
+    .hooks = { \
+      BUILTIN_SYMBOL(module, vlock_start), \
+      BUILTIN_SYMBOL(module, vlock_end), \
+      BUILTIN_SYMBOL(module, vlock_save), \
+      BUILTIN_SYMBOL(module, vlock_save_abort), \
+    }, \
+    .dependencies = { \
+      BUILTIN_SYMBOL(module, succeeds), \
+      BUILTIN_SYMBOL(module, preceeds), \
+      BUILTIN_SYMBOL(module, requires), \
+      BUILTIN_SYMBOL(module, needs), \
+      BUILTIN_SYMBOL(module, depends), \
+      BUILTIN_SYMBOL(module, conflicts), \
+    }, \
+  },
+
+static const struct builtin_module builtin_modules[] = {
+  VLOCK_BUILTIN_MODULES
+  { .name = NULL },
+};
+
+#undef BUILTIN
+
+const struct builtin_module *find_builtin_module(const char *name)
+{
+  for (size_t i = 0; builtin_modules[i].name != NULL; i++)
+    if (strcmp(builtin_modules[i].name, name) == 0)
+      return &builtin_modules[i];
+
+  return NULL;
+}
+
+/* Check if the real user is a member of the vlock group.  This is the same
+ * check access() does for the shared modules which are only readable by that
+ * group. */
+static bool in_vlock_group(void)
+{
+  struct group *gr = getgrnam(VLOCK_GROUP);
+  gid_t *groups;
+  int nr_groups;
+  bool result = false;
+
+  if (gr == NULL)
+    return false;
+
+  if (getgid() == gr->gr_gid)
+    return true;
+
+  nr_groups = getgroups(0, NULL);
+
+  if (nr_groups <= 0)
+    return false;
+
+  groups = g_new(gid_t, nr_groups);
+  nr_groups = getgroups(nr_groups, groups);
+
+  for (int i = 0; i < nr_groups; i++)
+    if (groups[i] == gr->gr_gid) {
+      result = true;
+      break;
+    }
+
+  g_free(groups);
+
+  return result;
+}
+
+bool builtin_module_accessible(const struct builtin_module *module)
+{
+  return !module->restricted || getuid() == 0 || in_vlock_group();
+}
@@ -0,0 +1,48 @@
+/* builtin.h -- header file for the built-in modules of vlock,
+ *              the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "plugin.h"
+
+struct vlock_module_descriptor;
+
+/* A module that is compiled into vlock-main. */
+struct builtin_module
+{
+  const char *name;
+
+  /* Only members of the vlock group (and root) may use restricted modules.
+   * For shared modules the same is enforced by the file permissions. */
+  bool restricted;
+
+  /* Descriptor of a version 2 module or NULL.  If it is set the hooks and
+   * dependencies below are unused. */
+  const struct vlock_module_descriptor *descriptor;
+
+  /* Hook functions in the same order as the global hooks.  Unimplemented hooks
+   * are NULL. */
+  bool (*hooks[nr_hooks])(void **);
+
+  /* Dependencies in the same order as the global dependency names.
+   * Unspecified dependencies are NULL. */
+  const char **dependencies[nr_dependencies];
+};
+
+/* Find the named built-in module.  Returns NULL if there is no such module. */
+const struct builtin_module *find_builtin_module(const char *name);
+
+/* Check if the user who started vlock may use the given module. */
+bool builtin_module_accessible(const struct builtin_module *module);
@@ -0,0 +1,160 @@
+/* cgroup.c -- cgroup routines for vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <glib.h>
+
+#include "process.h"
+#include "cgroup.h"
+
+/* Write the string to the given file of the cgroup. */
+static bool write_file(const char *path, const char *name, const char *s)
+{
+  char *file = g_strdup_printf("%s/%s", path, name);
+  int fd = open(file, O_WRONLY);
+  bool result = false;
+
+  g_free(file);
+
+  if (fd < 0)
+    return false;
+
+  result = write(fd, s, strlen(s)) == (ssize_t) strlen(s);
+  (void) close(fd);
+
+  return result;
+}
+
+/* Read the given file of the cgroup into the buffer. */
+static bool read_file(const char *path, const char *name, char *buffer,
+                      size_t size)
+{
+  char *file = g_strdup_printf("%s/%s", path, name);
+  int fd = open(file, O_RDONLY);
+  ssize_t length;
+
+  g_free(file);
+
+  if (fd < 0)
+    return false;
+
+  length = read(fd, buffer, size - 1);
+  (void) close(fd);
+
+  if (length < 0)
+    return false;
+
+  buffer[length] = '\0';
+  return true;
+}
+
+char *cgroup_create(const char *base,
+                    const char *name,
+                    const struct child_limits *limits)
+{
+  char *path = g_strdup_printf("%s/vlock-%d-%s", base, (int) getpid(), name);
+
+  if (mkdir(path, 0755) < 0) {
+    g_free(path);
+    return NULL;
+  }
+
+  /* The controllers may not be enabled for the delegated cgroup.  The
+   * limits from setrlimit() still apply then. */
+  if (limits != NULL) {
+    char value[32];
+
+    if (limits->memory_kb > 0) {
+      (void) snprintf(value, sizeof value, "%llu",
+                      (unsigned long long) limits->memory_kb * 1024);
+      (void) write_file(path, "memory.max", value);
+    }
+
+    if (limits->cpu_percent > 0) {
+      /* Microseconds per period of 100ms. */
+      (void) snprintf(value, sizeof value, "%lu 100000",
+                      limits->cpu_percent * 1000);
+      (void) write_file(path, "cpu.max", value);
+    }
+
+    if (limits->processes > 0) {
+      (void) snprintf(value, sizeof value, "%lu", limits->processes);
+      (void) write_file(path, "pids.max", value);
+    }
+  }
+
+  return path;
+}
+
+bool cgroup_get_usage(const char *path, struct child_usage *usage)
+{
+  char buffer[4096];
+  const char *p;
+
+  if (!read_file(path, "cpu.stat", buffer, sizeof buffer)
+      || (p = strstr(buffer, "usage_usec ")) == NULL)
+    return false;
+
+  usage->cpu_usec = strtoull(p + strlen("usage_usec "), NULL, 10);
+  usage->peak_rss_kb = 0;
+  usage->processes = 0;
+
+  /* memory.peak is missing before Linux 5.19 and without the memory
+   * controller. */
+  if (read_file(path, "memory.peak", buffer, sizeof buffer))
+    usage->peak_rss_kb = strtoull(buffer, NULL, 10) / 1024;
+
+  if (read_file(path, "pids.peak", buffer, sizeof buffer))
+    usage->processes = strtoul(buffer, NULL, 10);
+  else if (read_file(path, "cgroup.procs", buffer, sizeof buffer))
+    for (p = buffer; (p = strchr(p, '\n')) != NULL; p++)
+      usage->processes++;
+
+  return true;
+}
+
+void cgroup_destroy(const char *path)
+{
+  /* cgroup.kill is missing before Linux 5.14.  Processes that are forked
+   * while they are killed one by one may survive, so try a few times. */
+  for (int i = 0; i < 10; i++) {
+    if (rmdir(path) == 0 || errno != EBUSY)
+      return;
+
+    if (!write_file(path, "cgroup.kill", "1")) {
+      char buffer[4096];
+
+      if (read_file(path, "cgroup.procs", buffer, sizeof buffer))
+        for (char *p = buffer; *p != '\0';) {
+          pid_t pid = strtol(p, &p, 10);
+
+          if (pid > 0)
+            (void) kill(pid, SIGKILL);
+          else
+            break;
+        }
+    }
+
+    /* The cgroup is busy until the killed processes are reaped. */
+    (void) usleep(10000);
+  }
+}
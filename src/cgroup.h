@@ -0,0 +1,40 @@
+/* cgroup.h -- header file for the cgroup routines of vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Script plugins may each be run in their own cgroup below a cgroup v2
+ * directory that was delegated to the user, e.g. by systemd.  The cgroup
+ * accounts for every process the script starts, even ones that left its
+ * process group, and all of them are killed together when the plugin is
+ * destroyed.  Nothing here is required, if the cgroup cannot be used the
+ * process group is all that remains. */
+
+#pragma once
+
+#include <stdbool.h>
+
+struct child_limits;
+struct child_usage;
+
+/* Create the cgroup "vlock-<pid>-<name>" below the given directory and apply
+ * the memory, CPU quota and process limits, if any.  Returns the path of the
+ * new cgroup or NULL if it could not be created.  The result must be freed
+ * with g_free(). */
+char *cgroup_create(const char *base,
+                    const char *name,
+                    const struct child_limits *limits);
+
+/* Read the resource usage of the cgroup with the given path. */
+bool cgroup_get_usage(const char *path, struct child_usage *usage);
+
+/* Kill all processes in the cgroup with the given path and remove it. */
+void cgroup_destroy(const char *path);
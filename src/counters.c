@@ -0,0 +1,82 @@
+/* counters.c -- resource counters for vlock,
+ *               the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "counters.h"
+
+const char *vlock_phase_names[VLOCK_NR_PHASES] = {
+  "startup",
+  "locked-idle",
+  "save",
+  "auth",
+  "teardown",
+};
+
+const char *vlock_counter_names[VLOCK_NR_COUNTERS] = {
+  "spawns",
+  "termios",
+  "hooks",
+  "wakeups",
+  "terminal-bytes",
+  "suppressed-saves",
+};
+
+static struct vlock_counters private_counters;
+static struct vlock_counters *counters = &private_counters;
+
+/* The counters may live in shared memory that is read by other processes
+ * without locking, so every value is written atomically.  vlock-main is the
+ * only writer. */
+
+void counters_set_phase(enum vlock_phase phase)
+{
+  __atomic_store_n(&counters->phase, phase, __ATOMIC_RELAXED);
+}
+
+void counters_add(enum vlock_counter counter, uint64_t n)
+{
+  uint64_t *count = &counters->counts[counters->phase][counter];
+
+  __atomic_store_n(count, *count + n, __ATOMIC_RELAXED);
+}
+
+void counters_attach(struct vlock_counters *storage)
+{
+  if (storage == NULL)
+    storage = &private_counters;
+
+  if (storage != counters) {
+    memcpy(storage, counters, sizeof *storage);
+    counters = storage;
+  }
+}
+
+void counters_get(struct vlock_counters *snapshot)
+{
+  memcpy(snapshot, counters, sizeof *snapshot);
+}
+
+void counters_print(FILE *file)
+{
+  for (size_t i = 0; i < VLOCK_NR_PHASES; i++) {
+    fprintf(file, "vlock: counters %s", vlock_phase_names[i]);
+
+    for (size_t j = 0; j < VLOCK_NR_COUNTERS; j++)
+      fprintf(file, " %s=%" PRIu64, vlock_counter_names[j],
+              counters->counts[i][j]);
+
+    fputc('\n', file);
+  }
+}
@@ -0,0 +1,89 @@
+/* counters.h -- header file for the resource counters of vlock,
+ *               the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* vlock-main counts the work it does, split by the phase of the lock session
+ * it happens in.  While the terminal is locked and nobody touches it nothing
+ * should be counted at all.  The counters are published on the status page
+ * (see status.h) and printed on exit if VLOCK_DEBUG is set. */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Phases of a lock session. */
+enum vlock_phase
+{
+  /* Loading plugins and securing the terminal. */
+  VLOCK_PHASE_STARTUP,
+  /* Waiting for the user to press enter or escape. */
+  VLOCK_PHASE_LOCKED_IDLE,
+  /* From deciding to save the screen, e.g. after escape was pressed, until
+   * the vlock_save_abort hooks returned. */
+  VLOCK_PHASE_SAVE,
+  /* Prompting for and checking the password. */
+  VLOCK_PHASE_AUTH,
+  /* Everything after the terminal was unlocked or vlock-main was killed. */
+  VLOCK_PHASE_TEARDOWN,
+  VLOCK_NR_PHASES
+};
+
+enum vlock_counter
+{
+  /* Processes started with create_child(). */
+  VLOCK_COUNTER_SPAWNS,
+  /* tcgetattr(), tcsetattr() and tcflush() calls. */
+  VLOCK_COUNTER_TERMIOS,
+  /* Plugin hooks called. */
+  VLOCK_COUNTER_HOOKS,
+  /* Returns from select(), including timeouts and interruptions.  The key
+   * press that ends a phase is counted in that phase. */
+  VLOCK_COUNTER_WAKEUPS,
+  /* Bytes vlock-main itself wrote to the terminal. */
+  VLOCK_COUNTER_TERMINAL_BYTES,
+  /* Saves that were cancelled before they started plus vlock_save hooks of
+   * single plugins that were held back, see plugin_save_hold_off(). */
+  VLOCK_COUNTER_SUPPRESSED_SAVES,
+  VLOCK_NR_COUNTERS
+};
+
+extern const char *vlock_phase_names[VLOCK_NR_PHASES];
+extern const char *vlock_counter_names[VLOCK_NR_COUNTERS];
+
+struct vlock_counters
+{
+  /* The current phase. */
+  uint32_t phase;
+  uint32_t reserved;
+  uint64_t counts[VLOCK_NR_PHASES][VLOCK_NR_COUNTERS];
+};
+
+/* Switch to the given phase.  Counts are added to the current phase. */
+void counters_set_phase(enum vlock_phase phase);
+
+/* Add to a counter of the current phase.  This does not block and makes no
+ * system call. */
+void counters_add(enum vlock_counter counter, uint64_t n);
+
+/* Keep the counters in the given storage from now on, e.g. on the status
+ * page.  The current values are copied over.  With NULL the counters are
+ * moved back to private storage. */
+void counters_attach(struct vlock_counters *storage);
+
+/* Copy the current values. */
+void counters_get(struct vlock_counters *snapshot);
+
+/* Print one line per phase of the form "vlock: counters <phase> spawns=<n>
+ * termios=<n> hooks=<n> wakeups=<n> terminal-bytes=<n>
+ * suppressed-saves=<n>". */
+void counters_print(FILE *file);
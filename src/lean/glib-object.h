@@ -0,0 +1,19 @@
+/* glib-object.h -- minimal GObject replacement for the lean build of vlock,
+ *                  the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* The lean build does not use GObject at all.  The plugin classes are plain
+ * structures of function pointers, see plugin.h. */
+
+#pragma once
+
+#include <glib.h>
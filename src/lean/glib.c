@@ -0,0 +1,185 @@
+/* glib.c -- minimal GLib replacement for the lean build of vlock,
+ *           the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pwd.h>
+
+#include <glib.h>
+
+static void out_of_memory(size_t size)
+{
+  fprintf(stderr, "vlock: failed to allocate %zu bytes\n", size);
+  abort();
+}
+
+gpointer g_malloc(size_t size)
+{
+  gpointer memory;
+
+  if (size == 0)
+    return NULL;
+
+  if ((memory = malloc(size)) == NULL)
+    out_of_memory(size);
+
+  return memory;
+}
+
+gpointer g_malloc0(size_t size)
+{
+  gpointer memory;
+
+  if (size == 0)
+    return NULL;
+
+  if ((memory = calloc(1, size)) == NULL)
+    out_of_memory(size);
+
+  return memory;
+}
+
+gpointer g_realloc(gpointer memory, size_t size)
+{
+  if (size == 0) {
+    free(memory);
+    return NULL;
+  }
+
+  if ((memory = realloc(memory, size)) == NULL)
+    out_of_memory(size);
+
+  return memory;
+}
+
+gchar *g_strdup(const gchar *string)
+{
+  gchar *copy;
+
+  if (string == NULL)
+    return NULL;
+
+  copy = g_malloc(strlen(string) + 1);
+  return strcpy(copy, string);
+}
+
+static gchar *g_strdup_vprintf(const gchar *format, va_list args)
+{
+  gchar *string;
+
+  if (vasprintf(&string, format, args) < 0)
+    out_of_memory(strlen(format));
+
+  return string;
+}
+
+gchar *g_strdup_printf(const gchar *format, ...)
+{
+  va_list args;
+  gchar *string;
+
+  va_start(args, format);
+  string = g_strdup_vprintf(format, args);
+  va_end(args);
+
+  return string;
+}
+
+GError *g_error_new_literal(GQuark domain, gint code, const gchar *message)
+{
+  GError *error = g_malloc(sizeof *error);
+
+  error->domain = domain;
+  error->code = code;
+  error->message = g_strdup(message);
+
+  return error;
+}
+
+void g_error_free(GError *error)
+{
+  if (error == NULL)
+    return;
+
+  g_free(error->message);
+  g_free(error);
+}
+
+void g_set_error(GError **error, GQuark domain, gint code,
+                 const gchar *format, ...)
+{
+  va_list args;
+  GError *new_error;
+
+  if (error == NULL)
+    return;
+
+  new_error = g_malloc(sizeof *new_error);
+  new_error->domain = domain;
+  new_error->code = code;
+
+  va_start(args, format);
+  new_error->message = g_strdup_vprintf(format, args);
+  va_end(args);
+
+  g_propagate_error(error, new_error);
+}
+
+void g_propagate_error(GError **dest, GError *src)
+{
+  if (dest == NULL) {
+    g_error_free(src);
+    return;
+  }
+
+  /* Like GLib, never overwrite an error that is already set. */
+  if (*dest != NULL) {
+    fprintf(stderr, "vlock: error overwritten: %s\n", src->message);
+    g_error_free(src);
+    return;
+  }
+
+  *dest = src;
+}
+
+void g_clear_error(GError **error)
+{
+  if (error != NULL && *error != NULL) {
+    g_error_free(*error);
+    *error = NULL;
+  }
+}
+
+gboolean g_error_matches(const GError *error, GQuark domain, gint code)
+{
+  return error != NULL && error->domain == domain && error->code == code;
+}
+
+const gchar *g_get_user_name(void)
+{
+  static gchar *user_name = NULL;
+
+  if (user_name == NULL) {
+    struct passwd *pw = getpwuid(getuid());
+    user_name = g_strdup(pw != NULL ? pw->pw_name : "somebody");
+  }
+
+  return user_name;
+}
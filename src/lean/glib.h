@@ -0,0 +1,101 @@
+/* glib.h -- minimal GLib replacement for the lean build of vlock,
+ *           the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* When vlock is configured with --disable-glib this directory is put in front
+ * of the include path.  It provides the small part of GLib that vlock-main
+ * uses outside of the plugin code:  basic types, GError and a few memory and
+ * string functions.  Everything behaves like the GLib function of the same
+ * name, but only what vlock needs is implemented. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef char gchar;
+typedef int gint;
+typedef unsigned int guint;
+typedef int gboolean;
+typedef void *gpointer;
+
+/* A quark is just the address of its static string.  Quarks are only compared
+ * for equality so this is good enough. */
+typedef const gchar *GQuark;
+
+static inline GQuark g_quark_from_static_string(const gchar *string)
+{
+  return string;
+}
+
+/* Errors */
+typedef struct _GError GError;
+
+struct _GError
+{
+  GQuark domain;
+  gint code;
+  gchar *message;
+};
+
+GError *g_error_new_literal(GQuark domain, gint code, const gchar *message);
+void g_error_free(GError *error);
+void g_set_error(GError **error, GQuark domain, gint code,
+                 const gchar *format, ...)
+  __attribute__((format(printf, 4, 5)));
+void g_propagate_error(GError **dest, GError *src);
+void g_clear_error(GError **error);
+gboolean g_error_matches(const GError *error, GQuark domain, gint code);
+
+/* Memory.  Allocation failures abort the program. */
+gpointer g_malloc(size_t size);
+gpointer g_malloc0(size_t size);
+gpointer g_realloc(gpointer memory, size_t size);
+
+static inline void g_free(gpointer memory)
+{
+  free(memory);
+}
+
+#define g_new(type, count) ((type *) g_malloc(sizeof(type) * (count)))
+#define g_new0(type, count) ((type *) g_malloc0(sizeof(type) * (count)))
+#define g_renew(type, memory, count) \
+  ((type *) g_realloc((memory), sizeof(type) * (count)))
+
+/* Strings */
+gchar *g_strdup(const gchar *string);
+gchar *g_strdup_printf(const gchar *format, ...)
+  __attribute__((format(printf, 1, 2)));
+
+static inline const gchar *g_strerror(gint error_number)
+{
+  return strerror(error_number);
+}
+
+/* Environment */
+static inline const gchar *g_getenv(const gchar *name)
+{
+  return getenv(name);
+}
+
+const gchar *g_get_user_name(void);
+
+/* Assertions */
+#define g_assert(expression) assert(expression)
+
+#define g_return_val_if_fail(expression, value) \
+  do { \
+    if (!(expression)) \
+      return (value); \
+  } while (0)
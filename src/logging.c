@@ -1,10 +1,40 @@
+/* logging.c -- logging routines for vlock,
+ *              the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <syslog.h>
+#include <pthread.h>
 
 #include <glib.h>
 
+#include "util.h"
+
 #include "logging.h"
 
+#ifndef NO_GLIB
+
 static void vlock_quiet_log_handler(const gchar *log_domain __attribute__((unused)),
 				    GLogLevelFlags log_level __attribute__((unused)),
 				    const gchar *message __attribute__((unused)),
@@ -22,3 +52,368 @@ void vlock_initialize_logging(void)
 
 }
 
+#else /* NO_GLIB */
+
+/* The lean build has no GLib logging that could be silenced. */
+void vlock_initialize_logging(void)
+{
+}
+
+#endif /* NO_GLIB */
+
+/*************/
+/* event log */
+/*************/
+
+/* Events are stored as fixed-size records in a ring buffer.  Any thread may
+ * add records without locking:  a slot is claimed by advancing head and
+ * published by setting its sequence number.  A background thread drains
+ * the buffer to the backend, so a slow or hanging syslog daemon or file
+ * system never delays the password prompt or authentication. */
+
+#define EVENT_RING_SIZE 64
+#define EVENT_TEXT_SIZE 32
+
+struct event_record
+{
+  /* Equal to the position while the slot is free, position + 1 when it
+   * holds a record. */
+  unsigned long sequence;
+  struct timespec time;
+  enum vlock_event_type type;
+  int value;
+  char subject[EVENT_TEXT_SIZE];
+  char detail[EVENT_TEXT_SIZE];
+};
+
+static struct event_record event_ring[EVENT_RING_SIZE];
+/* Position of the next slot to claim. */
+static unsigned long event_head;
+/* Position of the next slot to drain, only used by the flusher. */
+static unsigned long event_tail;
+/* Number of events that were dropped because the buffer was full. */
+static unsigned long events_dropped;
+
+static bool event_log_open;
+static bool event_log_stopping;
+/* The flusher sleeps on this pipe until an event is added. */
+static int wakeup_pipe[2] = { -1, -1 };
+/* The flusher closes the write end of this pipe when it is done. */
+static int done_pipe[2] = { -1, -1 };
+static pthread_t flusher_thread;
+/* Set by vlock_event_log_stop() if the flusher is done and may be joined. */
+static bool flusher_done;
+
+/* The file sink or NULL for syslog. */
+static FILE *event_file;
+
+/* How events are written.  Keys that are NULL are omitted. */
+struct event_format
+{
+  const char *name;
+  int priority;
+  const char *subject_key;
+  const char *detail_key;
+  const char *value_key;
+};
+
+static const struct event_format event_formats[] = {
+  [VLOCK_EVENT_LOCK] = { "lock", LOG_NOTICE, "user", NULL, "vt" },
+  [VLOCK_EVENT_UNLOCK] =
+    { "unlock", LOG_NOTICE, "user", NULL, "failed_attempts" },
+  [VLOCK_EVENT_AUTH_FAILURE] =
+    { "auth-failure", LOG_WARNING, "user", NULL, "attempt" },
+  [VLOCK_EVENT_AUTH_TIMEOUT] =
+    { "auth-timeout", LOG_INFO, "user", NULL, NULL },
+  [VLOCK_EVENT_PLUGIN_FAILURE] =
+    { "plugin-failure", LOG_ERR, "plugin", "hook", "errno" },
+  [VLOCK_EVENT_WAKE] = { "wake", LOG_INFO, NULL, NULL, "latency_us" },
+  [VLOCK_EVENT_SECURE] = { "secure", LOG_INFO, NULL, NULL, "latency_us" },
+};
+
+static void copy_event_text(char *buffer, const char *text)
+{
+  if (text == NULL)
+    text = "";
+
+  /* Spaces would make the record ambiguous. */
+  for (size_t i = 0; i < EVENT_TEXT_SIZE - 1; i++) {
+    char c = text[i];
+
+    if (c == '\0') {
+      buffer[i] = '\0';
+      return;
+    }
+
+    buffer[i] = (c == ' ' || c == '\n') ? '_' : c;
+  }
+
+  buffer[EVENT_TEXT_SIZE - 1] = '\0';
+}
+
+void vlock_log_event(enum vlock_event_type type,
+                     const char *subject,
+                     const char *detail,
+                     int value)
+{
+  struct event_record *record;
+  unsigned long position;
+  int errsv = errno;
+
+  if (!__atomic_load_n(&event_log_open, __ATOMIC_ACQUIRE))
+    return;
+
+  position = __atomic_load_n(&event_head, __ATOMIC_RELAXED);
+
+  for (;;) {
+    record = &event_ring[position % EVENT_RING_SIZE];
+
+    if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != position) {
+      /* The flusher has not drained this slot yet. */
+      __atomic_add_fetch(&events_dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+
+    if (__atomic_compare_exchange_n(&event_head, &position, position + 1,
+                                    false, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED))
+      break;
+  }
+
+  (void) clock_gettime(CLOCK_REALTIME, &record->time);
+  record->type = type;
+  record->value = value;
+  copy_event_text(record->subject, subject);
+  copy_event_text(record->detail, detail);
+
+  __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+
+  /* Wake up the flusher.  If the pipe is full it is awake anyway. */
+  (void) write(wakeup_pipe[1], "", 1);
+
+  errno = errsv;
+}
+
+/* Format the event as "name key=value ...". */
+static void format_event(const struct event_record *record, char *buffer,
+                         size_t size)
+{
+  const struct event_format *format = &event_formats[record->type];
+  int length = snprintf(buffer, size, "%s", format->name);
+
+  if (format->subject_key != NULL && length >= 0 && (size_t) length < size)
+    length += snprintf(buffer + length, size - length, " %s=%s",
+                       format->subject_key, record->subject);
+
+  if (format->detail_key != NULL && length >= 0 && (size_t) length < size)
+    length += snprintf(buffer + length, size - length, " %s=%s",
+                       format->detail_key, record->detail);
+
+  if (format->value_key != NULL && length >= 0 && (size_t) length < size)
+    (void) snprintf(buffer + length, size - length, " %s=%d",
+                    format->value_key, record->value);
+}
+
+static void write_event(const struct event_record *record)
+{
+  char message[160];
+
+  format_event(record, message, sizeof message);
+
+  if (event_file != NULL) {
+    struct tm tm;
+    char timestamp[32];
+
+    (void) gmtime_r(&record->time.tv_sec, &tm);
+    (void) strftime(timestamp, sizeof timestamp, "%Y-%m-%dT%H:%M:%S", &tm);
+    (void) fprintf(event_file, "%s.%03ldZ vlock[%lu]: %s\n", timestamp,
+                   record->time.tv_nsec / 1000000L, (unsigned long) getpid(),
+                   message);
+  } else {
+    syslog(event_formats[record->type].priority, "%s", message);
+  }
+}
+
+/* Write all published records.  Returns the number of records written. */
+static size_t drain_events(void)
+{
+  size_t count = 0;
+
+  for (;;) {
+    struct event_record *record = &event_ring[event_tail % EVENT_RING_SIZE];
+
+    if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != event_tail + 1)
+      break;
+
+    write_event(record);
+
+    /* Hand the slot back for the next round. */
+    __atomic_store_n(&record->sequence, event_tail + EVENT_RING_SIZE,
+                     __ATOMIC_RELEASE);
+    event_tail++;
+    count++;
+  }
+
+  return count;
+}
+
+static void *flusher(void *argument __attribute__((unused)))
+{
+  unsigned long reported_dropped = 0;
+
+  for (;;) {
+    char buffer[64];
+    bool stopping;
+    unsigned long dropped;
+
+    if (read(wakeup_pipe[0], buffer, sizeof buffer) < 0 && errno != EINTR)
+      break;
+
+    stopping = __atomic_load_n(&event_log_stopping, __ATOMIC_ACQUIRE);
+
+    if (drain_events() > 0 && event_file != NULL)
+      (void) fflush(event_file);
+
+    dropped = __atomic_load_n(&events_dropped, __ATOMIC_RELAXED);
+
+    if (dropped != reported_dropped) {
+      if (event_file != NULL) {
+        (void) fprintf(event_file, "vlock[%lu]: %lu events dropped\n",
+                       (unsigned long) getpid(), dropped - reported_dropped);
+        (void) fflush(event_file);
+      } else {
+        syslog(LOG_WARNING, "%lu events dropped",
+               dropped - reported_dropped);
+      }
+
+      reported_dropped = dropped;
+    }
+
+    if (stopping)
+      break;
+  }
+
+  (void) close(done_pipe[1]);
+  return NULL;
+}
+
+static void close_event_log_files(void)
+{
+  for (int i = 0; i < 2; i++) {
+    if (wakeup_pipe[i] >= 0)
+      (void) close(wakeup_pipe[i]);
+
+    if (done_pipe[i] >= 0)
+      (void) close(done_pipe[i]);
+
+    wakeup_pipe[i] = done_pipe[i] = -1;
+  }
+
+  if (event_file != NULL)
+    (void) fclose(event_file);
+  else
+    closelog();
+
+  event_file = NULL;
+}
+
+bool vlock_event_log_open(const char *filename)
+{
+  sigset_t all_signals;
+  sigset_t old_signals;
+  int error;
+
+  if (event_log_open)
+    return true;
+
+  if (filename != NULL) {
+    int fd = open(filename, O_WRONLY | O_APPEND | O_CREAT | O_NOFOLLOW
+                  | O_CLOEXEC, 0600);
+
+    if (fd < 0)
+      return false;
+
+    if ((event_file = fdopen(fd, "a")) == NULL) {
+      GUARD_ERRNO(close(fd));
+      return false;
+    }
+  } else {
+    openlog("vlock", LOG_PID, LOG_AUTHPRIV);
+  }
+
+  if (pipe(wakeup_pipe) < 0)
+    goto error;
+
+  if (pipe(done_pipe) < 0)
+    goto error;
+
+  for (int i = 0; i < 2; i++) {
+    (void) fcntl(wakeup_pipe[i], F_SETFD, FD_CLOEXEC);
+    (void) fcntl(done_pipe[i], F_SETFD, FD_CLOEXEC);
+  }
+
+  /* Adding an event must never block on a full pipe. */
+  if (fcntl(wakeup_pipe[1], F_SETFL, O_NONBLOCK) < 0)
+    goto error;
+
+  for (size_t i = 0; i < EVENT_RING_SIZE; i++)
+    event_ring[i].sequence = i;
+
+  event_head = event_tail = 0;
+  event_log_stopping = false;
+
+  /* Signals must be handled by the main thread. */
+  (void) sigfillset(&all_signals);
+  (void) pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+  error = pthread_create(&flusher_thread, NULL, flusher, NULL);
+  (void) pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+  if (error != 0) {
+    errno = error;
+    goto error;
+  }
+
+  __atomic_store_n(&event_log_open, true, __ATOMIC_RELEASE);
+  return true;
+
+error:
+  GUARD_ERRNO(close_event_log_files());
+  return false;
+}
+
+void vlock_event_log_stop(void)
+{
+  struct pollfd pfd;
+  int errsv = errno;
+
+  if (!__atomic_exchange_n(&event_log_open, false, __ATOMIC_ACQ_REL))
+    return;
+
+  __atomic_store_n(&event_log_stopping, true, __ATOMIC_RELEASE);
+  (void) write(wakeup_pipe[1], "", 1);
+
+  /* Wait until the flusher is done.  Only async-signal-safe functions are
+   * used here. */
+  pfd.fd = done_pipe[0];
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  while (poll(&pfd, 1, 1000) < 0 && errno == EINTR)
+    ;
+
+  flusher_done = pfd.revents != 0;
+  errno = errsv;
+}
+
+void vlock_event_log_close(void)
+{
+  vlock_event_log_stop();
+
+  /* If the backend hangs the flusher is left behind and dies with the
+   * process. */
+  if (flusher_done) {
+    (void) pthread_join(flusher_thread, NULL);
+    close_event_log_files();
+    flusher_done = false;
+  }
+}
@@ -1 +1,66 @@
+/* logging.h -- header file for the logging routines of vlock,
+ *              the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
 void vlock_initialize_logging(void);
+
+/* Events that are recorded in the event log. */
+enum vlock_event_type
+{
+  /* The terminal was locked.  Subject is the user, value the console. */
+  VLOCK_EVENT_LOCK,
+  /* The terminal was unlocked.  Subject is the user, value the number of
+   * failed authentication tries. */
+  VLOCK_EVENT_UNLOCK,
+  /* Authentication failed.  Subject is the user, value the number of the
+   * try. */
+  VLOCK_EVENT_AUTH_FAILURE,
+  /* The password prompt timed out.  Subject is the user. */
+  VLOCK_EVENT_AUTH_TIMEOUT,
+  /* A plugin hook failed.  Subject is the plugin, detail the hook and
+   * value the error number. */
+  VLOCK_EVENT_PLUGIN_FAILURE,
+  /* The screen saver was stopped because a key was pressed.  Value is the
+   * time from reading the key until the prompt was shown in microseconds. */
+  VLOCK_EVENT_WAKE,
+  /* The terminal was secured.  Value is the time from the start of
+   * vlock-main in microseconds. */
+  VLOCK_EVENT_SECURE,
+};
+
+/* Start the event log.  Events are written to the given file or to syslog if
+ * filename is NULL.  Writing happens in a background thread so logging an
+ * event never waits for the backend.  On failure false is returned and
+ * errno is set. */
+bool vlock_event_log_open(const char *filename);
+
+/* Write all pending events and stop the event log.  Waits at most one second
+ * for the backend.  This is async-signal-safe but leaves the files and the
+ * background thread to be released by the exit of the process. */
+void vlock_event_log_stop(void);
+
+/* Stop the event log like vlock_event_log_stop() and release everything.
+ * This is not async-signal-safe. */
+void vlock_event_log_close(void);
+
+/* Record an event.  Subject and detail may be NULL and are truncated if
+ * they are too long.  This does not block and only makes a system call to
+ * wake up the background thread.  If the buffer is full the event is
+ * dropped.  Does nothing if the event log is not open. */
+void vlock_log_event(enum vlock_event_type type,
+                     const char *subject,
+                     const char *detail,
+                     int value);
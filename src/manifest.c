@@ -0,0 +1,400 @@
+/* manifest.c -- manifest routines for vlock,
+ *               the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Manifests are files "<name>.manifest" in the script directory that declare
+ * a plugin instead of a script.  They are read by vlock itself with the
+ * configuration file parser and contain variable assignments:
+ *
+ *   DEPENDS="all"
+ *   VLOCK_START="/usr/bin/amixer -q set Master mute"
+ *   VLOCK_END="/usr/bin/amixer -q set Master unmute"
+ *
+ * The dependency variables SUCCEEDS, PRECEEDS, REQUIRES, NEEDS, DEPENDS and
+ * CONFLICTS hold white space separated plugin names.  The hook variables
+ * VLOCK_START, VLOCK_END, VLOCK_SAVE and VLOCK_SAVE_ABORT hold a command that
+ * is started when the hook is called.  The command is split at white space,
+ * single or double quotes may group words, and must start with an absolute
+ * path.  It is executed directly, without a shell, as the user who started
+ * vlock.  USES_DISPLAY="yes" declares that the plugin draws on the screen
+ * while the terminal is locked, so it is woken up before the prompt is shown.
+ * LOCK_CRITICAL="yes" declares that its vlock_start hook must be called
+ * before the terminal is secured, see VLOCK_PLUGIN_LOCK_CRITICAL.
+ *
+ * Unlike a script, a manifest plugin starts no process to read its
+ * dependencies and keeps no process running while the terminal is locked.
+ * vlock does not wait for the commands.  Each command runs in its own process
+ * group.  The command started by vlock_save runs at idle priority.  Its group
+ * is sent SIGTERM when vlock_save_abort is called and killed for good when
+ * vlock_save is called again or the plugin is unloaded.  A hook only fails if
+ * its command could not be started. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "process.h"
+#include "rcfile.h"
+
+#include "plugin.h"
+#include "manifest.h"
+
+#ifndef NO_GLIB
+G_DEFINE_TYPE(VlockManifest, vlock_manifest, TYPE_VLOCK_PLUGIN)
+
+#define VLOCK_MANIFEST_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj),\
+                                                                     TYPE_VLOCK_MANIFEST,\
+                                                                     VlockManifestPrivate))
+#else
+/* The private data is allocated directly after the instance. */
+#define VLOCK_MANIFEST_GET_PRIVATE(obj) ((VlockManifestPrivate *)\
+                                         (VLOCK_MANIFEST(obj) + 1))
+#endif
+
+struct _VlockManifestPrivate
+{
+  /* The command of each hook as a NULL terminated argument vector or NULL. */
+  char **commands[nr_hooks];
+  /* The PID of the last command started by each hook or 0. */
+  pid_t pids[nr_hooks];
+};
+
+/* Initialize plugin to default values. */
+static void vlock_manifest_init(VlockManifest *self)
+{
+  self->priv = VLOCK_MANIFEST_GET_PRIVATE(self);
+
+  for (size_t i = 0; i < nr_hooks; i++) {
+    self->priv->commands[i] = NULL;
+    self->priv->pids[i] = 0;
+  }
+}
+
+static ssize_t get_hook_index(const char *hook_name)
+{
+  for (size_t i = 0; i < nr_hooks; i++)
+    if (strcmp(hooks[i].name, hook_name) == 0)
+      return i;
+
+  return -1;
+}
+
+static void free_command(char **argv)
+{
+  if (argv == NULL)
+    return;
+
+  for (size_t i = 0; argv[i] != NULL; i++)
+    g_free(argv[i]);
+
+  g_free(argv);
+}
+
+/* Collect the command if it exited. */
+static void reap_command(VlockManifest *self, size_t hook)
+{
+  if (self->priv->pids[hook] > 0
+      && waitpid(self->priv->pids[hook], NULL, WNOHANG) != 0)
+    self->priv->pids[hook] = 0;
+}
+
+/* Collect the commands of all hooks that exited, so that e.g. the command of
+ * vlock_start does not linger as a zombie while the screen is locked. */
+static void reap_commands(VlockManifest *self)
+{
+  for (size_t i = 0; i < nr_hooks; i++)
+    reap_command(self, i);
+}
+
+#ifndef NO_GLIB
+static void vlock_manifest_finalize(GObject *object)
+#else
+static void vlock_manifest_finalize(VlockPlugin *object)
+#endif
+{
+  VlockManifest *self = VLOCK_MANIFEST(object);
+  ssize_t save = get_hook_index("vlock_save");
+
+  for (size_t i = 0; i < nr_hooks; i++) {
+    reap_command(self, i);
+
+    /* Stop a screen saver.  Other commands may finish on their own. */
+    if (self->priv->pids[i] > 0 && (ssize_t) i == save)
+      ensure_group_death(self->priv->pids[i]);
+
+    free_command(self->priv->commands[i]);
+  }
+
+#ifndef NO_GLIB
+  G_OBJECT_CLASS(vlock_manifest_parent_class)->finalize(object);
+#endif
+}
+
+/* Split a command at white space.  Single or double quotes group words.
+ * Returns NULL for an empty command. */
+static char **split_command(const char *command)
+{
+  char **argv = NULL;
+  size_t argc = 0;
+  const char *p = command;
+
+  for (;;) {
+    char *word;
+    size_t length = 0;
+
+    while (isspace((unsigned char) *p))
+      p++;
+
+    if (*p == '\0')
+      break;
+
+    word = g_malloc(strlen(p) + 1);
+
+    while (*p != '\0' && !isspace((unsigned char) *p)) {
+      if (*p == '\'' || *p == '"') {
+        char quote = *p++;
+
+        while (*p != '\0' && *p != quote)
+          word[length++] = *p++;
+
+        if (*p == quote)
+          p++;
+      } else {
+        word[length++] = *p++;
+      }
+    }
+
+    word[length] = '\0';
+
+    argv = g_renew(char *, argv, argc + 2);
+    argv[argc++] = word;
+    argv[argc] = NULL;
+  }
+
+  return argv;
+}
+
+/* Variables in the order of dependency_names and hooks. */
+static const char *dependency_variables[nr_dependencies] = {
+  "SUCCEEDS",
+  "PRECEEDS",
+  "REQUIRES",
+  "NEEDS",
+  "DEPENDS",
+  "CONFLICTS",
+};
+
+static const char *hook_variables[nr_hooks] = {
+  "VLOCK_START",
+  "VLOCK_END",
+  "VLOCK_SAVE",
+  "VLOCK_SAVE_ABORT",
+};
+
+/* Store an assignment from the manifest.  Unknown variables are rejected. */
+static bool assign(const char *name, const char *value,
+                   bool exported __attribute__((unused)), void *data)
+{
+  VlockManifest *self = data;
+
+  if (value == NULL)
+    return false;
+
+  for (size_t i = 0; i < nr_dependencies; i++)
+    if (strcmp(name, dependency_variables[i]) == 0) {
+      char *names = g_strdup(value);
+      char *saveptr;
+
+      for (char *item = strtok_r(names, " \t\r\n", &saveptr);
+           item != NULL;
+           item = strtok_r(NULL, " \t\r\n", &saveptr))
+        vlock_plugin_add_dependency(VLOCK_PLUGIN(self), i, item);
+
+      g_free(names);
+      return true;
+    }
+
+  for (size_t i = 0; i < nr_hooks; i++)
+    if (strcmp(name, hook_variables[i]) == 0) {
+      free_command(self->priv->commands[i]);
+      self->priv->commands[i] = split_command(value);
+      return true;
+    }
+
+  if (strcmp(name, "USES_DISPLAY") == 0) {
+    if (strcmp(value, "yes") == 0)
+      VLOCK_PLUGIN(self)->capabilities |= VLOCK_PLUGIN_DISPLAY;
+    else if (strcmp(value, "no") == 0)
+      VLOCK_PLUGIN(self)->capabilities &= ~VLOCK_PLUGIN_DISPLAY;
+    else
+      return false;
+
+    return true;
+  }
+
+  if (strcmp(name, "LOCK_CRITICAL") == 0) {
+    if (strcmp(value, "yes") == 0)
+      VLOCK_PLUGIN(self)->capabilities |= VLOCK_PLUGIN_LOCK_CRITICAL;
+    else if (strcmp(value, "no") == 0)
+      VLOCK_PLUGIN(self)->capabilities &= ~VLOCK_PLUGIN_LOCK_CRITICAL;
+    else
+      return false;
+
+    return true;
+  }
+
+  return false;
+}
+
+static bool vlock_manifest_open(VlockPlugin *plugin, GError **error)
+{
+  VlockManifest *self = VLOCK_MANIFEST(plugin);
+  char *path = g_strdup_printf("%s/%s.manifest", VLOCK_SCRIPT_DIR,
+                               plugin->name);
+  FILE *file = fopen(path, "r");
+  bool result;
+
+  if (file == NULL) {
+    g_set_error(error, VLOCK_PLUGIN_ERROR,
+                errno == ENOENT ? VLOCK_PLUGIN_ERROR_NOT_FOUND
+                                : VLOCK_PLUGIN_ERROR_FAILED,
+                "could not open '%s': %s", path, g_strerror(errno));
+    g_free(path);
+    return false;
+  }
+
+  /* The parser reports errors with the file name and line itself. */
+  result = parse_rcfile(file, path, NULL, assign, self);
+  (void) fclose(file);
+
+  if (!result) {
+    g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_FAILED,
+                "could not parse '%s'", path);
+    g_free(path);
+    return false;
+  }
+
+  for (size_t i = 0; i < nr_hooks; i++)
+    if (self->priv->commands[i] != NULL
+        && self->priv->commands[i][0][0] != '/') {
+      g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_FAILED,
+                  "%s: %s must start with an absolute path", path,
+                  hook_variables[i]);
+      g_free(path);
+      return false;
+    }
+
+  g_free(path);
+  return true;
+}
+
+static bool vlock_manifest_call_hook(VlockPlugin *plugin,
+                                     const gchar *hook_name)
+{
+  VlockManifest *self = VLOCK_MANIFEST(plugin);
+  ssize_t i = get_hook_index(hook_name);
+  struct child_process child = {
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+    .function = NULL,
+    .new_group = true,
+  };
+
+  if (i < 0)
+    return true;
+
+  reap_commands(self);
+
+  if (strcmp(hook_name, "vlock_save_abort") == 0) {
+    ssize_t save = get_hook_index("vlock_save");
+
+    /* Stop the screen saver but do not wait for it, the prompt should be
+     * shown at once. */
+    if (self->priv->pids[save] > 0)
+      (void) kill(-self->priv->pids[save], SIGTERM);
+  }
+
+  /* A screen saver that ignored SIGTERM since the last abort is killed. */
+  if (self->priv->pids[i] > 0 && strcmp(hook_name, "vlock_save") == 0) {
+    ensure_group_death(self->priv->pids[i]);
+    self->priv->pids[i] = 0;
+  }
+
+  if (self->priv->commands[i] == NULL)
+    return true;
+
+  child.path = self->priv->commands[i][0];
+  child.argv = (const char *const *) self->priv->commands[i];
+  /* Screen savers run at idle priority. */
+  child.background = strcmp(hook_name, "vlock_save") == 0;
+
+  if (!create_child(&child, NULL))
+    return false;
+
+  self->priv->pids[i] = child.pid;
+
+  return true;
+}
+
+#ifndef NO_GLIB
+
+/* Initialize manifest class. */
+static void vlock_manifest_class_init(VlockManifestClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+  VlockPluginClass *plugin_class = VLOCK_PLUGIN_CLASS(klass);
+
+  g_type_class_add_private(klass, sizeof(VlockManifestPrivate));
+
+  /* Virtual methods. */
+  gobject_class->finalize = vlock_manifest_finalize;
+
+  plugin_class->open = vlock_manifest_open;
+  plugin_class->call_hook = vlock_manifest_call_hook;
+}
+
+#else /* NO_GLIB */
+
+static void vlock_manifest_instance_init(VlockPlugin *plugin)
+{
+  vlock_manifest_init(VLOCK_MANIFEST(plugin));
+}
+
+static const VlockManifestClass vlock_manifest_class = {
+  .parent_class = {
+    .instance_size = sizeof(VlockManifest) + sizeof(VlockManifestPrivate),
+    .init = vlock_manifest_instance_init,
+    .finalize = vlock_manifest_finalize,
+    .open = vlock_manifest_open,
+    .call_hook = vlock_manifest_call_hook,
+  },
+};
+
+VlockPluginType vlock_manifest_get_type(void)
+{
+  return &vlock_manifest_class.parent_class;
+}
+
+#endif /* NO_GLIB */
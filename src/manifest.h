@@ -0,0 +1,59 @@
+/* manifest.h -- header file for the manifest plugins of vlock,
+ *               the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <glib-object.h>
+#include "plugin.h"
+
+/*
+ * Manifest type macros.
+ */
+#define TYPE_VLOCK_MANIFEST (vlock_manifest_get_type())
+
+#ifndef NO_GLIB
+#define VLOCK_MANIFEST(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                                        TYPE_VLOCK_MANIFEST,\
+                                                        VlockManifest))
+#define VLOCK_MANIFEST_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),\
+                                                             TYPE_VLOCK_MANIFEST,\
+                                                             VlockManifestClass))
+#define IS_VLOCK_MANIFEST(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                                           TYPE_VLOCK_MANIFEST))
+#define IS_VLOCK_MANIFEST_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),\
+                                                                TYPE_VLOCK_MANIFEST))
+#define VLOCK_MANIFEST_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS((obj),\
+                                                                 TYPE_VLOCK_MANIFEST,\
+                                                                 VlockManifestClass))
+#else
+#define VLOCK_MANIFEST(obj) ((VlockManifest *)(obj))
+#endif
+
+typedef struct _VlockManifest VlockManifest;
+typedef struct _VlockManifestClass VlockManifestClass;
+
+typedef struct _VlockManifestPrivate VlockManifestPrivate;
+
+struct _VlockManifest
+{
+  VlockPlugin parent_instance;
+
+  VlockManifestPrivate *priv;
+};
+
+struct _VlockManifestClass
+{
+  VlockPluginClass parent_class;
+};
+
+VlockPluginType vlock_manifest_get_type(void);
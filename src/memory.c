@@ -0,0 +1,50 @@
+/* memory.c -- memory routines for vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "memory.h"
+
+unsigned long memory_get_rss_kb(void)
+{
+  FILE *statm = fopen("/proc/self/statm", "r");
+  unsigned long size;
+  unsigned long resident;
+
+  if (statm == NULL)
+    return 0;
+
+  if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+
+  (void) fclose(statm);
+
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void memory_release(void)
+{
+#ifdef __GLIBC__
+  (void) malloc_trim(0);
+#endif
+}
@@ -0,0 +1,26 @@
+/* memory.h -- header file for the memory routines of vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* A lock may last for days, so vlock-main gives back what it only needed to
+ * get the terminal locked once the lock is engaged. */
+
+#pragma once
+
+/* Get the resident set size of the process in kilobytes or 0 if it is
+ * unknown. */
+unsigned long memory_get_rss_kb(void);
+
+/* Return free heap memory to the system with malloc_trim() where available.
+ * Code pages are left alone because the keypress, wake and prompt code must
+ * not be paged in again after a long lock. */
+void memory_release(void);
@@ -13,7 +13,12 @@
 /* Modules are shared objects that are loaded into vlock's address space. */
 /* They can define certain functions that are called through vlock's plugin
  * mechanism.  They should also define dependencies if they depend on other
- * plugins of have to be called before or after other plugins. */
+ * plugins of have to be called before or after other plugins.
+ *
+ * A module either exports a single vlock_module_descriptor (ABI version 2) or
+ * a separate symbol for each hook and dependency (ABI version 1), see
+ * modules/vlock_plugin.h.  In both cases the dependency arrays are used in
+ * place because they live as long as the module is loaded. */
 
 #if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
 #define _GNU_SOURCE
@@ -35,15 +40,37 @@
 
 #include "plugin.h"
 #include "module.h"
-
+#include "builtin.h"
+
+/* The module ABI. */
+#include "../modules/vlock_plugin.h"
+
+/* The descriptor tables must match the global hooks and dependency names. */
+typedef char descriptor_hooks_match[VLOCK_NR_HOOKS == nr_hooks ? 1 : -1];
+typedef char descriptor_dependencies_match[
+  VLOCK_NR_DEPENDENCIES == nr_dependencies ? 1 : -1];
+typedef char descriptor_capabilities_match[
+  VLOCK_MODULE_THREAD_SAFE == VLOCK_PLUGIN_THREAD_SAFE
+  && VLOCK_MODULE_CHEAP_SAVE == VLOCK_PLUGIN_CHEAP_SAVE
+  && VLOCK_MODULE_DISPLAY == VLOCK_PLUGIN_DISPLAY
+  && VLOCK_MODULE_LOCK_CRITICAL == VLOCK_PLUGIN_LOCK_CRITICAL ? 1 : -1];
+
+#ifndef NO_GLIB
 G_DEFINE_TYPE(VlockModule, vlock_module, TYPE_VLOCK_PLUGIN)
 
 #define VLOCK_MODULE_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj),\
                                                                    TYPE_VLOCK_MODULE,\
                                                                    VlockModulePrivate))
+#else
+/* The private data is allocated directly after the instance. */
+#define VLOCK_MODULE_GET_PRIVATE(obj) ((VlockModulePrivate *)\
+                                       (VLOCK_MODULE(obj) + 1))
+#endif
 
 /* A hook function as defined by a module. */
 typedef bool (*module_hook_function)(void **);
+typedef int (*module_async_hook_function)(void **);
+typedef bool (*module_async_finish_function)(void **, enum vlock_hook_id, bool);
 
 struct _VlockModulePrivate
 {
@@ -56,14 +83,110 @@ struct _VlockModulePrivate
   /* Array of hook functions befined by a single module.  Stored in the same
    * order as the global hooks. */
   module_hook_function hooks[nr_hooks];
+
+  /* Asynchronous hooks of a version 2 module, see vlock_plugin.h. */
+  module_async_hook_function async_hooks[nr_hooks];
+  module_async_finish_function async_finish;
+  unsigned int async_timeout;
+
+  /* File descriptor and index of the running asynchronous hook or -1. */
+  int pending_fd;
+  ssize_t pending_hook;
 };
 
+/* Take the hooks, dependencies and capabilities from a version 2 module. */
+static bool vlock_module_use_descriptor(
+  VlockPlugin *plugin,
+  const struct vlock_module_descriptor *descriptor,
+  GError **error)
+{
+  VlockModule *self = VLOCK_MODULE(plugin);
+
+  if (descriptor->abi_version != VLOCK_MODULE_ABI_VERSION) {
+    g_set_error(
+      error,
+      VLOCK_PLUGIN_ERROR,
+      VLOCK_PLUGIN_ERROR_FAILED,
+      "could not open module '%s': unsupported ABI version %u",
+      plugin->name,
+      descriptor->abi_version);
+
+    return false;
+  }
+
+  for (size_t i = 0; i < nr_hooks; i++) {
+    self->priv->hooks[i] = descriptor->hooks[i];
+    self->priv->async_hooks[i] = descriptor->async_hooks[i];
+
+    if (descriptor->async_hooks[i] != NULL && descriptor->async_finish == NULL) {
+      g_set_error(
+        error,
+        VLOCK_PLUGIN_ERROR,
+        VLOCK_PLUGIN_ERROR_FAILED,
+        "could not open module '%s': asynchronous hooks without async_finish",
+        plugin->name);
+
+      return false;
+    }
+  }
+
+  self->priv->async_finish = descriptor->async_finish;
+  self->priv->async_timeout = descriptor->async_timeout > 0 ?
+                              descriptor->async_timeout :
+                              VLOCK_ASYNC_DEFAULT_TIMEOUT;
+
+  for (size_t i = 0; i < nr_dependencies; i++)
+    vlock_plugin_set_static_dependency(plugin, i,
+                                       descriptor->dependencies[i]);
+
+  plugin->capabilities = descriptor->capabilities;
+
+  return true;
+}
+
+/* Use the built-in module instead of loading a shared object. */
+static bool vlock_module_open_builtin(VlockPlugin *plugin,
+                                      const struct builtin_module *builtin,
+                                      GError **error)
+{
+  VlockModule *self = VLOCK_MODULE(plugin);
+
+  if (!builtin_module_accessible(builtin)) {
+    g_set_error(
+      error,
+      VLOCK_PLUGIN_ERROR,
+      VLOCK_PLUGIN_ERROR_FAILED,
+      "could not open module '%s': %s",
+      plugin->name,
+      g_strerror(EACCES));
+
+    return false;
+  }
+
+  if (builtin->descriptor != NULL)
+    return vlock_module_use_descriptor(plugin, builtin->descriptor, error);
+
+  for (size_t i = 0; i < nr_hooks; i++)
+    self->priv->hooks[i] = builtin->hooks[i];
+
+  for (size_t i = 0; i < nr_dependencies; i++)
+    vlock_plugin_set_static_dependency(plugin, i, builtin->dependencies[i]);
+
+  return true;
+}
+
 static bool vlock_module_open(VlockPlugin *plugin, GError **error)
 {
   VlockModule *self = VLOCK_MODULE(plugin);
 
   g_assert(self->priv->dl_handle == NULL);
 
+  /* Built-in modules take precedence over the module directory. */
+  const struct builtin_module *builtin = find_builtin_module(plugin->name);
+
+  if (builtin != NULL)
+    return vlock_module_open_builtin(plugin, builtin, error);
+
   char *path = g_strdup_printf("%s/%s.so", VLOCK_MODULE_DIR, plugin->name);
 
   /* Test for access.  This must be done manually because vlock most likely
@@ -102,6 +225,12 @@ static bool vlock_module_open(VlockPlugin *plugin, GError **error)
     return false;
   }
 
+  const struct vlock_module_descriptor *descriptor =
+    dlsym(dl_handle, "vlock_module_descriptor");
+
+  if (descriptor != NULL)
+    return vlock_module_use_descriptor(plugin, descriptor, error);
+
   /* Load all the hooks.  Unimplemented hooks are NULL and will not be called later. */
   for (size_t i = 0; i < nr_hooks; i++)
     *(void **)(&self->priv->hooks[i]) = dlsym(dl_handle, hooks[i].name);
@@ -110,17 +239,26 @@ static bool vlock_module_open(VlockPlugin *plugin, GError **error)
   for (size_t i = 0; i < nr_dependencies; i++) {
     const char *(*dependency)[] = dlsym(dl_handle, dependency_names[i]);
 
-    /* Append array elements to list. */
-    for (size_t j = 0; dependency != NULL && (*dependency)[j] != NULL; j++) {
-      char *s = g_strdup((*dependency)[j]);
-
-      plugin->dependencies[i] = g_list_append(plugin->dependencies[i], s);
-    }
+    if (dependency != NULL)
+      vlock_plugin_set_static_dependency(plugin, i, *dependency);
   }
 
   return true;
 }
 
+static bool vlock_module_finish_hook(VlockPlugin *plugin, bool cancel)
+{
+  VlockModule *self = VLOCK_MODULE(plugin);
+  ssize_t hook = self->priv->pending_hook;
+
+  g_assert(hook >= 0);
+
+  self->priv->pending_fd = -1;
+  self->priv->pending_hook = -1;
+
+  return self->priv->async_finish(&self->priv->hook_context, hook, cancel);
+}
+
 static bool vlock_module_call_hook(VlockPlugin *plugin, const gchar *hook_name)
 {
   VlockModule *self = VLOCK_MODULE(plugin);
@@ -128,8 +266,24 @@ static bool vlock_module_call_hook(VlockPlugin *plugin, const gchar *hook_name)
   /* Find the right hook index. */
   for (size_t i = 0; i < nr_hooks; i++)
     if (strcmp(hooks[i].name, hook_name) == 0) {
+      module_async_hook_function async_hook = self->priv->async_hooks[i];
       module_hook_function hook = self->priv->hooks[i];
 
+      if (async_hook != NULL) {
+        /* Only one action may run at a time. */
+        if (self->priv->pending_hook >= 0)
+          (void) vlock_module_finish_hook(plugin, true);
+
+        int fd = async_hook(&self->priv->hook_context);
+
+        if (fd >= 0) {
+          self->priv->pending_fd = fd;
+          self->priv->pending_hook = i;
+        }
+
+        return fd != VLOCK_ASYNC_FAILED;
+      }
+
       if (hook != NULL)
         return hook(&self->priv->hook_context);
     }
@@ -137,26 +291,58 @@ static bool vlock_module_call_hook(VlockPlugin *plugin, const gchar *hook_name)
   return true;
 }
 
+static bool vlock_module_get_pending_hook(VlockPlugin *plugin,
+                                          int *fd,
+                                          unsigned int *timeout)
+{
+  VlockModule *self = VLOCK_MODULE(plugin);
+
+  if (self->priv->pending_hook < 0)
+    return false;
+
+  *fd = self->priv->pending_fd;
+  *timeout = self->priv->async_timeout;
+
+  return true;
+}
+
 /* Initialize plugin to default values. */
 static void vlock_module_init(VlockModule *self)
 {
   self->priv = VLOCK_MODULE_GET_PRIVATE(self);
   self->priv->dl_handle = NULL;
+  self->priv->pending_fd = -1;
+  self->priv->pending_hook = -1;
+
+  for (size_t i = 0; i < nr_hooks; i++)
+    self->priv->async_hooks[i] = NULL;
 }
 
 /* Destroy module object. */
+#ifndef NO_GLIB
 static void vlock_module_finalize(GObject *object)
+#else
+static void vlock_module_finalize(VlockPlugin *object)
+#endif
 {
   VlockModule *self = VLOCK_MODULE(object);
 
+  /* Stop an action that is still running. */
+  if (self->priv->pending_hook >= 0)
+    (void) vlock_module_finish_hook(VLOCK_PLUGIN(self), true);
+
   if (self->priv->dl_handle != NULL) {
     dlclose(self->priv->dl_handle);
     self->priv->dl_handle = NULL;
   }
 
+#ifndef NO_GLIB
   G_OBJECT_CLASS(vlock_module_parent_class)->finalize(object);
+#endif
 }
 
+#ifndef NO_GLIB
+
 /* Initialize module class. */
 static void vlock_module_class_init(VlockModuleClass *klass)
 {
@@ -170,5 +356,32 @@ static void vlock_module_class_init(VlockModuleClass *klass)
 
   plugin_class->open = vlock_module_open;
   plugin_class->call_hook = vlock_module_call_hook;
+  plugin_class->get_pending_hook = vlock_module_get_pending_hook;
+  plugin_class->finish_hook = vlock_module_finish_hook;
+}
+
+#else /* NO_GLIB */
+
+static void vlock_module_instance_init(VlockPlugin *plugin)
+{
+  vlock_module_init(VLOCK_MODULE(plugin));
+}
+
+static const VlockModuleClass vlock_module_class = {
+  .parent_class = {
+    .instance_size = sizeof(VlockModule) + sizeof(VlockModulePrivate),
+    .init = vlock_module_instance_init,
+    .finalize = vlock_module_finalize,
+    .open = vlock_module_open,
+    .call_hook = vlock_module_call_hook,
+    .get_pending_hook = vlock_module_get_pending_hook,
+    .finish_hook = vlock_module_finish_hook,
+  },
+};
+
+VlockPluginType vlock_module_get_type(void)
+{
+  return &vlock_module_class.parent_class;
 }
 
+#endif /* NO_GLIB */
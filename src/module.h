@@ -7,6 +7,8 @@
  * Module type macros.
  */
 #define TYPE_VLOCK_MODULE (vlock_module_get_type())
+
+#ifndef NO_GLIB
 #define VLOCK_MODULE(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), TYPE_VLOCK_MODULE,\
                                                       VlockModule))
 #define VLOCK_MODULE_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),\
@@ -19,6 +21,9 @@
 #define VLOCK_MODULE_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS((obj),\
                                                                TYPE_VLOCK_MODULE,\
                                                                VlockModuleClass))
+#else
+#define VLOCK_MODULE(obj) ((VlockModule *)(obj))
+#endif
 
 typedef struct _VlockModule VlockModule;
 typedef struct _VlockModuleClass VlockModuleClass;
@@ -37,4 +42,4 @@ struct _VlockModuleClass
   VlockPluginClass parent_class;
 };
 
-GType vlock_module_get_type(void);
+VlockPluginType vlock_module_get_type(void);
@@ -0,0 +1,243 @@
+/* output.c -- terminal output for vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+/* for memmem() */
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <glib.h>
+
+#include "output.h"
+#include "counters.h"
+
+/* A frame with more pieces than this is flushed early. */
+#define MAX_SEGMENTS 16
+
+/* A piece of the current frame. */
+struct segment
+{
+  /* Text given to output_add() or NULL for formatted text. */
+  const char *text;
+  /* Offset of formatted text in the formatted buffer. */
+  size_t offset;
+  size_t length;
+};
+
+static int output_fd = STDERR_FILENO;
+
+static struct segment segments[MAX_SEGMENTS];
+static size_t nr_segments;
+
+/* Formatted text of the current frame. */
+static char *formatted;
+static size_t formatted_length;
+static size_t formatted_size;
+
+/* The last frame if it started by clearing the screen and nothing changed
+ * the screen since, otherwise NULL. */
+static char *screen;
+static size_t screen_length;
+
+static const char *segment_text(const struct segment *s)
+{
+  return s->text != NULL ? s->text : formatted + s->offset;
+}
+
+/* Add a piece of text.  There must be room for it. */
+static void add_segment(const char *text, size_t offset, size_t length)
+{
+  const char *start = text != NULL ? text : formatted + offset;
+  const char *clear = NULL;
+  size_t clear_length = strlen(OUTPUT_CLEAR_SCREEN);
+
+  /* Find the last clear screen sequence. */
+  for (const char *p = start;
+       (p = memmem(p, length - (p - start), OUTPUT_CLEAR_SCREEN,
+                   clear_length)) != NULL;
+       p += clear_length)
+    clear = p;
+
+  /* Everything before it would be erased at once. */
+  if (clear != NULL) {
+    nr_segments = 0;
+    length -= clear - start;
+    offset += clear - start;
+
+    if (text != NULL)
+      text = clear;
+  }
+
+  if (length == 0)
+    return;
+
+  /* Formatted text that follows formatted text is one piece. */
+  if (text == NULL && nr_segments > 0) {
+    struct segment *last = &segments[nr_segments - 1];
+
+    if (last->text == NULL && last->offset + last->length == offset) {
+      last->length += length;
+      return;
+    }
+  }
+
+  segments[nr_segments++] = (struct segment) { text, offset, length };
+}
+
+void output_set_fd(int fd)
+{
+  output_fd = fd;
+}
+
+void output_add(const char *text)
+{
+  if (nr_segments == MAX_SEGMENTS)
+    (void) output_flush();
+
+  add_segment(text, 0, strlen(text));
+}
+
+void output_printf(const char *format, ...)
+{
+  va_list ap;
+  int length;
+
+  /* Flushing afterwards would throw away the formatted text. */
+  if (nr_segments == MAX_SEGMENTS)
+    (void) output_flush();
+
+  va_start(ap, format);
+  length = vsnprintf(NULL, 0, format, ap);
+  va_end(ap);
+
+  if (length <= 0)
+    return;
+
+  if (formatted_length + length + 1 > formatted_size) {
+    formatted_size = 2 * (formatted_length + length + 1);
+    formatted = g_realloc(formatted, formatted_size);
+  }
+
+  va_start(ap, format);
+  (void) vsnprintf(formatted + formatted_length, length + 1, format, ap);
+  va_end(ap);
+
+  add_segment(NULL, formatted_length, length);
+  formatted_length += length;
+}
+
+/* Copy the current frame if it clears the screen. */
+static char *copy_frame(size_t *length)
+{
+  size_t clear_length = strlen(OUTPUT_CLEAR_SCREEN);
+  char *frame;
+
+  *length = 0;
+
+  if (nr_segments == 0 || segments[0].length < clear_length
+      || memcmp(segment_text(&segments[0]), OUTPUT_CLEAR_SCREEN,
+                clear_length) != 0)
+    return NULL;
+
+  for (size_t i = 0; i < nr_segments; i++)
+    *length += segments[i].length;
+
+  frame = g_malloc(*length);
+  *length = 0;
+
+  for (size_t i = 0; i < nr_segments; i++) {
+    memcpy(frame + *length, segment_text(&segments[i]), segments[i].length);
+    *length += segments[i].length;
+  }
+
+  return frame;
+}
+
+bool output_flush(void)
+{
+  struct iovec iov[MAX_SEGMENTS];
+  struct iovec *next = iov;
+  int count = nr_segments;
+  size_t frame_length;
+  char *frame;
+  bool result = true;
+
+  if (nr_segments == 0)
+    return true;
+
+  frame = copy_frame(&frame_length);
+
+  /* The screen already shows this frame. */
+  if (frame != NULL && screen != NULL && frame_length == screen_length
+      && memcmp(frame, screen, frame_length) == 0) {
+    g_free(frame);
+    goto out;
+  }
+
+  for (size_t i = 0; i < nr_segments; i++) {
+    iov[i].iov_base = (void *) segment_text(&segments[i]);
+    iov[i].iov_len = segments[i].length;
+  }
+
+  while (count > 0) {
+    ssize_t written = writev(output_fd, next, count);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+
+      result = false;
+      break;
+    }
+
+    counters_add(VLOCK_COUNTER_TERMINAL_BYTES, written);
+
+    /* Skip what was written. */
+    while (count > 0 && (size_t) written >= next->iov_len) {
+      written -= next->iov_len;
+      next++;
+      count--;
+    }
+
+    if (count > 0) {
+      next->iov_base = (char *) next->iov_base + written;
+      next->iov_len -= written;
+    }
+  }
+
+  g_free(screen);
+  screen = result ? frame : NULL;
+  screen_length = frame_length;
+
+  if (!result)
+    g_free(frame);
+
+out:
+  nr_segments = 0;
+  formatted_length = 0;
+
+  return result;
+}
+
+void output_invalidate(void)
+{
+  g_free(screen);
+  screen = NULL;
+}
@@ -0,0 +1,51 @@
+/* output.h -- header file for the terminal output of vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Everything vlock-main writes to the locked terminal is collected into a
+ * frame and written with a single writev() when the frame is flushed.  This
+ * happens before vlock-main waits for input (see read_character()) or
+ * sleeps, so a slow serial console shows each screen at once instead of
+ * building it up piece by piece.
+ *
+ * The clear screen sequence erases everything before it, so text that was
+ * added to a frame before it is dropped.  A frame that starts with the clear
+ * screen sequence is not written at all if it is the same as the last frame
+ * and nothing changed the screen since, e.g. if the lock message is shown
+ * again. */
+
+#pragma once
+
+#include <stdbool.h>
+
+/* Magic characters to clear the terminal. */
+#define OUTPUT_CLEAR_SCREEN "\033[H\033[J"
+
+/* Write frames to the given file descriptor instead of standard error. */
+void output_set_fd(int fd);
+
+/* Add text to the current frame.  The text is not copied and must stay valid
+ * until the frame is flushed. */
+void output_add(const char *text);
+
+/* Add formatted text to the current frame. */
+void output_printf(const char *format, ...)
+  __attribute__((format(printf, 1, 2)));
+
+/* Write the current frame.  The bytes written are counted as terminal bytes.
+ * Returns false and sets errno if writing failed. */
+bool output_flush(void);
+
+/* Tell that something else may have changed the screen, e.g. a plugin or the
+ * echo of the terminal.  The next frame is written even if it is the same as
+ * the last one. */
+void output_invalidate(void);
@@ -14,28 +14,83 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include <glib.h>
 
 #include "plugin.h"
 #include "util.h"
+#include "counters.h"
+#include "trace.h"
 
 GQuark vlock_plugin_error_quark(void)
 {
   return g_quark_from_static_string("vlock-plugin-error-quark");
 }
 
+#ifndef NO_GLIB
 G_DEFINE_TYPE(VlockPlugin, vlock_plugin, G_TYPE_OBJECT)
+#endif
 
 /* Initialize plugin to default values. */
 static void vlock_plugin_init(VlockPlugin *self)
 {
   self->name = NULL;
   self->save_disabled = false;
+  self->stopped = false;
+  self->saving = false;
+  self->save_skipped = false;
+  self->save_time = 0;
+  self->save_hold = 0;
+  self->save_hold_end = 0;
+  self->static_dependencies = 0;
+  self->capabilities = 0;
   for (size_t i = 0; i < nr_dependencies; i++)
     self->dependencies[i] = NULL;
 }
 
+static void vlock_plugin_set_name(VlockPlugin *self, const gchar *name)
+{
+  /* For security plugin names must not contain a slash. */
+  char *last_slash = strrchr(name, '/');
+
+  if (last_slash != NULL)
+    name = last_slash+1;
+
+  self->name = g_strdup(name);
+}
+
+void vlock_plugin_clear_dependencies(VlockPlugin *self)
+{
+  for (size_t i = 0; i < nr_dependencies; i++) {
+    if (self->static_dependencies & (1u << i)) {
+      self->dependencies[i] = NULL;
+      continue;
+    }
+
+    for (size_t j = 0;
+         self->dependencies[i] != NULL && self->dependencies[i][j] != NULL;
+         j++)
+      g_free(self->dependencies[i][j]);
+
+    g_free(self->dependencies[i]);
+    self->dependencies[i] = NULL;
+  }
+
+  self->static_dependencies = 0;
+}
+
+/* Free the name and the dependencies of the plugin. */
+static void vlock_plugin_clear(VlockPlugin *self)
+{
+  g_free(self->name);
+  self->name = NULL;
+
+  vlock_plugin_clear_dependencies(self);
+}
+
+#ifndef NO_GLIB
+
 /* Create new plugin object. */
 static GObject *vlock_plugin_constructor(GType gtype,
                                          guint n_properties,
@@ -55,17 +110,7 @@ static void vlock_plugin_finalize(GObject *object)
 {
   VlockPlugin *self = VLOCK_PLUGIN(object);
 
-  g_free(self->name);
-  self->name = NULL;
-
-  /* Destroy dependency lists. */
-  for (size_t i = 0; i < nr_dependencies; i++) {
-    while (self->dependencies[i] != NULL) {
-      g_free(self->dependencies[i]->data);
-      self->dependencies[i] = g_list_delete_link(self->dependencies[i],
-                                                 self->dependencies[i]);
-    }
-  }
+  vlock_plugin_clear(self);
 
   G_OBJECT_CLASS(vlock_plugin_parent_class)->finalize(object);
 }
@@ -76,17 +121,6 @@ enum {
   PROP_VLOCK_PLUGIN_NAME
 };
 
-static void vlock_plugin_set_name(VlockPlugin *self, const gchar *name)
-{
-  /* For security plugin names must not contain a slash. */
-  char *last_slash = strrchr(name, '/');
-
-  if (last_slash != NULL)
-    name = last_slash+1;
-
-  self->name = g_strdup(name);
-}
-
 /* Set properties. */
 static void vlock_plugin_set_property(GObject *object,
                                       guint property_id,
@@ -135,6 +169,11 @@ static void vlock_plugin_class_init(VlockPluginClass *klass)
   /* Virtual methods. */
   klass->open = NULL;
   klass->call_hook = NULL;
+  klass->get_pending_hook = NULL;
+  klass->finish_hook = NULL;
+  klass->get_pending_output = NULL;
+  klass->flush_output = NULL;
+  klass->get_usage = NULL;
 
   /* Install overridden methods. */
   gobject_class->constructor = vlock_plugin_constructor;
@@ -158,17 +197,166 @@ static void vlock_plugin_class_init(VlockPluginClass *klass)
     );
 }
 
+VlockPlugin *vlock_plugin_new(VlockPluginType type, const char *name)
+{
+  return VLOCK_PLUGIN(g_object_new(type, "name", name, NULL));
+}
+
+void vlock_plugin_unref(VlockPlugin *self)
+{
+  g_object_unref(self);
+}
+
+#else /* NO_GLIB */
+
+VlockPlugin *vlock_plugin_new(VlockPluginType type, const char *name)
+{
+  VlockPlugin *self = g_malloc0(type->instance_size);
+
+  self->klass = type;
+
+  vlock_plugin_init(self);
+  vlock_plugin_set_name(self, name);
+
+  if (type->init != NULL)
+    type->init(self);
+
+  return self;
+}
+
+void vlock_plugin_unref(VlockPlugin *self)
+{
+  if (self->klass->finalize != NULL)
+    self->klass->finalize(self);
+
+  vlock_plugin_clear(self);
+  g_free(self);
+}
+
+#endif /* NO_GLIB */
+
+void vlock_plugin_add_dependency(VlockPlugin *self,
+                                 size_t dependency,
+                                 const gchar *name)
+{
+  gchar **names = self->dependencies[dependency];
+  size_t length = 0;
+
+  while (names != NULL && names[length] != NULL)
+    length++;
+
+  if (self->static_dependencies & (1u << dependency)) {
+    /* Make a private copy before changing the array. */
+    gchar **copy = g_new(gchar *, length + 2);
+
+    for (size_t i = 0; i < length; i++)
+      copy[i] = g_strdup(names[i]);
+
+    self->static_dependencies &= ~(1u << dependency);
+    names = copy;
+  } else {
+    names = g_renew(gchar *, names, length + 2);
+  }
+
+  names[length] = g_strdup(name);
+  names[length + 1] = NULL;
+
+  self->dependencies[dependency] = names;
+}
+
+void vlock_plugin_set_static_dependency(VlockPlugin *self,
+                                        size_t dependency,
+                                        const char *const *names)
+{
+  g_assert(self->dependencies[dependency] == NULL);
+
+  if (names == NULL || names[0] == NULL)
+    return;
+
+  self->dependencies[dependency] = (gchar **) names;
+  self->static_dependencies |= 1u << dependency;
+}
+
 bool vlock_plugin_open(VlockPlugin *self, GError **error)
 {
-  VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
   g_assert(klass->open != NULL);
   return klass->open(self, error);
 }
 
 bool vlock_plugin_call_hook(VlockPlugin *self, const gchar *hook_name)
 {
-  VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+  bool result;
+#ifdef HAVE_SYS_SDT_H
+  struct timespec start;
+  struct timespec end;
+#endif
+
   g_assert(klass->call_hook != NULL);
-  return klass->call_hook(self, hook_name);
+  counters_add(VLOCK_COUNTER_HOOKS, 1);
+
+  VLOCK_PROBE2(hook__begin, self->name, hook_name);
+
+#ifdef HAVE_SYS_SDT_H
+  (void) clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
+
+  result = klass->call_hook(self, hook_name);
+
+#ifdef HAVE_SYS_SDT_H
+  (void) clock_gettime(CLOCK_MONOTONIC, &end);
+  VLOCK_PROBE4(hook__end, self->name, hook_name, result,
+               (end.tv_sec - start.tv_sec) * 1000000L
+               + (end.tv_nsec - start.tv_nsec) / 1000);
+#endif
+
+  return result;
+}
+
+
+bool vlock_plugin_get_pending_hook(VlockPlugin *self,
+                                   int *fd,
+                                   unsigned int *timeout)
+{
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+
+  if (klass->get_pending_hook == NULL)
+    return false;
+
+  return klass->get_pending_hook(self, fd, timeout);
+}
+
+bool vlock_plugin_finish_hook(VlockPlugin *self, bool cancel)
+{
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+  g_assert(klass->finish_hook != NULL);
+  return klass->finish_hook(self, cancel);
 }
 
+bool vlock_plugin_get_pending_output(VlockPlugin *self, int *fd)
+{
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+
+  if (klass->get_pending_output == NULL)
+    return false;
+
+  return klass->get_pending_output(self, fd);
+}
+
+void vlock_plugin_flush_output(VlockPlugin *self)
+{
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+  g_assert(klass->flush_output != NULL);
+  klass->flush_output(self);
+}
+
+bool vlock_plugin_get_usage(VlockPlugin *self, struct child_usage *usage)
+{
+  const VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+
+  if (klass->get_usage == NULL)
+    return false;
+
+  return klass->get_usage(self, usage);
+}
@@ -14,9 +14,13 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <glib.h>
 #include <glib-object.h>
 
+struct child_usage;
+
 /* Names of dependencies plugins may specify. */
 #define nr_dependencies 6
 extern const char *dependency_names[nr_dependencies];
@@ -32,6 +36,13 @@ struct hook
 #define nr_hooks 4
 extern const struct hook hooks[nr_hooks];
 
+/* Capabilities a plugin may declare.  The values are the same as the module
+ * capability flags in modules/vlock_plugin.h. */
+#define VLOCK_PLUGIN_THREAD_SAFE (1 << 0)
+#define VLOCK_PLUGIN_CHEAP_SAVE (1 << 1)
+#define VLOCK_PLUGIN_DISPLAY (1 << 2)
+#define VLOCK_PLUGIN_LOCK_CRITICAL (1 << 3)
+
 /* Errors */
 #define VLOCK_PLUGIN_ERROR vlock_plugin_error_quark()
 GQuark vlock_plugin_error_quark(void);
@@ -42,6 +53,11 @@ enum {
   VLOCK_PLUGIN_ERROR_NOT_FOUND
 };
 
+typedef struct _VlockPlugin VlockPlugin;
+typedef struct _VlockPluginClass VlockPluginClass;
+
+#ifndef NO_GLIB
+
 /*
  * Plugin type macros.
  */
@@ -59,33 +75,141 @@ enum {
                                                                TYPE_VLOCK_PLUGIN,\
                                                                VlockPluginClass))
 
-typedef struct _VlockPlugin VlockPlugin;
-typedef struct _VlockPluginClass VlockPluginClass;
+/* The type of a plugin class as given to vlock_plugin_new(). */
+typedef GType VlockPluginType;
+
+GType vlock_plugin_get_type(void);
+
+#else /* NO_GLIB */
+
+/* Without GObject a plugin class is a constant structure of function pointers
+ * and every plugin points to its class. */
+#define VLOCK_PLUGIN(obj) ((VlockPlugin *)(obj))
+#define VLOCK_PLUGIN_GET_CLASS(obj) (VLOCK_PLUGIN(obj)->klass)
+
+typedef const VlockPluginClass *VlockPluginType;
+
+#endif /* NO_GLIB */
 
 struct _VlockPlugin
 {
+#ifndef NO_GLIB
   GObject parent_instance;
+#else
+  const VlockPluginClass *klass;
+#endif
 
   gchar *name;
 
-  GList *dependencies[nr_dependencies];
+  /* NULL terminated arrays of plugin names or NULL if empty. */
+  gchar **dependencies[nr_dependencies];
+
+  /* Bit i is set if dependencies[i] is not owned by the plugin, see
+   * vlock_plugin_set_static_dependency(). */
+  unsigned int static_dependencies;
+
+  /* VLOCK_PLUGIN_* capability flags. */
+  unsigned int capabilities;
 
   bool save_disabled;
+
+  /* Set by handle_vlock_start() for the plugins that are not critical for the
+   * lock until plugin_start_best_effort() starts them, and if the vlock_start
+   * hook failed.  No other hooks are called then. */
+  bool stopped;
+
+  /* Rate limit of the vlock_save hook, see handle_vlock_save() in plugins.c.
+   * saving is set from the vlock_save hook until the vlock_save_abort hook,
+   * save_skipped if the vlock_save hook was held back in the current save.
+   * The times are milliseconds of the monotonic clock. */
+  bool saving;
+  bool save_skipped;
+  uint64_t save_time;
+  unsigned int save_hold;
+  uint64_t save_hold_end;
 };
 
 struct _VlockPluginClass
 {
+#ifndef NO_GLIB
   GObjectClass parent_class;
+#else
+  /* Size of the instance structure including private data. */
+  size_t instance_size;
+
+  /* Called after the generic parts of the plugin are initialized and before
+   * they are destroyed, respectively.  Both may be NULL. */
+  void (*init)(VlockPlugin *self);
+  void (*finalize)(VlockPlugin *self);
+#endif
 
   bool (*open)(VlockPlugin *self, GError **error);
   bool (*call_hook)(VlockPlugin *self, const gchar *hook_name);
+
+  /* Asynchronous hooks.  Both are optional, see vlock_plugin_get_pending_hook()
+   * and vlock_plugin_finish_hook() below. */
+  bool (*get_pending_hook)(VlockPlugin *self, int *fd, unsigned int *timeout);
+  bool (*finish_hook)(VlockPlugin *self, bool cancel);
+
+  /* Queued hook calls.  Both are optional, see
+   * vlock_plugin_get_pending_output() and vlock_plugin_flush_output()
+   * below. */
+  bool (*get_pending_output)(VlockPlugin *self, int *fd);
+  void (*flush_output)(VlockPlugin *self);
+
+  /* Resource usage, optional, see vlock_plugin_get_usage() below. */
+  bool (*get_usage)(VlockPlugin *self, struct child_usage *usage);
 };
 
-GType vlock_plugin_get_type(void);
+/* Create a plugin of the given type with the given name. */
+VlockPlugin *vlock_plugin_new(VlockPluginType type, const char *name);
+
+/* Destroy the plugin. */
+void vlock_plugin_unref(VlockPlugin *self);
 
 /* Open the plugin. */
 bool vlock_plugin_open(VlockPlugin *self, GError **error);
 
-GList *vlock_plugin_get_dependencies(VlockPlugin *self,
-                                     const gchar *dependency_name);
+/* Append a copy of the given name to the dependencies of the plugin. */
+void vlock_plugin_add_dependency(VlockPlugin *self,
+                                 size_t dependency,
+                                 const gchar *name);
+
+/* Use the given NULL terminated array of names as the dependency without
+ * copying it.  The array must stay valid as long as the plugin exists.  It is
+ * copied if more names are added later. */
+void vlock_plugin_set_static_dependency(VlockPlugin *self,
+                                        size_t dependency,
+                                        const char *const *names);
+
+/* Free the dependencies of the plugin.  They are only needed to resolve the
+ * dependencies between the plugins. */
+void vlock_plugin_clear_dependencies(VlockPlugin *self);
+
 bool vlock_plugin_call_hook(VlockPlugin *self, const gchar *hook_name);
+
+/* A hook may start an action that takes longer and return before it is
+ * finished.  Returns true if this happened and the action is still running.
+ * In this case fd is set to a file descriptor that becomes readable when the
+ * action is finished and timeout to the number of milliseconds to wait for
+ * it. */
+bool vlock_plugin_get_pending_hook(VlockPlugin *self,
+                                   int *fd,
+                                   unsigned int *timeout);
+
+/* Finish the running action after its file descriptor became readable or
+ * cancel it.  Returns the result of the hook. */
+bool vlock_plugin_finish_hook(VlockPlugin *self, bool cancel);
+
+/* A hook call may be queued if the plugin is busy, e.g. a script that does
+ * not read its input for a while.  Returns true if hook calls are queued.  In
+ * this case fd is set to a file descriptor that becomes writable when more
+ * of them can be passed on. */
+bool vlock_plugin_get_pending_output(VlockPlugin *self, int *fd);
+
+/* Pass on as many queued hook calls as possible without blocking. */
+void vlock_plugin_flush_output(VlockPlugin *self);
+
+/* Get the resources used by the processes of the plugin so far.  Returns
+ * false if the plugin has no processes. */
+bool vlock_plugin_get_usage(VlockPlugin *self, struct child_usage *usage);
@@ -15,6 +15,10 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
 
 #include <glib.h>
 
@@ -23,13 +27,43 @@
 #include "tsort.h"
 
 #include "plugin.h"
+#ifndef VLOCK_SYNTHETIC_PLUGINS
 #include "module.h"
+#include "manifest.h"
 #include "script.h"
+#else
+#include "synthetic.h"
+#endif
 
+#include "process.h"
 #include "util.h"
-
-/* the list of plugins */
-static GList *plugins = NULL;
+#include "logging.h"
+#include "counters.h"
+#include "trace.h"
+
+/* the array of plugins */
+static VlockPlugin **plugins = NULL;
+static size_t nr_plugins = 0;
+
+/* Open addressing hash table of the indices of the loaded plugins plus one,
+ * by name.  Its size is a power of two and at least twice the number of
+ * plugins.  It is rebuilt whenever the array is reordered. */
+static size_t *plugin_table = NULL;
+static size_t plugin_table_size = 0;
+
+/* Set between plugin_wake_display() and plugin_wake_finish(). */
+static bool waking = false;
+/* The hook whose asynchronous calls were left running by
+ * plugin_start_best_effort() or plugin_wake_finish(), or NULL. */
+static const char *background_hook = NULL;
+
+/* A save of a plugin is short if its vlock_save_abort hook is called sooner
+ * than this after its vlock_save hook, e.g. when a key is stuck or pressed
+ * over and over.  After a short save the vlock_save hook of the plugin is held
+ * back for this long, twice as long after every further short save but at
+ * most SAVE_MAX_HOLD_MS.  A save that is not short ends the hold back. */
+#define SAVE_DWELL_MS 1000
+#define SAVE_MAX_HOLD_MS 60000
 
 /****************/
 /* dependencies */
@@ -78,24 +112,103 @@ static bool sort_plugins(GError **error);
 
 bool load_plugin(const char *name, GError **error)
 {
-  return __load_plugin(name, error) != NULL;
+  bool result;
+
+  VLOCK_PROBE1(plugin__load__begin, name);
+  result = __load_plugin(name, error) != NULL;
+  VLOCK_PROBE2(plugin__load__end, name, result);
+
+  return result;
 }
 
 bool resolve_dependencies(GError **error)
 {
-  return __resolve_depedencies(error) && sort_plugins(error);
+  bool result;
+
+  VLOCK_PROBE1(resolve__begin, nr_plugins);
+  result = __resolve_depedencies(error) && sort_plugins(error);
+  VLOCK_PROBE2(resolve__end, nr_plugins, result);
+
+  return result;
+}
+
+void release_plugin_dependencies(void)
+{
+  for (size_t i = 0; i < nr_plugins; i++)
+    vlock_plugin_clear_dependencies(plugins[i]);
 }
 
 void unload_plugins(void)
 {
-  while (plugins != NULL) {
-    g_object_unref(plugins->data);
-    plugins = g_list_delete_link(plugins, plugins);
+  /* Hooks that are still running are cancelled by the plugins. */
+  waking = false;
+  background_hook = NULL;
+
+  while (nr_plugins > 0)
+    vlock_plugin_unref(plugins[--nr_plugins]);
+
+  g_free(plugins);
+  plugins = NULL;
+
+  g_free(plugin_table);
+  plugin_table = NULL;
+  plugin_table_size = 0;
+}
+
+static VlockPlugin *get_plugin(const char *name);
+
+bool is_plugin_loaded(const char *name)
+{
+  return get_plugin(name) != NULL;
+}
+
+char *get_plugin_names(void)
+{
+  size_t length = 0;
+  char *names;
+  char *p;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    length += strlen(plugins[i]->name) + 1;
+
+  p = names = g_malloc(length + 1);
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    if (i > 0)
+      *p++ = ' ';
+
+    p = stpcpy(p, plugins[i]->name);
+  }
+
+  *p = '\0';
+
+  return names;
+}
+
+void print_plugin_usage(FILE *file)
+{
+  for (size_t i = 0; i < nr_plugins; i++) {
+    struct child_usage usage;
+
+    if (vlock_plugin_get_usage(plugins[i], &usage))
+      fprintf(file,
+              "vlock: plugin %s cpu-ms=%llu peak-rss-kb=%llu processes=%u\n",
+              plugins[i]->name,
+              (unsigned long long) (usage.cpu_usec / 1000),
+              (unsigned long long) usage.peak_rss_kb,
+              usage.processes);
   }
 }
 
+static void collect_background_hooks(void);
+
 void plugin_hook(const char *hook_name)
 {
+  /* Complete a wake up that was interrupted and collect the hooks it left
+   * running. */
+  plugin_wake_finish();
+  collect_background_hooks();
+
   for (size_t i = 0; i < nr_hooks; i++)
     /* Get the handler and call it. */
     if (strcmp(hook_name, hooks[i].name) == 0) {
@@ -108,23 +221,81 @@ void plugin_hook(const char *hook_name)
 /* helper functions */
 /********************/
 
-static gint plugin_name_compare(VlockPlugin *p, const char *name)
+/* FNV-1a hash of a plugin name. */
+static size_t hash_name(const char *name)
+{
+  uint32_t h = 2166136261u;
+
+  for (const unsigned char *c = (const unsigned char *) name; *c != '\0'; c++)
+    h = (h ^ *c) * 16777619u;
+
+  return h;
+}
+
+/* Return the slot of the named plugin in the table or the empty slot where it
+ * would be inserted. */
+static size_t *lookup_slot(const char *name)
 {
-  return strcmp(name, p->name);
+  size_t mask = plugin_table_size - 1;
+
+  for (size_t i = hash_name(name) & mask;; i = (i + 1) & mask)
+    if (plugin_table[i] == 0
+        || strcmp(name, plugins[plugin_table[i] - 1]->name) == 0)
+      return &plugin_table[i];
+}
+
+/* Rebuild the table from the array of plugins. */
+static void rebuild_plugin_table(void)
+{
+  size_t size = 16;
+
+  while (size < 2 * nr_plugins)
+    size *= 2;
+
+  g_free(plugin_table);
+  plugin_table = g_new0(size_t, size);
+  plugin_table_size = size;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    *lookup_slot(plugins[i]->name) = i + 1;
+}
+
+#define NO_PLUGIN ((size_t) -1)
+
+/* Return the index of the named plugin or NO_PLUGIN. */
+static size_t get_plugin_index(const char *name)
+{
+  if (plugin_table == NULL)
+    return NO_PLUGIN;
+
+  return *lookup_slot(name) - 1;
 }
 
 static VlockPlugin *get_plugin(const char *name)
 {
-  GList *item = g_list_find_custom(plugins,
-                                   name,
-                                   (GCompareFunc) plugin_name_compare);
+  size_t i = get_plugin_index(name);
+
+  return i != NO_PLUGIN ? plugins[i] : NULL;
+}
 
-  if (item != NULL)
-    return item->data;
+/* Append a plugin that was just opened to the array of plugins. */
+static void add_plugin(VlockPlugin *p)
+{
+  plugins = g_renew(VlockPlugin *, plugins, nr_plugins + 1);
+  plugins[nr_plugins++] = p;
+
+  if (2 * nr_plugins > plugin_table_size)
+    rebuild_plugin_table();
   else
-    return NULL;
+    *lookup_slot(p->name) = nr_plugins;
 }
 
+/* Iterate over the names in a (possibly NULL) dependency array. */
+#define for_each_dependency(d, dependency_array) \
+  for (gchar **dep_iter_ = (dependency_array); \
+       dep_iter_ != NULL && ((d) = *dep_iter_) != NULL; \
+       dep_iter_++)
+
 /* Load and return the named plugin. */
 static VlockPlugin *__load_plugin(const char *name, GError **error)
 {
@@ -136,7 +307,19 @@ static VlockPlugin *__load_plugin(const char *name, GError **error)
   GError *err = NULL;
 
   /* Possible plugin types. */
-  GType plugin_types[] = { TYPE_VLOCK_MODULE, TYPE_VLOCK_SCRIPT, 0 };
+#ifndef VLOCK_SYNTHETIC_PLUGINS
+  /* A manifest is tried before a script of the same name because it does not
+   * need to start the script to get the dependencies. */
+  VlockPluginType plugin_types[] = {
+    TYPE_VLOCK_MODULE,
+    TYPE_VLOCK_MANIFEST,
+    TYPE_VLOCK_SCRIPT,
+    0
+  };
+#else
+  /* The tests and benchmarks only use in-memory plugins, see synthetic.h. */
+  VlockPluginType plugin_types[] = { TYPE_VLOCK_SYNTHETIC, 0 };
+#endif
 
   for (size_t i = 0; plugin_types[i] != 0; i++) {
     if (err == NULL || g_error_matches(err,
@@ -149,7 +332,7 @@ static VlockPlugin *__load_plugin(const char *name, GError **error)
       break;
 
     /* Create the plugin. */
-    p = g_object_new(plugin_types[i], "name", name, NULL);
+    p = vlock_plugin_new(plugin_types[i], name);
 
     /* Try to open the plugin. */
     if (vlock_plugin_open(p, &err)) {
@@ -157,7 +340,7 @@ static VlockPlugin *__load_plugin(const char *name, GError **error)
       break;
     } else {
       g_assert(err != NULL);
-      g_object_unref(p);
+      vlock_plugin_unref(p);
       p = NULL;
     }
   }
@@ -171,29 +354,52 @@ static VlockPlugin *__load_plugin(const char *name, GError **error)
   } else {
     g_assert(p != NULL);
 
-    plugins = g_list_append(plugins, p);
+    add_plugin(p);
 
     return p;
   }
 }
 
-/* Resolve the dependencies of the plugins. */
+/* Remove a plugin from the graph and add it to the worklist unless it was
+ * removed before. */
+#define remove_plugin(i, name) \
+  do { \
+    if (missing[i] == NULL) { \
+      missing[i] = (name); \
+      worklist[nr_work++] = (i); \
+    } \
+  } while (0)
+
+/* Resolve the dependencies of the plugins.
+ *
+ * First the plugins that are required by loaded plugins are loaded.  Then
+ * plugins are removed if one of their "depends" dependencies is not loaded.
+ * Removing a plugin may break the plugins that depend on it, so these are
+ * found through a reverse index and removed in turn until nothing changes.
+ * Every plugin enters the worklist at most once, so this takes time linear in
+ * the number of plugins and dependencies.  Last the plugins that remain are
+ * checked against their "requires", "needs" and "conflicts" dependencies. */
 static bool __resolve_depedencies(GError **error)
 {
-  GList *required_plugins = NULL;
+  const char *d;
+  /* The plugins that depend on plugin j are
+   * dependents[first_dependent[j]] to dependents[first_dependent[j + 1] - 1]. */
+  size_t *first_dependent;
+  size_t *dependents;
+  size_t nr_edges = 0;
+  /* For removed plugins the name of the missing dependency, otherwise NULL. */
+  const char **missing;
+  size_t *worklist;
+  size_t nr_work = 0;
+  bool result = true;
 
   /* Load plugins that are required.  This automagically takes care of plugins
    * that are required by the plugins loaded here because they are appended to
-   * the end of the list. */
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL;
-       plugin_item = g_list_next(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
-
-    for (GList *dependency_item = p->dependencies[REQUIRES];
-         dependency_item != NULL;
-         dependency_item = g_list_next(dependency_item)) {
-      const char *d = dependency_item->data;
+   * the end of the array. */
+  for (size_t i = 0; i < nr_plugins; i++) {
+    VlockPlugin *p = plugins[i];
+
+    for_each_dependency(d, p->dependencies[REQUIRES]) {
       VlockPlugin *q = __load_plugin(d, NULL);
 
       if (q == NULL) {
@@ -202,98 +408,98 @@ static bool __resolve_depedencies(GError **error)
           VLOCK_PLUGIN_ERROR,
           VLOCK_PLUGIN_ERROR_DEPENDENCY,
           "'%s' requires '%s' which could not be loaded", p->name, d);
-        g_list_free(required_plugins);
         return false;
       }
+    }
+  }
+
+  /* All plugins are loaded now.  Build the reverse index of the "depends"
+   * dependencies. */
+  first_dependent = g_new0(size_t, nr_plugins + 1);
+  missing = g_new0(const char *, nr_plugins);
+  worklist = g_new(size_t, nr_plugins);
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    for_each_dependency(d, plugins[i]->dependencies[DEPENDS]) {
+      size_t j = get_plugin_index(d);
+
+      if (j != NO_PLUGIN) {
+        first_dependent[j]++;
+        nr_edges++;
+      }
+    }
 
-      required_plugins = g_list_append(required_plugins, p);
+  /* Point behind the range of each plugin ... */
+  for (size_t j = 1; j < nr_plugins; j++)
+    first_dependent[j] += first_dependent[j - 1];
+
+  first_dependent[nr_plugins] = nr_edges;
+  dependents = g_new(size_t, nr_edges);
+
+  /* ... and move back to its start while filling it. */
+  for (size_t i = 0; i < nr_plugins; i++)
+    for_each_dependency(d, plugins[i]->dependencies[DEPENDS]) {
+      size_t j = get_plugin_index(d);
+
+      if (j == NO_PLUGIN)
+        remove_plugin(i, d);
+      else
+        dependents[--first_dependent[j]] = i;
     }
+
+  /* Remove the plugins that depend on removed plugins. */
+  while (nr_work > 0) {
+    size_t j = worklist[--nr_work];
+
+    for (size_t k = first_dependent[j]; k < first_dependent[j + 1]; k++)
+      remove_plugin(dependents[k], plugins[j]->name);
   }
 
-  /* Fail if a plugins that is needed is not loaded. */
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL;
-       plugin_item = g_list_next(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
+  /* Check the plugins that remain. */
+  for (size_t i = 0; result && i < nr_plugins; i++) {
+    VlockPlugin *p = plugins[i];
 
-    for (GList *dependency_item = p->dependencies[NEEDS];
-         dependency_item != NULL;
-         dependency_item = g_list_next(dependency_item)) {
-      const char *d = dependency_item->data;
-      VlockPlugin *q = get_plugin(d);
+    if (missing[i] != NULL)
+      continue;
 
-      if (q == NULL) {
+    for_each_dependency(d, p->dependencies[NEEDS]) {
+      if (get_plugin_index(d) == NO_PLUGIN) {
         g_set_error(
           error,
           VLOCK_PLUGIN_ERROR,
           VLOCK_PLUGIN_ERROR_DEPENDENCY,
           "'%s' needs '%s' which is not loaded", p->name, d);
-        g_list_free(required_plugins);
-        errno = 0;
-        return false;
+        result = false;
+        break;
       }
-
-      required_plugins = g_list_append(required_plugins, q);
     }
-  }
 
-  /* Unload plugins whose prerequisites are not present, fail if those plugins
-   * are required. */
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL; ) {
-    VlockPlugin *p = plugin_item->data;
-    bool dependencies_loaded = true;
-
-    for (GList *dependency_item = p->dependencies[DEPENDS];
-         dependency_item != NULL;
-         dependency_item = g_list_next(dependency_item)) {
-      const char *d = dependency_item->data;
-      VlockPlugin *q = get_plugin(d);
+    for (size_t n = REQUIRES; result && n <= NEEDS; n++)
+      for_each_dependency(d, p->dependencies[n]) {
+        size_t j = get_plugin_index(d);
 
-      if (q == NULL) {
-        dependencies_loaded = false;
-
-        /* Abort if dependencies not met and plugin is required. */
-        if (g_list_find(required_plugins, p) != NULL) {
+        /* Fail if a plugin that is required or needed was removed. */
+        if (j != NO_PLUGIN && missing[j] != NULL) {
           g_set_error(
             error,
             VLOCK_PLUGIN_ERROR,
             VLOCK_PLUGIN_ERROR_DEPENDENCY,
             "'%s' is required by some other plugin but depends on '%s' which is not loaded",
-            p->name,
-            d);
-          g_list_free(required_plugins);
-          errno = 0;
-          return false;
+            plugins[j]->name,
+            missing[j]);
+          result = false;
+          break;
         }
-
-        break;
       }
-    }
-
-    GList *next_plugin_item = g_list_next(plugin_item);
-
-    if (!dependencies_loaded) {
-      g_object_unref(p);
-      plugins = g_list_delete_link(plugins, plugin_item);
-    }
 
-    plugin_item = next_plugin_item;
-  }
-
-  g_list_free(required_plugins);
+    if (!result)
+      break;
 
-  /* Fail if conflicting plugins are loaded. */
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL;
-       plugin_item = g_list_next(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
+    /* Fail if conflicting plugins remain. */
+    for_each_dependency(d, p->dependencies[CONFLICTS]) {
+      size_t j = get_plugin_index(d);
 
-    for (GList *dependency_item = p->dependencies[CONFLICTS];
-         dependency_item != NULL;
-         dependency_item = g_list_next(dependency_item)) {
-      const char *d = dependency_item->data;
-      if (get_plugin(d) != NULL) {
+      if (j != NO_PLUGIN && missing[j] == NULL) {
         g_set_error(
           error,
           VLOCK_PLUGIN_ERROR,
@@ -301,182 +507,604 @@ static bool __resolve_depedencies(GError **error)
           "'%s' and '%s' cannot be loaded at the same time",
           p->name,
           d);
-        errno = 0;
-        return false;
+        result = false;
+        break;
       }
     }
   }
 
-  return true;
+  /* Unload the removed plugins.  The array is compacted in place.  If
+   * resolving failed the remaining plugins are unloaded later. */
+  size_t nr_loaded_plugins = 0;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    if (missing[i] == NULL)
+      plugins[nr_loaded_plugins++] = plugins[i];
+    else
+      vlock_plugin_unref(plugins[i]);
+
+  nr_plugins = nr_loaded_plugins;
+  rebuild_plugin_table();
+
+  g_free(first_dependent);
+  g_free(dependents);
+  g_free(missing);
+  g_free(worklist);
+
+  if (!result)
+    errno = 0;
+
+  return result;
 }
 
-static GList *get_edges(void);
+#undef remove_plugin
+
+static struct edge *get_edges(size_t *nr_edges);
+static void mark_lock_critical(void);
 
-/* Sort the list of plugins according to their "preceeds" and "succeeds"
+/* Sort the array of plugins according to their "preceeds" and "succeeds"
 * dependencies.  Fails if sorting is not possible because of circles. */
 static bool sort_plugins(GError **error)
 {
-  GList *edges = get_edges();
-  GList *sorted_plugins;
+  size_t nr_edges;
+  struct edge *edges = get_edges(&nr_edges);
 
   /* Topological sort. */
-  sorted_plugins = tsort(plugins, &edges);
+  bool tsort_successful = tsort((void **) plugins, nr_plugins,
+                                edges, &nr_edges);
 
-  bool tsort_successful = (edges == NULL);
+  /* The indices in the table changed. */
+  rebuild_plugin_table();
 
   if (tsort_successful) {
-    /* Switch the global list of plugins for the sorted list.  The global list
-     * is static and cannot be freed. */
-
-    g_assert(edges == NULL);
-    g_assert(g_list_length(sorted_plugins) == g_list_length(plugins));
-
-    GList *tmp = plugins;
-    plugins = sorted_plugins;
-
-    g_list_free(tmp);
-
+    g_assert(nr_edges == 0);
+    g_free(edges);
+    mark_lock_critical();
     return true;
   } else {
-    GString *error_message = g_string_new("circular dependencies detected:");
-
-    while (edges != NULL) {
-      struct edge *e = edges->data;
-      VlockPlugin *p = e->predecessor;
-      VlockPlugin *s = e->successor;
-
-      g_string_append_printf(error_message,
-                             "\n\t'%s'\tmust come before\t'%s'",
-                             p->name,
-                             s->name);
-      g_free(e);
-      edges = g_list_delete_link(edges, edges);
+    char *error_message = g_strdup("circular dependencies detected:");
+
+    for (size_t i = 0; i < nr_edges; i++) {
+      VlockPlugin *p = edges[i].predecessor;
+      VlockPlugin *s = edges[i].successor;
+      char *tmp = g_strdup_printf("%s\n\t'%s'\tmust come before\t'%s'",
+                                  error_message,
+                                  p->name,
+                                  s->name);
+
+      g_free(error_message);
+      error_message = tmp;
     }
 
+    g_free(edges);
+
     g_set_error(error,
                 VLOCK_PLUGIN_ERROR,
                 VLOCK_PLUGIN_ERROR_DEPENDENCY,
                 "%s",
-                error_message->str);
+                error_message);
 
-    g_string_free(error_message, true);
+    g_free(error_message);
     return false;
   }
 }
 
 /* Get the edges of the plugin graph specified by each plugin's "preceeds" and
  * "succeeds" dependencies. */
-static GList *get_edges(void)
+static struct edge *get_edges(size_t *nr_edges)
 {
-  GList *edges = NULL;
+  const char *d;
+  size_t max_edges = 0;
+  struct edge *edges;
+
+  /* Count the dependencies first to allocate the array at once. */
+  for (size_t i = 0; i < nr_plugins; i++) {
+    for_each_dependency(d, plugins[i]->dependencies[SUCCEEDS])
+      max_edges++;
+    for_each_dependency(d, plugins[i]->dependencies[PRECEEDS])
+      max_edges++;
+  }
+
+  edges = g_new(struct edge, max_edges);
+  *nr_edges = 0;
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    VlockPlugin *p = plugins[i];
 
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL;
-       plugin_item = g_list_next(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
     /* p must come after these */
-    for (GList *predecessor_item = p->dependencies[SUCCEEDS];
-         predecessor_item != NULL;
-         predecessor_item = g_list_next(predecessor_item)) {
-      VlockPlugin *q = get_plugin(predecessor_item->data);
+    for_each_dependency(d, p->dependencies[SUCCEEDS]) {
+      VlockPlugin *q = get_plugin(d);
 
       if (q != NULL)
-        edges = g_list_append(edges, make_edge(q, p));
+        edges[(*nr_edges)++] = (struct edge) { q, p };
     }
 
     /* p must come before these */
-    for (GList *successor_item = p->dependencies[PRECEEDS];
-         successor_item != NULL;
-         successor_item = g_list_next(successor_item)) {
-      VlockPlugin *q = get_plugin(successor_item->data);
+    for_each_dependency(d, p->dependencies[PRECEEDS]) {
+      VlockPlugin *q = get_plugin(d);
 
       if (q != NULL)
-        edges = g_list_append(edges, make_edge(p, q));
+        edges[(*nr_edges)++] = (struct edge) { p, q };
     }
   }
 
   return edges;
 }
 
+/* The plugins that are critical for the lock are started first.  A plugin
+ * that must come before one of them is therefore critical, too.  The array is
+ * sorted, so walking it backwards sees every plugin after all plugins that
+ * must come after it. */
+static void mark_lock_critical(void)
+{
+  const char *d;
+
+  for (size_t i = nr_plugins; i-- > 0;) {
+    VlockPlugin *p = plugins[i];
+
+    for_each_dependency(d, p->dependencies[PRECEEDS]) {
+      VlockPlugin *q = get_plugin(d);
+
+      if (q != NULL && (q->capabilities & VLOCK_PLUGIN_LOCK_CRITICAL))
+        p->capabilities |= VLOCK_PLUGIN_LOCK_CRITICAL;
+    }
+
+    if (p->capabilities & VLOCK_PLUGIN_LOCK_CRITICAL)
+      for_each_dependency(d, p->dependencies[SUCCEEDS]) {
+        VlockPlugin *q = get_plugin(d);
+
+        if (q != NULL)
+          q->capabilities |= VLOCK_PLUGIN_LOCK_CRITICAL;
+      }
+  }
+}
+
 /************/
 /* handlers */
 /************/
 
-/* Call the "vlock_start" hook of each plugin.  Fails if the hook of one of the
- * plugins fails.  In this case the "vlock_end" hooks of all plugins that were
- * called before are called in reverse order. */
+/* How to wait for asynchronous hooks. */
+enum async_wait {
+  /* Wait until they are finished or their timeouts expire. */
+  ASYNC_WAIT,
+  /* Same as above but cancel them when input is available on the terminal. */
+  ASYNC_WAIT_UNTIL_INPUT,
+  /* Cancel them at once. */
+  ASYNC_CANCEL,
+};
+
+static uint64_t monotonic_milliseconds(void)
+{
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Finish the asynchronous hooks that are still running after the given hook
+ * was called.  All hooks are waited for at the same time.  Returns NULL if
+ * none of them failed or else an array that tells for each plugin if its hook
+ * failed.  The array must be freed with g_free(). */
+static bool *finish_async_hooks(const char *hook_name, enum async_wait wait)
+{
+  size_t nr_pending = 0;
+  int fd;
+  unsigned int timeout;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    if (vlock_plugin_get_pending_hook(plugins[i], &fd, &timeout))
+      nr_pending++;
+
+  /* Nothing to do in the common case. */
+  if (nr_pending == 0)
+    return NULL;
+
+  bool watch_input = wait == ASYNC_WAIT_UNTIL_INPUT && isatty(STDIN_FILENO);
+  struct pollfd *fds = g_new(struct pollfd, nr_pending + 1);
+  size_t *pending = g_new(size_t, nr_pending);
+  uint64_t *deadlines = g_new(uint64_t, nr_pending);
+  uint64_t now = monotonic_milliseconds();
+  bool *failed = NULL;
+
+  nr_pending = 0;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    if (vlock_plugin_get_pending_hook(plugins[i], &fd, &timeout)) {
+      pending[nr_pending] = i;
+      deadlines[nr_pending] = now + timeout;
+      nr_pending++;
+    }
+
+  while (nr_pending > 0) {
+    size_t nr_fds = nr_pending;
+    bool cancel_all = wait == ASYNC_CANCEL;
+    int poll_timeout = -1;
+
+    if (!cancel_all) {
+      for (size_t j = 0; j < nr_pending; j++) {
+        int remaining = deadlines[j] > now ? (int) (deadlines[j] - now) : 0;
+
+        (void) vlock_plugin_get_pending_hook(plugins[pending[j]], &fd,
+                                             &timeout);
+        fds[j] = (struct pollfd) { .fd = fd, .events = POLLIN };
+
+        if (poll_timeout < 0 || remaining < poll_timeout)
+          poll_timeout = remaining;
+      }
+
+      if (watch_input)
+        fds[nr_fds++] = (struct pollfd) { .fd = STDIN_FILENO, .events = POLLIN };
+
+      int ready = poll(fds, nr_fds, poll_timeout);
+
+      counters_add(VLOCK_COUNTER_WAKEUPS, 1);
+      now = monotonic_milliseconds();
+
+      if (ready < 0) {
+        if (errno == EINTR)
+          continue;
+
+        cancel_all = true;
+      } else if (watch_input && (fds[nr_pending].revents & POLLIN)) {
+        /* A key was pressed. */
+        cancel_all = true;
+      }
+    }
+
+    /* Walk backwards so that moving the last entry into a finished one does
+     * not skip anything. */
+    for (size_t j = nr_pending; j-- > 0;) {
+      bool done = !cancel_all && fds[j].revents != 0;
+
+      if (!done && !cancel_all && now < deadlines[j])
+        continue;
+
+      VlockPlugin *p = plugins[pending[j]];
+
+      if (!vlock_plugin_finish_hook(p, !done)) {
+        vlock_log_event(VLOCK_EVENT_PLUGIN_FAILURE, p->name, hook_name, errno);
+
+        if (failed == NULL)
+          failed = g_new0(bool, nr_plugins);
+
+        failed[pending[j]] = true;
+      }
+
+      nr_pending--;
+      pending[j] = pending[nr_pending];
+      deadlines[j] = deadlines[nr_pending];
+      fds[j] = fds[nr_pending];
+    }
+  }
+
+  g_free(fds);
+  g_free(pending);
+  g_free(deadlines);
+
+  return failed;
+}
+
+static bool is_lock_critical(VlockPlugin *p)
+{
+  return (p->capabilities & VLOCK_PLUGIN_LOCK_CRITICAL) != 0;
+}
+
+/* Call the "vlock_start" hook of each plugin that is critical for the lock.
+ * The other plugins are stopped until plugin_start_best_effort() is called.
+ * Fails if the hook of one of the plugins fails.  In this case the
+ * "vlock_end" hooks of all plugins that were called before are called in
+ * reverse order.  Asynchronous hooks are waited for after all plugins were
+ * called and are cancelled if a hook failed. */
 void handle_vlock_start(const char *hook_name)
 {
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL;
-       plugin_item = g_list_next(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
+  VlockPlugin *failed_plugin = NULL;
+  int errsv = 0;
+  size_t nr_started;
+
+  for (nr_started = 0; nr_started < nr_plugins; nr_started++) {
+    VlockPlugin *p = plugins[nr_started];
+
+    if (!is_lock_critical(p)) {
+      p->stopped = true;
+      continue;
+    }
 
     if (!vlock_plugin_call_hook(p, hook_name)) {
-      int errsv = errno;
+      errsv = errno;
+      vlock_log_event(VLOCK_EVENT_PLUGIN_FAILURE, p->name, hook_name, errsv);
+      failed_plugin = p;
+      break;
+    }
+  }
+
+  bool *failed = finish_async_hooks(hook_name,
+                                    failed_plugin == NULL ? ASYNC_WAIT
+                                                          : ASYNC_CANCEL);
+
+  if (failed_plugin == NULL && failed == NULL)
+    return;
 
-      for (GList *reverse_item = g_list_previous(plugin_item);
-           reverse_item != NULL;
-           reverse_item = g_list_previous(reverse_item)) {
-        VlockPlugin *r = reverse_item->data;
-        (void) vlock_plugin_call_hook(r, "vlock_end");
+  if (failed_plugin == NULL)
+    for (size_t i = 0; i < nr_plugins; i++)
+      if (failed[i]) {
+        failed_plugin = plugins[i];
+        break;
       }
 
-      if (errsv)
-        fprintf(stderr, "vlock: plugin '%s' failed: %s\n", p->name,
-                strerror(errsv));
+  for (size_t j = nr_started; j > 0; j--) {
+    VlockPlugin *r = plugins[j - 1];
+
+    if (!r->stopped && (failed == NULL || !failed[j - 1]))
+      (void) vlock_plugin_call_hook(r, "vlock_end");
+  }
+
+  g_free(failed);
+  g_free(finish_async_hooks("vlock_end", ASYNC_WAIT));
 
-      exit(EXIT_FAILURE);
+  /* The reason of a failed asynchronous hook is not known. */
+  if (errsv)
+    fprintf(stderr, "vlock: plugin '%s' failed: %s\n", failed_plugin->name,
+            strerror(errsv));
+  else
+    fprintf(stderr, "vlock: plugin '%s' failed\n", failed_plugin->name);
+
+  exit(EXIT_FAILURE);
+}
+
+void plugin_start_best_effort(void)
+{
+  const char *hook_name = "vlock_start";
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    VlockPlugin *p = plugins[i];
+
+    if (is_lock_critical(p))
+      continue;
+
+    p->stopped = !vlock_plugin_call_hook(p, hook_name);
+
+    if (p->stopped) {
+      vlock_log_event(VLOCK_EVENT_PLUGIN_FAILURE, p->name, hook_name, errno);
+
+      /* A busy plugin is not given up. */
+      p->stopped = errno != EAGAIN;
     }
   }
+
+  background_hook = hook_name;
 }
 
-/* Call the "vlock_end" hook of each plugin in reverse order.  Never fails. */
+/* Call the "vlock_end" hook of each plugin that was started in reverse order.
+ * Never fails. */
 void handle_vlock_end(const char *hook_name)
 {
-  for (GList *plugin_item = g_list_last(plugins);
-       plugin_item != NULL;
-       plugin_item = g_list_previous(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
-    (void) vlock_plugin_call_hook(p, hook_name);
+  for (size_t i = nr_plugins; i > 0; i--) {
+    VlockPlugin *p = plugins[i - 1];
+
+    if (!p->stopped)
+      (void) vlock_plugin_call_hook(p, hook_name);
   }
+
+  g_free(finish_async_hooks(hook_name, ASYNC_WAIT));
 }
 
 /* Call the "vlock_save" hook of each plugin.  Never fails.  If the hook of a
  * plugin fails its "vlock_save_abort" hook is called and both hooks are never
- * called again afterwards. */
+ * called again afterwards, unless the plugin was only busy (EAGAIN).
+ * Asynchronous hooks are cancelled when a key is pressed.  The hook of a
+ * plugin that is held back after short saves is not called and neither is its
+ * next "vlock_save_abort" hook. */
 void handle_vlock_save(const char *hook_name)
 {
-  for (GList *plugin_item = plugins;
-       plugin_item != NULL;
-       plugin_item = g_list_next(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
+  uint64_t now = monotonic_milliseconds();
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    VlockPlugin *p = plugins[i];
+
+    if (p->save_disabled || p->stopped)
+      continue;
 
-    if (p->save_disabled)
+    if (now < p->save_hold_end) {
+      p->save_skipped = true;
+      counters_add(VLOCK_COUNTER_SUPPRESSED_SAVES, 1);
       continue;
+    }
+
+    p->saving = true;
+    p->save_time = now;
 
     if (!vlock_plugin_call_hook(p, hook_name)) {
+      /* The plugin is busy, so this save is skipped like a held one. */
+      if (errno == EAGAIN) {
+        p->saving = false;
+        p->save_skipped = true;
+        counters_add(VLOCK_COUNTER_SUPPRESSED_SAVES, 1);
+        continue;
+      }
+
+      vlock_log_event(VLOCK_EVENT_PLUGIN_FAILURE, p->name, hook_name, errno);
       p->save_disabled = true;
+      p->saving = false;
       (void) vlock_plugin_call_hook(p, "vlock_save_abort");
     }
   }
+
+  bool *failed = finish_async_hooks(hook_name, ASYNC_WAIT_UNTIL_INPUT);
+
+  if (failed != NULL) {
+    for (size_t i = 0; i < nr_plugins; i++)
+      if (failed[i]) {
+        plugins[i]->save_disabled = true;
+        plugins[i]->saving = false;
+        (void) vlock_plugin_call_hook(plugins[i], "vlock_save_abort");
+      }
+
+    g_free(failed);
+  }
+
+  g_free(finish_async_hooks("vlock_save_abort", ASYNC_WAIT));
+}
+
+/* Mark the plugins whose asynchronous "vlock_save_abort" hooks failed. */
+static void disable_failed_saves(bool *failed)
+{
+  if (failed == NULL)
+    return;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    if (failed[i])
+      plugins[i]->save_disabled = true;
+
+  g_free(failed);
+}
+
+/* Hold back the next "vlock_save" hook of a plugin whose save is aborted
+ * now if the save was short.  Plugins with cheap saves are never held back. */
+static void end_save(VlockPlugin *p, uint64_t now)
+{
+  if (!p->saving)
+    return;
+
+  p->saving = false;
+
+  if ((p->capabilities & VLOCK_PLUGIN_CHEAP_SAVE) != 0
+      || now - p->save_time >= SAVE_DWELL_MS) {
+    p->save_hold = 0;
+    return;
+  }
+
+  if (p->save_hold == 0)
+    p->save_hold = SAVE_DWELL_MS;
+  else if (p->save_hold < SAVE_MAX_HOLD_MS / 2)
+    p->save_hold *= 2;
+  else
+    p->save_hold = SAVE_MAX_HOLD_MS;
+
+  p->save_hold_end = now + p->save_hold;
+}
+
+/* Call the "vlock_save_abort" hook of each plugin that does or does not use
+ * the display in reverse order.  Asynchronous hooks are not waited for. */
+static void abort_save(const char *hook_name, bool display)
+{
+  uint64_t now = monotonic_milliseconds();
+
+  for (size_t i = nr_plugins; i > 0; i--) {
+    VlockPlugin *p = plugins[i - 1];
+
+    if (p->save_disabled || p->stopped
+        || ((p->capabilities & VLOCK_PLUGIN_DISPLAY) != 0) != display)
+      continue;
+
+    /* Its save was held back, so there is nothing to abort. */
+    if (p->save_skipped) {
+      p->save_skipped = false;
+      continue;
+    }
+
+    end_save(p, now);
+
+    if (!vlock_plugin_call_hook(p, hook_name)) {
+      vlock_log_event(VLOCK_EVENT_PLUGIN_FAILURE, p->name, hook_name, errno);
+      /* A busy plugin is not given up. */
+      p->save_disabled = errno != EAGAIN;
+    }
+  }
 }
 
-/* Call the "vlock_save" hook of each plugin.  Never fails.  If the hook of a
- * plugin fails both hooks "vlock_save" and "vlock_save_abort" are never called
- * again afterwards. */
+/* Call the "vlock_save_abort" hook of each plugin.  Never fails.  If the hook
+ * of a plugin fails both hooks "vlock_save" and "vlock_save_abort" are never
+ * called again afterwards.  Plugins that use the display are called first. */
 void handle_vlock_save_abort(const char *hook_name)
 {
-  for (GList *plugin_item = g_list_last(plugins);
-       plugin_item != NULL;
-       plugin_item = g_list_previous(plugin_item)) {
-    VlockPlugin *p = plugin_item->data;
+  abort_save(hook_name, true);
+  abort_save(hook_name, false);
+  disable_failed_saves(finish_async_hooks(hook_name, ASYNC_WAIT));
+}
+
+int plugin_get_output_fds(fd_set *fds)
+{
+  int nfds = 0;
+  int fd;
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    if (vlock_plugin_get_pending_output(plugins[i], &fd) && fd < FD_SETSIZE) {
+      FD_SET(fd, fds);
+
+      if (fd >= nfds)
+        nfds = fd + 1;
+    }
+
+  return nfds;
+}
+
+void plugin_flush_output(const fd_set *fds)
+{
+  int fd;
 
-    if (p->save_disabled)
+  for (size_t i = 0; i < nr_plugins; i++)
+    if (vlock_plugin_get_pending_output(plugins[i], &fd) && fd < FD_SETSIZE
+        && FD_ISSET(fd, fds))
+      vlock_plugin_flush_output(plugins[i]);
+}
+
+unsigned int plugin_save_hold_off(void)
+{
+  uint64_t now = monotonic_milliseconds();
+  uint64_t hold_end = 0;
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    VlockPlugin *p = plugins[i];
+
+    if (p->save_disabled || p->stopped)
       continue;
 
-    if (!vlock_plugin_call_hook(p, hook_name))
-      p->save_disabled = true;
+    if (p->save_hold_end <= now)
+      return 0;
+
+    if (hold_end == 0 || p->save_hold_end < hold_end)
+      hold_end = p->save_hold_end;
   }
+
+  return hold_end > now ? hold_end - now : 0;
 }
 
+void plugin_wake_display(void)
+{
+  collect_background_hooks();
+
+  abort_save("vlock_save_abort", true);
+  disable_failed_saves(finish_async_hooks("vlock_save_abort", ASYNC_WAIT));
+
+  waking = true;
+}
+
+void plugin_wake_finish(void)
+{
+  if (!waking)
+    return;
+
+  waking = false;
+  abort_save("vlock_save_abort", false);
+  background_hook = "vlock_save_abort";
+}
+
+static void collect_background_hooks(void)
+{
+  const char *hook_name = background_hook;
+
+  if (hook_name == NULL)
+    return;
+
+  background_hook = NULL;
+
+  bool *failed = finish_async_hooks(hook_name, ASYNC_WAIT);
+
+  if (failed != NULL && strcmp(hook_name, "vlock_start") == 0)
+    for (size_t i = 0; i < nr_plugins; i++)
+      if (failed[i])
+        plugins[i]->stopped = true;
+
+  disable_failed_saves(failed);
+}
@@ -13,7 +13,9 @@
 
 #pragma once
 
+#include <stdio.h>
 #include <stdbool.h>
+#include <sys/select.h>
 #include <glib.h>
 
 /* Load the named plugin. */
@@ -23,8 +25,56 @@ bool load_plugin(const char *name, GError **error);
  * called after all plugins were loaded.  */
 bool resolve_dependencies(GError **error);
 
+/* Free the dependencies of all plugins after they were resolved. */
+void release_plugin_dependencies(void);
+
 /* Unload all plugins. */
 void unload_plugins(void);
 
-/* Call the given plugin hook. */
+/* Check if the named plugin is loaded. */
+bool is_plugin_loaded(const char *name);
+
+/* Get the names of all loaded plugins in the order they are called, separated
+ * by spaces.  The result must be freed with g_free(). */
+char *get_plugin_names(void);
+
+/* Print the CPU time, peak memory and number of processes used by each plugin
+ * that runs processes. */
+void print_plugin_usage(FILE *file);
+
+/* Call the given plugin hook.  "vlock_start" is only called for the plugins
+ * that are critical for the lock, see plugin_start_best_effort(). */
 void plugin_hook(const char *hook_name);
+
+/* Call the "vlock_start" hooks of the plugins that are not critical for the
+ * lock.  This is done once the terminal is secured.  A plugin whose hook fails
+ * is not called again but the lock goes on.  Asynchronous hooks are not waited
+ * for but finished in the background and collected before the next hook is
+ * called. */
+void plugin_start_best_effort(void);
+
+/* Add the file descriptors of the plugins with queued hook calls to the set
+ * and return the highest of them plus one or 0 if there are none. */
+int plugin_get_output_fds(fd_set *fds);
+
+/* Pass on the queued hook calls of the plugins whose file descriptors are in
+ * the set, as far as this is possible without blocking.  Both functions are
+ * meant for prompt_set_output_watch(). */
+void plugin_flush_output(const fd_set *fds);
+
+/* Get the number of milliseconds until the "vlock_save" hook of a plugin may
+ * be called again or 0 if one may be called now.  Plugins are held back
+ * after saves that were aborted right after they started, see
+ * handle_vlock_save() in plugins.c. */
+unsigned int plugin_save_hold_off(void);
+
+/* Wake up from the screen saver after a key was pressed.  This calls the
+ * "vlock_save_abort" hooks of the plugins that use the display so that the
+ * prompt can be shown right afterwards.  plugin_wake_finish() must be called
+ * once the prompt is shown. */
+void plugin_wake_display(void);
+
+/* Call the "vlock_save_abort" hooks of the remaining plugins.  Their
+ * asynchronous hooks are not waited for but finished in the background and
+ * collected before the next hook is called. */
+void plugin_wake_finish(void);
@@ -11,9 +11,19 @@
  *
  */
 
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+/* for SCHED_IDLE */
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <dirent.h>
+#include <sched.h>
+#include <limits.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
 #include <sys/time.h>
@@ -22,6 +32,8 @@
 #include <errno.h>
 
 #include "process.h"
+#include "counters.h"
+#include "trace.h"
 
 GQuark vlock_process_error_quark(void)
 {
@@ -64,6 +76,7 @@ bool wait_for_death(pid_t pid, long sec, long usec)
 
   /* Wait until the child exits or the timer fires. */
   result = (waitpid(pid, &status, 0) == pid);
+  VLOCK_PROBE2(wait__for__death, pid, result);
 
   /* Possible race condition.  If an alarm was set before it may get ignored.
    * This is probably better than getting killed by our own alarm. */
@@ -110,6 +123,34 @@ void ensure_death(pid_t pid)
   (void) waitpid(pid, &status, 0);
 }
 
+void ensure_group_death(pid_t pid)
+{
+  int status;
+
+  switch (waitpid(pid, &status, WNOHANG)) {
+    case -1:
+      /* Not your child? */
+      return;
+    case 0:
+      (void) kill(-pid, SIGTERM);
+
+      /* SIGTERM handlers (if any) have 500ms to finish. */
+      if (!wait_for_death(pid, 0, 500000L)) {
+        (void) kill(-pid, SIGKILL);
+        (void) kill(-pid, SIGCONT);
+        (void) waitpid(pid, &status, 0);
+      }
+
+      break;
+    default:
+      break;
+  }
+
+  /* The process group outlives its leader as long as one of its members is
+   * alive, so its ID was not reused. */
+  (void) kill(-pid, SIGKILL);
+}
+
 /* Close all possibly open file descriptors except the ones specified in the
  * given set. */
 static void close_fds(fd_set *except_fds)
@@ -141,6 +182,59 @@ static int open_devnull(void)
   return devnull_fd;
 }
 
+/* Move the calling process into the given cgroup.  Failure is not fatal. */
+static void join_cgroup(const char *cgroup)
+{
+  char path[PATH_MAX];
+  int fd;
+
+  if (snprintf(path, sizeof path, "%s/cgroup.procs", cgroup)
+      >= (int) sizeof path)
+    return;
+
+  if ((fd = open(path, O_WRONLY)) < 0)
+    return;
+
+  /* "0" is the writing process. */
+  (void) write(fd, "0", 1);
+  (void) close(fd);
+}
+
+static void set_limit(int resource, rlim_t value)
+{
+  struct rlimit r;
+
+  if (value == 0 || getrlimit(resource, &r) < 0)
+    return;
+
+  /* Never raise a limit. */
+  if (r.rlim_max != RLIM_INFINITY && r.rlim_max < value)
+    value = r.rlim_max;
+
+  r.rlim_cur = r.rlim_max = value;
+  (void) setrlimit(resource, &r);
+}
+
+/* Let the calling process run only when nothing else wants the CPU. */
+static void set_background_priority(void)
+{
+  /* Lowering the priority is always allowed. */
+  (void) setpriority(PRIO_PROCESS, 0, 19);
+
+#ifdef SCHED_IDLE
+  {
+    struct sched_param param = { .sched_priority = 0 };
+    (void) sched_setscheduler(0, SCHED_IDLE, &param);
+  }
+#endif
+}
+
+static void set_limits(const struct child_limits *limits)
+{
+  set_limit(RLIMIT_CPU, limits->cpu_seconds);
+  set_limit(RLIMIT_AS, (rlim_t) limits->memory_kb * 1024);
+}
+
 bool create_child(struct child_process *child, GError **error)
 {
   int child_errno = 0;
@@ -186,6 +280,9 @@ bool create_child(struct child_process *child, GError **error)
 
   child->pid = fork();
 
+  if (child->pid > 0)
+    counters_add(VLOCK_COUNTER_SPAWNS, 1);
+
   if (child->pid == 0) {
     /* Child. */
     fd_set except_fds;
@@ -219,6 +316,19 @@ bool create_child(struct child_process *child, GError **error)
 
     (void) close_fds(&except_fds);
 
+    if (child->new_group)
+      (void) setpgid(0, 0);
+
+    /* Join the cgroup while still privileged. */
+    if (child->cgroup != NULL)
+      join_cgroup(child->cgroup);
+
+    if (child->limits != NULL)
+      set_limits(child->limits);
+
+    if (child->background)
+      set_background_priority();
+
     (void) setgid(getgid());
     (void) setuid(getuid());
 
@@ -242,11 +352,23 @@ bool create_child(struct child_process *child, GError **error)
     goto fork_failed;
   }
 
+  VLOCK_PROBE2(child__create, child->path, child->pid);
+
+  /* Also set the process group here so that it exists when this function
+   * returns, no matter which process runs first. */
+  if (child->new_group)
+    (void) setpgid(child->pid, child->pid);
+
   (void) close(status_pipe[1]);
 
   /* Get the error status from the child, if any. */
   if (read(status_pipe[0], &child_errno,
-           sizeof child_errno) == sizeof child_errno) {
+           sizeof child_errno) != sizeof child_errno)
+    child_errno = 0;
+
+  VLOCK_PROBE2(child__exec, child->pid, child_errno);
+
+  if (child_errno != 0) {
     g_set_error(error,
                 VLOCK_PROCESS_ERROR,
                 child_errno == ENOENT ?
@@ -308,3 +430,85 @@ stdin_pipe_failed:
   return false;
 }
 
+/* Read the given file from /proc/<pid> into the buffer. */
+static bool read_proc_file(pid_t pid, const char *name, char *buffer,
+                           size_t size)
+{
+  char path[64];
+  ssize_t length;
+  int fd;
+
+  (void) snprintf(path, sizeof path, "/proc/%d/%s", (int) pid, name);
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return false;
+
+  length = read(fd, buffer, size - 1);
+  (void) close(fd);
+
+  if (length <= 0)
+    return false;
+
+  buffer[length] = '\0';
+  return true;
+}
+
+/* Get the fields after the command name of /proc/<pid>/stat.  The command
+ * name may contain anything, so look for the last parenthesis. */
+static const char *get_stat_fields(pid_t pid, char *buffer, size_t size)
+{
+  const char *p;
+
+  if (!read_proc_file(pid, "stat", buffer, size)
+      || (p = strrchr(buffer, ')')) == NULL)
+    return NULL;
+
+  return p + 1;
+}
+
+bool get_child_usage(pid_t pid, struct child_usage *usage)
+{
+  char buffer[1024];
+  const char *fields = get_stat_fields(pid, buffer, sizeof buffer);
+  unsigned long long utime, stime, cutime, cstime;
+  long ticks = sysconf(_SC_CLK_TCK);
+  const char *hwm;
+  DIR *proc;
+
+  /* state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt
+   * cmajflt utime stime cutime cstime */
+  if (fields == NULL
+      || sscanf(fields, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                "%llu %llu %llu %llu", &utime, &stime, &cutime, &cstime) != 4)
+    return false;
+
+  if (ticks <= 0)
+    ticks = 100;
+
+  usage->cpu_usec = (utime + stime + cutime + cstime) * 1000000 / ticks;
+  usage->peak_rss_kb = 0;
+  usage->processes = 0;
+
+  if (read_proc_file(pid, "status", buffer, sizeof buffer)
+      && (hwm = strstr(buffer, "VmHWM:")) != NULL)
+    usage->peak_rss_kb = strtoull(hwm + strlen("VmHWM:"), NULL, 10);
+
+  /* Count the members of the process group. */
+  if ((proc = opendir("/proc")) != NULL) {
+    struct dirent *entry;
+
+    while ((entry = readdir(proc)) != NULL) {
+      pid_t member = strtol(entry->d_name, NULL, 10);
+      int pgrp;
+
+      if (member > 0
+          && (fields = get_stat_fields(member, buffer, sizeof buffer)) != NULL
+          && sscanf(fields, " %*c %*d %d", &pgrp) == 1 && pgrp == pid)
+        usage->processes++;
+    }
+
+    (void) closedir(proc);
+  }
+
+  return true;
+}
@@ -14,6 +14,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <glib.h>
 
@@ -34,10 +35,40 @@ bool wait_for_death(pid_t pid, long sec, long usec);
 /* Try hard to kill the given child process. */
 void ensure_death(pid_t pid);
 
+/* Same as ensure_death() for a child that was started in a process group of
+ * its own, but every signal goes to the whole group.  Descendants that are
+ * left after the child died are killed, too. */
+void ensure_group_death(pid_t pid);
+
 #define NO_REDIRECT (-2)
 #define REDIRECT_DEV_NULL (-3)
 #define REDIRECT_PIPE (-4)
 
+/* Limits of a child process.  0 means no limit. */
+struct child_limits
+{
+  /* CPU time in seconds. */
+  unsigned long cpu_seconds;
+  /* Size of the address space, or memory usage of the cgroup, in
+   * kilobytes. */
+  unsigned long memory_kb;
+  /* Number of processes.  Only enforced in a cgroup. */
+  unsigned long processes;
+  /* Share of one CPU in percent.  Only enforced in a cgroup. */
+  unsigned long cpu_percent;
+};
+
+/* Resources used by a child and its descendants. */
+struct child_usage
+{
+  /* User and system CPU time in microseconds. */
+  uint64_t cpu_usec;
+  /* Peak resident set size in kilobytes. */
+  uint64_t peak_rss_kb;
+  /* Number of processes. */
+  unsigned int processes;
+};
+
 struct child_process
 {
   /* Function that will be run in the child. */
@@ -54,16 +85,34 @@ struct child_process
   int stdout_fd;
   /* The child's stderr. */
   int stderr_fd;
+  /* Start the child in a new process group of its own. */
+  bool new_group;
+  /* Directory of a cgroup the child is moved into or NULL. */
+  const char *cgroup;
+  /* Limits of the child or NULL. */
+  const struct child_limits *limits;
+  /* Run the child only when the CPU is otherwise idle, e.g. a screen saver.
+   * It gets the SCHED_IDLE policy where available and the lowest priority
+   * otherwise, so it never delays the password prompt. */
+  bool background;
   /* The child's PID. */
   pid_t pid;
 };
 
 /* Create a new child process.  All file descriptors except stdin, stdout and
  * stderr are closed and privileges are dropped.  All fields of the child
- * struct except pid must be set.  If a stdio file descriptor field has the
+ * struct except pid must be set, new_group, cgroup, limits and background may
+ * be left zero.  If a stdio file descriptor field has the
  * special value of REDIRECT_DEV_NULL it is redirected from or to /dev/null.
  * If it has the value REDIRECT_PIPE a pipe will be created and one end will be
  * connected to the respective descriptor of the child.  The file descriptor of
  * the other end is stored in the field after the call.  It is up to the caller
  * to close the pipe descriptor(s). */
 bool create_child(struct child_process *child, GError **error);
+
+/* Get the resources used by a running child that was started in a process
+ * group of its own.  The CPU time includes descendants the child waited for,
+ * the peak resident set size is that of the child alone and the number of
+ * processes is the current size of its process group.  Returns false if the
+ * child is not running. */
+bool get_child_usage(pid_t pid, struct child_usage *usage);
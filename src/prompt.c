@@ -41,10 +41,12 @@
  *
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/select.h>
 #include <errno.h>
@@ -52,6 +54,9 @@
 #include <glib.h>
 
 #include "prompt.h"
+#include "output.h"
+#include "counters.h"
+#include "trace.h"
 
 #define PROMPT_BUFFER_SIZE 512
 
@@ -60,6 +65,17 @@ GQuark vlock_prompt_error_quark(void)
   return g_quark_from_static_string("vlock-prompt-error-quark");
 }
 
+/* See prompt_set_output_watch(). */
+static int (*output_watch_add_fds)(fd_set *fds);
+static void (*output_watch_flush)(const fd_set *fds);
+
+void prompt_set_output_watch(int (*add_fds)(fd_set *fds),
+                             void (*flush)(const fd_set *fds))
+{
+  output_watch_add_fds = add_fds;
+  output_watch_flush = flush;
+}
+
 /* Prompt with the given string for a single line of input.  The read string is
  * returned in a new buffer that should be freed by the caller.  If reading
  * fails or the timeout (if given) occurs NULL is retured. */
@@ -72,11 +88,9 @@ char *prompt(const char *msg, const struct timespec *timeout, GError **error)
   struct termios term;
   tcflag_t lflag;
 
-  if (msg != NULL) {
-    /* Write out the prompt. */
-    (void) fputs(msg, stderr);
-    fflush(stderr);
-  }
+  /* The prompt is written when the first character is read. */
+  if (msg != NULL)
+    output_add(msg);
 
   /* Get the current terminal attributes. */
   (void) tcgetattr(STDIN_FILENO, &term);
@@ -86,8 +100,12 @@ char *prompt(const char *msg, const struct timespec *timeout, GError **error)
   term.c_lflag &= ~ISIG;
   /* Set the terminal attributes. */
   (void) tcsetattr(STDIN_FILENO, TCSAFLUSH, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
   /* Discard all unread input characters. */
   (void) tcflush(STDIN_FILENO, TCIFLUSH);
+  counters_add(VLOCK_COUNTER_TERMIOS, 3);
+
+  VLOCK_PROBE(prompt__start);
 
   /* Read the string one character at a time. */
   for (len = 0; len < sizeof buffer - 1; len++) {
@@ -105,6 +123,7 @@ char *prompt(const char *msg, const struct timespec *timeout, GError **error)
 
   /* Terminate the string. */
   buffer[len] = '\0';
+  VLOCK_PROBE1(prompt__submit, len);
 
   /* Copy the string. */
   if ((result = strdup(buffer)) == NULL)
@@ -121,6 +140,8 @@ out:
   /* Restore original terminal attributes. */
   term.c_lflag = lflag;
   (void) tcsetattr(STDIN_FILENO, TCSAFLUSH, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
+  counters_add(VLOCK_COUNTER_TERMIOS, 1);
 
   return result;
 }
@@ -138,51 +159,116 @@ char *prompt_echo_off(const char *msg,
   lflag = term.c_lflag;
   term.c_lflag &= ~ECHO;
   (void) tcsetattr(STDIN_FILENO, TCSAFLUSH, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
 
   result = prompt(msg, timeout, error);
 
   term.c_lflag = lflag;
   (void) tcsetattr(STDIN_FILENO, TCSAFLUSH, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
+  counters_add(VLOCK_COUNTER_TERMIOS, 3);
 
   if (result != NULL)
-    fputc('\n', stderr);
+    output_add("\n");
 
   return result;
 }
 
 /* Read a single character from the stdin.  If the timeout is reached
- * 0 is returned. */
+ * 0 is returned.  The timeout covers the whole call: waking up to flush
+ * plugin output or for a signal does not restart it. */
 char read_character(const struct timespec *timeout, GError **error)
 {
   char c = 0;
+  struct timespec deadline;
+  struct timeval timeout_buffer;
   struct timeval *timeout_val = NULL;
   fd_set readfds;
+  fd_set writefds;
+  int nfds;
+  int nr_output_fds;
+  bool expired = false;
 
   g_assert(error == NULL || *error == NULL);
 
+  /* Show everything before waiting. */
+  (void) output_flush();
+
+  if (timeout != NULL) {
+    (void) clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout->tv_sec;
+    deadline.tv_nsec += timeout->tv_nsec;
+
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+  }
+
 before_select:
+  /* This is called for every key press so do not allocate here.  Only the
+   * time left until the deadline is handed to select(). */
   if (timeout != NULL) {
-    timeout_val = calloc(sizeof *timeout_val, 1);
+    struct timespec now;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    timeout_buffer.tv_sec = deadline.tv_sec - now.tv_sec;
+    timeout_buffer.tv_usec = (deadline.tv_nsec - now.tv_nsec) / 1000;
 
-    if (timeout_val != NULL) {
-      timeout_val->tv_sec = timeout->tv_sec;
-      timeout_val->tv_usec = timeout->tv_nsec / 1000;
+    if (timeout_buffer.tv_usec < 0) {
+      timeout_buffer.tv_sec--;
+      timeout_buffer.tv_usec += 1000000;
     }
+
+    if (timeout_buffer.tv_sec < 0) {
+      timeout_buffer.tv_sec = timeout_buffer.tv_usec = 0;
+      expired = true;
+    }
+
+    timeout_val = &timeout_buffer;
   }
 
-  /* Initialize file descriptor set. */
+  /* Initialize file descriptor sets. */
   FD_ZERO(&readfds);
   FD_SET(STDIN_FILENO, &readfds);
+  FD_ZERO(&writefds);
+
+  nfds = STDIN_FILENO + 1;
+  nr_output_fds = 0;
+
+  if (output_watch_add_fds != NULL)
+    nr_output_fds = output_watch_add_fds(&writefds);
+
+  if (nr_output_fds > nfds)
+    nfds = nr_output_fds;
 
   /* Reset errno. */
   errno = 0;
 
   /* Wait for a character. */
-  if (select(STDIN_FILENO + 1, &readfds, NULL, NULL, timeout_val) != 1) {
+  int ready = select(nfds, &readfds, nr_output_fds > 0 ? &writefds : NULL,
+                     NULL, timeout_val);
+
+  counters_add(VLOCK_COUNTER_WAKEUPS, 1);
+
+  if (ready > 0 && nr_output_fds > 0) {
+    output_watch_flush(&writefds);
+
+    /* Go on waiting if no character is available.  A writable fd wakes
+     * select() even when no time is left, so check the deadline here. */
+    if (!FD_ISSET(STDIN_FILENO, &readfds)) {
+      if (!expired)
+	goto before_select;
+
+      ready = 0;
+      errno = 0;
+    }
+  }
+
+  if (ready <= 0) {
     switch (errno) {
       case EINTR:
 	/* A signal was caught.  Restart. */
-	free(timeout_val);
 	goto before_select;
       case 0:
 	/* Timeout was hit. */
@@ -207,7 +293,6 @@ before_select:
   (void) read(STDIN_FILENO, &c, 1);
 
 out:
-  free(timeout_val);
   return c;
 }
 
@@ -225,6 +310,8 @@ char wait_for_character(const char *charset, const struct timespec *timeout, GEr
   lflag = term.c_lflag;
   term.c_lflag &= ~ICANON;
   (void) tcsetattr(STDIN_FILENO, TCSANOW, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
+  counters_add(VLOCK_COUNTER_TERMIOS, 2);
 
   for (;;) {
     c = read_character(timeout, error);
@@ -238,6 +325,8 @@ char wait_for_character(const char *charset, const struct timespec *timeout, GEr
   /* restore line buffering */
   term.c_lflag = lflag;
   (void) tcsetattr(STDIN_FILENO, TCSANOW, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
+  counters_add(VLOCK_COUNTER_TERMIOS, 1);
 
   return c;
 }
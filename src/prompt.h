@@ -41,6 +41,7 @@
  *
  */
 
+#include <sys/select.h>
 #include <glib.h>
 
 #define VLOCK_PROMPT_ERROR vlock_prompt_error_quark()
@@ -63,6 +64,14 @@ char *prompt_echo_off(const char *msg,
                       const struct timespec *timeout,
                       GError **error);
 
+/* While read_character() waits for input it also waits for the file
+ * descriptors add_fds adds to the given set to become writable and then calls
+ * flush with the set of the writable ones.  add_fds returns the highest file
+ * descriptor it added plus one or 0 if it added none.  vlock-main uses this to
+ * pass on the hook calls that were queued for busy plugins. */
+void prompt_set_output_watch(int (*add_fds)(fd_set *fds),
+                             void (*flush)(const fd_set *fds));
+
 /* Read a single character from the stdin.  If the timeout is reached
  * 0 is returned. */
 char read_character(const struct timespec *timeout, GError **error);
@@ -0,0 +1,399 @@
+/* rcfile.c -- configuration file parser for vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* The files parsed here used to be sourced by a shell.  Only the subset of
+ * the shell syntax that is needed to assign variables is understood.  This
+ * file deliberately does not depend on GLib because it is also used by the
+ * vlock launcher, which should start as fast as possible. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "rcfile.h"
+
+/* A growing string buffer. */
+struct buffer
+{
+  char *data;
+  size_t length;
+  size_t size;
+};
+
+static bool buffer_append(struct buffer *b, const char *s, size_t length)
+{
+  if (b->length + length + 1 > b->size) {
+    size_t size = b->size ? b->size : 64;
+    char *data;
+
+    while (b->length + length + 1 > size)
+      size *= 2;
+
+    if ((data = realloc(b->data, size)) == NULL)
+      return false;
+
+    b->data = data;
+    b->size = size;
+  }
+
+  memcpy(b->data + b->length, s, length);
+  b->length += length;
+  b->data[b->length] = '\0';
+
+  return true;
+}
+
+/* State of the parser. */
+struct parser
+{
+  const char *filename;
+  const char *p;
+  unsigned int line;
+  rcfile_lookup_function lookup;
+  rcfile_assign_function assign;
+  void *data;
+};
+
+static bool parse_error(struct parser *parser, const char *message)
+{
+  fprintf(stderr, "vlock: %s:%u: %s\n", parser->filename, parser->line,
+          message);
+  errno = 0;
+  return false;
+}
+
+static bool is_name_start(char c)
+{
+  return isalpha((unsigned char) c) || c == '_';
+}
+
+static bool is_name_char(char c)
+{
+  return isalnum((unsigned char) c) || c == '_';
+}
+
+static bool is_blank(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+/* Characters that end an unquoted word. */
+static bool is_word_end(char c)
+{
+  return c == '\0' || c == '\n' || is_blank(c);
+}
+
+/* Characters that would need a real shell. */
+static bool is_special(char c)
+{
+  return strchr(";&|<>()`", c) != NULL;
+}
+
+/* Parse a variable reference after the dollar sign and append its value. */
+static bool parse_expansion(struct parser *parser, struct buffer *value)
+{
+  const char *start;
+  size_t length;
+  bool braced = false;
+  char name[256];
+  const char *v;
+
+  if (parser->lookup == NULL || !(is_name_start(*parser->p)
+                                  || *parser->p == '{')) {
+    if (*parser->p == '(')
+      return parse_error(parser, "command substitution is not supported");
+
+    /* A lone dollar sign. */
+    return buffer_append(value, "$", 1);
+  }
+
+  if (*parser->p == '{') {
+    braced = true;
+    parser->p++;
+
+    if (!is_name_start(*parser->p))
+      return parse_error(parser, "bad substitution");
+  }
+
+  start = parser->p;
+
+  while (is_name_char(*parser->p))
+    parser->p++;
+
+  length = parser->p - start;
+
+  if (braced) {
+    if (*parser->p != '}')
+      return parse_error(parser, "unsupported parameter expansion");
+
+    parser->p++;
+  }
+
+  if (length >= sizeof name)
+    return parse_error(parser, "variable name too long");
+
+  memcpy(name, start, length);
+  name[length] = '\0';
+
+  v = parser->lookup(name, parser->data);
+
+  return v == NULL || buffer_append(value, v, strlen(v));
+}
+
+/* Parse a single quoted string after the opening quote. */
+static bool parse_single_quoted(struct parser *parser, struct buffer *value)
+{
+  const char *start = parser->p;
+
+  while (*parser->p != '\'') {
+    if (*parser->p == '\0')
+      return parse_error(parser, "unterminated single quote");
+    else if (*parser->p == '\n')
+      parser->line++;
+
+    parser->p++;
+  }
+
+  if (!buffer_append(value, start, parser->p - start))
+    return false;
+
+  parser->p++;
+  return true;
+}
+
+/* Parse a double quoted string after the opening quote. */
+static bool parse_double_quoted(struct parser *parser, struct buffer *value)
+{
+  for (;;) {
+    char c = *parser->p++;
+
+    switch (c) {
+      case '\0':
+        parser->p--;
+        return parse_error(parser, "unterminated double quote");
+      case '"':
+        return true;
+      case '`':
+        return parse_error(parser, "command substitution is not supported");
+      case '$':
+        if (!parse_expansion(parser, value))
+          return false;
+        break;
+      case '\\':
+        /* Inside double quotes the backslash only escapes these. */
+        if (*parser->p == '\n') {
+          parser->line++;
+          parser->p++;
+          break;
+        } else if (*parser->p != '\0' && strchr("$`\"\\", *parser->p) != NULL)
+          c = *parser->p++;
+
+        if (!buffer_append(value, &c, 1))
+          return false;
+        break;
+      case '\n':
+        parser->line++;
+        /* fall through */
+      default:
+        if (!buffer_append(value, &c, 1))
+          return false;
+        break;
+    }
+  }
+}
+
+/* Parse a word, i.e. the value of an assignment. */
+static bool parse_word(struct parser *parser, struct buffer *value)
+{
+  while (!is_word_end(*parser->p)) {
+    char c = *parser->p++;
+
+    if (c == '\'') {
+      if (!parse_single_quoted(parser, value))
+        return false;
+    } else if (c == '"') {
+      if (!parse_double_quoted(parser, value))
+        return false;
+    } else if (c == '$') {
+      if (!parse_expansion(parser, value))
+        return false;
+    } else if (c == '\\') {
+      if (*parser->p == '\n') {
+        /* Line continuation. */
+        parser->line++;
+        parser->p++;
+      } else if (*parser->p != '\0') {
+        if (!buffer_append(value, parser->p++, 1))
+          return false;
+      }
+    } else if (is_special(c)) {
+      parser->p--;
+      return parse_error(parser, "unsupported shell syntax");
+    } else if (!buffer_append(value, &c, 1)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Skip blanks and an optional trailing comment and consume the end of the
+ * line. */
+static bool parse_line_end(struct parser *parser)
+{
+  while (is_blank(*parser->p))
+    parser->p++;
+
+  if (*parser->p == '#')
+    while (*parser->p != '\n' && *parser->p != '\0')
+      parser->p++;
+
+  if (*parser->p == '\n') {
+    parser->line++;
+    parser->p++;
+  } else if (*parser->p != '\0') {
+    return parse_error(parser, "unsupported shell syntax");
+  }
+
+  return true;
+}
+
+/* Parse a single statement.  The name is copied into the given buffer. */
+static bool parse_statement(struct parser *parser, struct buffer *name,
+                            struct buffer *value)
+{
+  bool exported = false;
+  const char *start;
+
+  if (strncmp(parser->p, "export", 6) == 0 && is_blank(parser->p[6])) {
+    exported = true;
+    parser->p += 6;
+
+    while (is_blank(*parser->p))
+      parser->p++;
+  }
+
+  do {
+    if (!is_name_start(*parser->p))
+      return parse_error(parser, "variable assignment expected");
+
+    start = parser->p;
+
+    while (is_name_char(*parser->p))
+      parser->p++;
+
+    name->length = 0;
+
+    if (!buffer_append(name, start, parser->p - start))
+      return false;
+
+    if (*parser->p == '=') {
+      parser->p++;
+      value->length = 0;
+
+      if (!buffer_append(value, "", 0) || !parse_word(parser, value))
+        return false;
+
+      if (!parser->assign(name->data, value->data, exported, parser->data))
+        return parse_error(parser, "assignment not allowed");
+    } else if (exported && (is_word_end(*parser->p) || *parser->p == '#')) {
+      if (!parser->assign(name->data, NULL, true, parser->data))
+        return parse_error(parser, "assignment not allowed");
+    } else {
+      return parse_error(parser, "variable assignment expected");
+    }
+
+    while (is_blank(*parser->p))
+      parser->p++;
+
+    /* There may be more than one assignment on a line. */
+  } while (*parser->p != '\n' && *parser->p != '\0' && *parser->p != '#');
+
+  return true;
+}
+
+bool parse_rcfile(FILE *file,
+                  const char *filename,
+                  rcfile_lookup_function lookup,
+                  rcfile_assign_function assign,
+                  void *data)
+{
+  struct buffer contents = { NULL, 0, 0 };
+  struct buffer name = { NULL, 0, 0 };
+  struct buffer value = { NULL, 0, 0 };
+  struct parser parser = {
+    .filename = filename,
+    .line = 1,
+    .lookup = lookup,
+    .assign = assign,
+    .data = data,
+  };
+  bool result = true;
+
+  /* Read the whole file. */
+  for (;;) {
+    char chunk[4096];
+    size_t length = fread(chunk, 1, sizeof chunk, file);
+
+    if (length > 0 && !buffer_append(&contents, chunk, length)) {
+      perror("vlock: could not read configuration");
+      result = false;
+      goto out;
+    }
+
+    if (length < sizeof chunk)
+      break;
+  }
+
+  if (ferror(file)) {
+    fprintf(stderr, "vlock: could not read '%s'\n", filename);
+    errno = 0;
+    result = false;
+    goto out;
+  }
+
+  if (contents.data == NULL)
+    /* Empty file. */
+    goto out;
+
+  if (memchr(contents.data, '\0', contents.length) != NULL) {
+    result = parse_error(&parser, "file contains a null byte");
+    goto out;
+  }
+
+  parser.p = contents.data;
+
+  while (*parser.p != '\0') {
+    while (is_blank(*parser.p))
+      parser.p++;
+
+    if (*parser.p != '#' && *parser.p != '\n' && *parser.p != '\0')
+      if (!parse_statement(&parser, &name, &value)) {
+        result = false;
+        break;
+      }
+
+    if (!parse_line_end(&parser)) {
+      result = false;
+      break;
+    }
+  }
+
+out:
+  free(contents.data);
+  free(name.data);
+  free(value.data);
+
+  return result;
+}
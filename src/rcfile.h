@@ -0,0 +1,45 @@
+/* rcfile.h -- header file for the configuration file parser for vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Look up the value of the named variable.  Should return NULL if the variable
+ * is not set. */
+typedef const char *(*rcfile_lookup_function)(const char *name, void *data);
+
+/* Assign the value to the named variable.  If the assignment was prefixed with
+ * "export" exported is true.  For a plain "export NAME" value is NULL.  Should
+ * return false if the assignment is not allowed. */
+typedef bool (*rcfile_assign_function)(const char *name,
+                                       const char *value,
+                                       bool exported,
+                                       void *data);
+
+/* Parse the given file.  The file must consist of variable assignments in
+ * restricted Bourne shell syntax, i.e. "NAME=VALUE" or "export NAME=VALUE",
+ * one per line, comments and empty lines.  Values may be quoted with single or
+ * double quotes and may reference previously assigned variables as $NAME or
+ * ${NAME}, which are resolved through the lookup function.  If lookup is NULL
+ * a dollar sign is taken literally.  Command substitution and everything else
+ * that would require a shell is rejected.
+ *
+ * On error a message prefixed with the file name and line number is printed
+ * and false is returned. */
+bool parse_rcfile(FILE *file,
+                  const char *filename,
+                  rcfile_lookup_function lookup,
+                  rcfile_assign_function assign,
+                  void *data);
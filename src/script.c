@@ -13,17 +13,32 @@
 /* Scripts are executables that are run as unprivileged child processes of
  * vlock.  They communicate with vlock through stdin and stdout.
  *
- * When dependencies are retrieved they are launched once for each dependency
- * and should print the names of the plugins they depend on on stdout one per
- * line.  The dependency requested is given as a single command line argument.
+ * When dependencies are retrieved they are launched once for each dependency,
+ * all at the same time, and should print the names of the plugins they depend
+ * on on stdout one per line.  The dependency requested is given as a single
+ * command line argument.
  *
  * In hook mode the script is called once with "hooks" as a single command line
  * argument.  It should not exit until its stdin closes.  The hook that should
- * be executed is written to its stdin on a single line.
+ * be executed is written to its stdin on a single line.  vlock never blocks on
+ * a script that is busy and does not read its stdin, e.g. while its vlock_save
+ * hook suspends the machine.  The hooks are queued and written while vlock
+ * waits for keys once the script reads again.  A vlock_save that is followed
+ * by a vlock_save_abort while both are still queued is never written.  If
+ * the queue is full the hook fails with EAGAIN but the script is not given
+ * up.
  *
  * Currently there is no way for a script to communicate errors or even success
  * to vlock.  If it exits it will linger as a zombie until the plugin is
  * destroyed.
+ *
+ * In hook mode the script runs in its own process group and, if VLOCK_CGROUP
+ * or the directory given to configure with --cgroupdir names a delegated
+ * cgroup v2 directory, in its own cgroup below it.  Every process it left
+ * behind is killed when the plugin is destroyed.  The limits from
+ * VLOCK_PLUGIN_CPU_LIMIT, VLOCK_PLUGIN_MEMORY_LIMIT, VLOCK_PLUGIN_PROCESS_LIMIT
+ * and VLOCK_PLUGIN_CPU_QUOTA apply to each script.
+ * Scripts run at normal priority because they handle every hook.
  */
 
 #if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
@@ -35,7 +50,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
@@ -46,51 +61,58 @@
 #include <glib-object.h>
 
 #include "process.h"
+#include "cgroup.h"
+#include "counters.h"
 #include "util.h"
 
 #include "plugin.h"
 #include "script.h"
 
-static char *read_dependency(const char *path,
-                             const char *dependency_name,
-                             GError **error);
-static void parse_dependency(char *data, GList **dependency_list);
+static void parse_dependency(char *data, VlockPlugin *plugin,
+                             size_t dependency);
 
-/* Get the dependency from the script. */
-static bool get_dependency(const char *path, const char *dependency_name,
-                           GList **dependency_list, GError **error)
+/* A script that was started to print one of its dependencies. */
+struct probe
 {
-  GError *tmp_error = NULL;
+  pid_t pid;
+  /* Read end of the script's stdout or -1 after end-of-file. */
+  int fd;
+  char *data;
+  size_t data_length;
+};
 
-  /* Read the dependency data. */
-  char *data = read_dependency(path, dependency_name, &tmp_error);
+/* Milliseconds until the given time, at least 0. */
+static int remaining_ms(const struct timespec *deadline)
+{
+  struct timespec now;
+  long ms;
 
-  if (data == NULL) {
-    if (tmp_error != NULL) {
-      g_propagate_error(error, tmp_error);
-      return false;
-    } else
-      /* No data. */
-      return true;
-  }
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+  ms = (deadline->tv_sec - now.tv_sec) * 1000
+       + (deadline->tv_nsec - now.tv_nsec) / 1000000;
 
-  /* Parse the dependency data into the list. */
-  parse_dependency(data, dependency_list);
+  return ms > 0 ? ms : 0;
+}
 
-  g_free(data);
+static void set_deadline(struct timespec *deadline, long ms)
+{
+  (void) clock_gettime(CLOCK_MONOTONIC, deadline);
+  deadline->tv_sec += ms / 1000;
+  deadline->tv_nsec += (ms % 1000) * 1000000;
 
-  return true;
+  if (deadline->tv_nsec >= 1000000000) {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000;
+  }
 }
 
-/* Read the dependency data by starting the script with the name of the
- * dependency as a single command line argument.  The script should then print
- * the dependencies to its stdout one on per line. */
-static char *read_dependency(const char *path,
-                             const char *dependency_name,
-                             GError **error)
+/* Start the script with the name of the dependency as a single command line
+ * argument.  The script should then print the dependencies to its stdout one
+ * per line. */
+static bool start_probe(const char *path, size_t dependency,
+                        struct probe *probe, GError **error)
 {
-  GError *tmp_error = NULL;
-  const char *argv[] = { path, dependency_name, NULL };
+  const char *argv[] = { path, dependency_names[dependency], NULL };
   struct child_process child = {
     .path = path,
     .argv = argv,
@@ -99,123 +121,172 @@ static char *read_dependency(const char *path,
     .stderr_fd = REDIRECT_DEV_NULL,
     .function = NULL,
   };
-  /* Timeout is one second. */
-  struct timeval timeout = {1, 0};
-  char *data = g_malloc(sizeof *data);
-  size_t data_length = 0;
 
-  if (!create_child(&child, &tmp_error)) {
-    g_assert(tmp_error != NULL);
-    g_propagate_error(error, tmp_error);
-    return NULL;
+  if (!create_child(&child, error))
+    return false;
+
+  probe->pid = child.pid;
+  probe->fd = child.stdout_fd;
+  probe->data = NULL;
+  probe->data_length = 0;
+
+  return true;
+}
+
+/* Read what the script printed so far.  Fails if more than LINE_MAX bytes
+ * are read. */
+static bool read_probe(const char *path, size_t dependency,
+                       struct probe *probe, GError **error)
+{
+  char buffer[LINE_MAX];
+  ssize_t length = read(probe->fd, buffer, sizeof buffer - 1);
+
+  /* Did the script close its stdout or exit? */
+  if (length <= 0) {
+    (void) close(probe->fd);
+    probe->fd = -1;
+    return true;
   }
 
-  /* Read the dependency from the child.  Reading fails if either the timeout
-   * elapses or more that LINE_MAX bytes are read. */
+  if (probe->data_length + length + 1 > LINE_MAX) {
+    g_set_error(
+      error,
+      VLOCK_PLUGIN_ERROR,
+      VLOCK_PLUGIN_ERROR_FAILED,
+      "reading dependency (%s) data from script %s failed: too much data",
+      dependency_names[dependency],
+      /* XXX: plugin->name */ path
+      );
+    return false;
+  }
+
+  /* Grow the data string.  Leave room for the terminating null byte. */
+  probe->data = g_realloc(probe->data, probe->data_length + length + 1);
+
+  /* Append the buffer to the data string. */
+  memcpy(probe->data + probe->data_length, buffer, length);
+  probe->data_length += length;
+  probe->data[probe->data_length] = '\0';
+
+  return true;
+}
+
+/* Get all dependencies from the script.  The script is started once for each
+ * dependency and all of them run at the same time, so a script that is slow to
+ * start delays vlock only once.  Together they have one second to print their
+ * dependencies and half a second more to exit. */
+static bool get_dependencies(const char *path, VlockPlugin *plugin,
+                             GError **error)
+{
+  GError *tmp_error = NULL;
+  struct probe probes[nr_dependencies];
+  struct pollfd fds[nr_dependencies];
+  size_t nr_started = 0;
+  struct timespec deadline;
+
+  for (; nr_started < nr_dependencies; nr_started++)
+    if (!start_probe(path, nr_started, &probes[nr_started], &tmp_error))
+      goto error;
+
+  set_deadline(&deadline, 1000);
+
   for (;;) {
-    struct timeval t = timeout;
-    struct timeval t1;
-    struct timeval t2;
-    char buffer[LINE_MAX];
-    ssize_t length;
+    nfds_t nfds = 0;
+    size_t indices[nr_dependencies];
+    int ready;
+
+    for (size_t i = 0; i < nr_dependencies; i++)
+      if (probes[i].fd >= 0) {
+        fds[nfds] = (struct pollfd) { .fd = probes[i].fd, .events = POLLIN };
+        indices[nfds++] = i;
+      }
+
+    if (nfds == 0)
+      break;
 
-    fd_set read_fds;
+    ready = poll(fds, nfds, remaining_ms(&deadline));
 
-    FD_ZERO(&read_fds);
-    FD_SET(child.stdout_fd, &read_fds);
+    counters_add(VLOCK_COUNTER_WAKEUPS, 1);
 
-    /* t1 is before select. */
-    (void) gettimeofday(&t1, NULL);
+    if (ready < 0 && errno == EINTR)
+      continue;
 
-    if (select(child.stdout_fd+1, &read_fds, NULL, NULL, &t) != 1) {
-timeout:
+    if (ready <= 0) {
       g_set_error(&tmp_error,
                   VLOCK_PLUGIN_ERROR,
                   VLOCK_PLUGIN_ERROR_FAILED,
                   "reading dependency (%s) data from script %s failed: timeout",
-                  dependency_name,
+                  dependency_names[indices[0]],
                   /* XXX: plugin->name */ path
                   );
       goto error;
     }
 
-    /* t2 is after select. */
-    (void) gettimeofday(&t2, NULL);
+    for (nfds_t j = 0; j < nfds; j++)
+      if (fds[j].revents != 0
+          && !read_probe(path, indices[j], &probes[indices[j]], &tmp_error))
+        goto error;
+  }
 
-    /* Get the time that during select. */
-    timersub(&t2, &t1, &t2);
+  /* Parse the dependency data into the plugin's dependencies in order. */
+  for (size_t i = 0; i < nr_dependencies; i++)
+    if (probes[i].data != NULL)
+      parse_dependency(probes[i].data, plugin, i);
 
-    /* This is very unlikely. */
-    if (timercmp(&t2, &timeout, >))
-      goto timeout;
+error:
+  set_deadline(&deadline, 500);
 
-    /* Reduce the timeout. */
-    timersub(&timeout, &t2, &timeout);
+  for (size_t i = 0; i < nr_started; i++) {
+    int ms;
 
-    /* Read dependency data from the script. */
-    length = read(child.stdout_fd, buffer, sizeof buffer - 1);
+    /* Close the read end of the pipe. */
+    if (probes[i].fd >= 0)
+      (void) close(probes[i].fd);
 
-    /* Did the script close its stdin or exit? */
-    if (length <= 0)
-      break;
+    g_free(probes[i].data);
 
-    if (data_length+length+1 > LINE_MAX) {
-      g_set_error(
-        &tmp_error,
-        VLOCK_PLUGIN_ERROR,
-        VLOCK_PLUGIN_ERROR_FAILED,
-        "reading dependency (%s) data from script %s failed: too much data",
-        dependency_name,
-        /* XXX: plugin->name */ path
-        );
-      goto error;
-    }
+    /* Kill the script. */
+    ms = remaining_ms(&deadline);
 
-    /* Grow the data string. */
-    data = g_realloc(data, data_length+length);
-
-    /* Append the buffer to the data string. */
-    strncpy(data+data_length, buffer, length);
-    data_length += length;
+    if (!wait_for_death(probes[i].pid, ms / 1000, (ms % 1000) * 1000L + 1))
+      ensure_death(probes[i].pid);
   }
 
-  /* Terminate the data string. */
-  data[data_length] = '\0';
-
-error:
-  /* Close the read end of the pipe. */
-  (void) close(child.stdout_fd);
-  /* Kill the script. */
-  if (!wait_for_death(child.pid, 0, 500000L))
-    ensure_death(child.pid);
-
   if (tmp_error != NULL) {
     g_propagate_error(error, tmp_error);
-    g_free(data);
-    data = NULL;
+    return false;
   }
 
-  return data;
+  return true;
 }
 
-static void parse_dependency(char *data, GList **dependency_list)
+/* Split the dependency data at whitespace and add the items to the plugin's
+ * dependencies.  The data is modified. */
+static void parse_dependency(char *data, VlockPlugin *plugin,
+                             size_t dependency)
 {
-  char **dependency_items = g_strsplit_set(g_strstrip(data), " \r\n", -1);
-
-  for (size_t i = 0; dependency_items[i] != NULL; i++)
-    *dependency_list = g_list_append(
-      *dependency_list,
-      g_strdup(dependency_items[i])
-      );
+  char *saveptr;
 
-  g_strfreev(dependency_items);
+  for (char *item = strtok_r(data, " \t\r\n", &saveptr);
+       item != NULL;
+       item = strtok_r(NULL, " \t\r\n", &saveptr))
+    vlock_plugin_add_dependency(plugin, dependency, item);
 }
 
+#ifndef NO_GLIB
 G_DEFINE_TYPE(VlockScript, vlock_script, TYPE_VLOCK_PLUGIN)
 
 #define VLOCK_SCRIPT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj),\
                                                                    TYPE_VLOCK_SCRIPT,\
                                                                    VlockScriptPrivate))
+#else
+/* The private data is allocated directly after the instance. */
+#define VLOCK_SCRIPT_GET_PRIVATE(obj) ((VlockScriptPrivate *)\
+                                       (VLOCK_SCRIPT(obj) + 1))
+#endif
+
+/* Maximum number of hooks that are queued for a busy script. */
+#define SCRIPT_QUEUE_SIZE 8
 
 struct _VlockScriptPrivate
 {
@@ -227,8 +298,15 @@ struct _VlockScriptPrivate
   bool dead;
   /* The pipe file descriptor that is connected to the script's stdin. */
   int fd;
-  /* The PID of the script. */
+  /* Indices into hooks[] of the hooks that are not written yet, oldest
+   * first, and how many bytes of the line of the oldest were written. */
+  unsigned char queue[SCRIPT_QUEUE_SIZE];
+  size_t queue_length;
+  size_t queue_offset;
+  /* The PID of the script which is also its process group. */
   pid_t pid;
+  /* The cgroup of the script or NULL. */
+  char *cgroup;
 };
 
 /* Initialize plugin to default values. */
@@ -239,24 +317,56 @@ static void vlock_script_init(VlockScript *self)
   self->priv->dead = false;
   self->priv->launched = false;
   self->priv->path = NULL;
+  self->priv->cgroup = NULL;
+  self->priv->queue_length = 0;
+  self->priv->queue_offset = 0;
 }
 
+static bool flush_queue(VlockScript *self);
+
+#ifndef NO_GLIB
 static void vlock_script_finalize(GObject *object)
+#else
+static void vlock_script_finalize(VlockPlugin *object)
+#endif
 {
   VlockScript *self = VLOCK_SCRIPT(object);
 
   g_free(self->priv->path);
 
   if (self->priv->launched) {
+    struct timespec deadline;
+
+    /* Give the script a moment to take the last hooks, e.g. vlock_end. */
+    set_deadline(&deadline, 500);
+
+    while (!self->priv->dead && self->priv->queue_length > 0
+           && flush_queue(self) && self->priv->queue_length > 0) {
+      struct pollfd pfd = { .fd = self->priv->fd, .events = POLLOUT };
+      int ms = remaining_ms(&deadline);
+
+      if (ms == 0 || (poll(&pfd, 1, ms) < 0 && errno != EINTR))
+        break;
+    }
+
     /* Close the pipe. */
     (void) close(self->priv->fd);
 
-    /* Kill the child process. */
+    /* Kill the child process and everything it started. */
     if (!wait_for_death(self->priv->pid, 0, 500000L))
-      ensure_death(self->priv->pid);
+      ensure_group_death(self->priv->pid);
+    else
+      (void) kill(-self->priv->pid, SIGKILL);
+  }
+
+  if (self->priv->cgroup != NULL) {
+    cgroup_destroy(self->priv->cgroup);
+    g_free(self->priv->cgroup);
   }
 
+#ifndef NO_GLIB
   G_OBJECT_CLASS(vlock_script_parent_class)->finalize(object);
+#endif
 }
 
 static bool vlock_script_open(VlockPlugin *plugin, GError **error)
@@ -268,30 +378,61 @@ static bool vlock_script_open(VlockPlugin *plugin, GError **error)
 
   /* Get the dependency information.  Whether the script is executable or not
    * is also detected here. */
-  for (size_t i = 0; i < nr_dependencies; i++)
-    if (!get_dependency(self->priv->path, dependency_names[i],
-                        &plugin->dependencies[i], &tmp_error)) {
-      if (g_error_matches(tmp_error,
-                          VLOCK_PROCESS_ERROR,
-                          VLOCK_PROCESS_ERROR_NOT_FOUND) && i == 0) {
-        g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_NOT_FOUND,
-                    "%s", tmp_error->message);
-        g_clear_error(&tmp_error);
-      } else
-        g_propagate_error(error, tmp_error);
+  if (!get_dependencies(self->priv->path, plugin, &tmp_error)) {
+    if (g_error_matches(tmp_error,
+                        VLOCK_PROCESS_ERROR,
+                        VLOCK_PROCESS_ERROR_NOT_FOUND)) {
+      g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_NOT_FOUND,
+                  "%s", tmp_error->message);
+      g_clear_error(&tmp_error);
+    } else
+      g_propagate_error(error, tmp_error);
 
-      return false;
-    }
+    return false;
+  }
 
   return true;
 }
 
+/* Parse the number in the given environment variable, 0 if it is not
+ * set. */
+static unsigned long get_limit(const char *variable)
+{
+  const char *value = getenv(variable);
+
+  if (value == NULL)
+    return 0;
+
+  return strtoul(value, NULL, 10);
+}
+
+/* Get the delegated cgroup directory from the environment.  It is ignored if
+ * vlock runs setuid or setgid because the environment is untrusted then.  The
+ * directory given to configure is used instead, if any. */
+static const char *get_cgroup_base(void)
+{
+  const char *base = getenv("VLOCK_CGROUP");
+
+  if (base == NULL || *base == '\0'
+      || getuid() != geteuid() || getgid() != getegid())
+    base = VLOCK_CGROUP_BASE;
+
+  return *base != '\0' ? base : NULL;
+}
+
 /* Launch the script creating a new script_context. */
 static bool vlock_script_launch(VlockScript *script, GError **error)
 {
   GError *tmp_error = NULL;
   int fd_flags;
   const char *argv[] = { script->priv->path, "hooks", NULL };
+  const char *cgroup_base = get_cgroup_base();
+  struct child_limits limits = {
+    .cpu_seconds = get_limit("VLOCK_PLUGIN_CPU_LIMIT"),
+    .memory_kb = get_limit("VLOCK_PLUGIN_MEMORY_LIMIT"),
+    .processes = get_limit("VLOCK_PLUGIN_PROCESS_LIMIT"),
+    .cpu_percent = get_limit("VLOCK_PLUGIN_CPU_QUOTA"),
+  };
   struct child_process child = {
     .path = script->priv->path,
     .argv = argv,
@@ -299,8 +440,20 @@ static bool vlock_script_launch(VlockScript *script, GError **error)
     .stdout_fd = REDIRECT_DEV_NULL,
     .stderr_fd = REDIRECT_DEV_NULL,
     .function = NULL,
+    .new_group = true,
+    .limits = &limits,
+    /* The same process runs every hook, not only vlock_save, so it keeps
+     * the normal priority. */
+    .background = false,
   };
 
+  if (cgroup_base != NULL)
+    script->priv->cgroup = cgroup_create(cgroup_base,
+                                         VLOCK_PLUGIN(script)->name,
+                                         &limits);
+
+  child.cgroup = script->priv->cgroup;
+
   if (!create_child(&child, &tmp_error)) {
     g_propagate_error(error, tmp_error);
     return false;
@@ -319,14 +472,87 @@ static bool vlock_script_launch(VlockScript *script, GError **error)
   return true;
 }
 
-static bool vlock_script_call_hook(VlockPlugin *plugin, const gchar *hook_name)
+/* Write as much of the queued hooks as possible without blocking.  Returns
+ * false if the script died. */
+static bool flush_queue(VlockScript *self)
 {
-  VlockScript *self = VLOCK_SCRIPT(plugin);
-  static const char newline = '\n';
-  ssize_t hook_name_length = strlen(hook_name);
-  ssize_t length;
+  VlockScriptPrivate *priv = self->priv;
   struct sigaction act;
   struct sigaction oldact;
+  bool result = true;
+
+  /* When writing to a pipe when the read end is closed the kernel invariably
+   * sends SIGPIPE.   Ignore it. */
+  (void) sigemptyset(&(act.sa_mask));
+  act.sa_flags = SA_RESTART;
+  act.sa_handler = SIG_IGN;
+  (void) sigaction(SIGPIPE, &act, &oldact);
+
+  while (priv->queue_length > 0) {
+    char line[64];
+    size_t length = snprintf(line, sizeof line, "%s\n",
+                             hooks[priv->queue[0]].name);
+    ssize_t written = write(priv->fd, line + priv->queue_offset,
+                            length - priv->queue_offset);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+
+      /* The script is busy. */
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+
+      result = false;
+      break;
+    }
+
+    priv->queue_offset += written;
+
+    if (priv->queue_offset == length) {
+      priv->queue_length--;
+      memmove(priv->queue, priv->queue + 1, priv->queue_length);
+      priv->queue_offset = 0;
+    }
+  }
+
+  /* Restore the previous SIGPIPE handler. */
+  (void) sigaction(SIGPIPE, &oldact, NULL);
+
+  return result;
+}
+
+/* Queue the given hook.  A vlock_save_abort cancels a vlock_save that was not
+ * written yet.  If the queue is full errno is set to EAGAIN and false is
+ * returned. */
+static bool queue_hook(VlockScript *self, size_t hook)
+{
+  VlockScriptPrivate *priv = self->priv;
+  /* The oldest hook cannot be taken back once it is partly written. */
+  size_t first_unwritten = priv->queue_offset > 0 ? 1 : 0;
+
+  if (strcmp(hooks[hook].name, "vlock_save_abort") == 0
+      && priv->queue_length > first_unwritten
+      && strcmp(hooks[priv->queue[priv->queue_length - 1]].name,
+                "vlock_save") == 0) {
+    priv->queue_length--;
+    return true;
+  }
+
+  if (priv->queue_length == SCRIPT_QUEUE_SIZE) {
+    errno = EAGAIN;
+    return false;
+  }
+
+  priv->queue[priv->queue_length++] = hook;
+
+  return true;
+}
+
+static bool vlock_script_call_hook(VlockPlugin *plugin, const gchar *hook_name)
+{
+  VlockScript *self = VLOCK_SCRIPT(plugin);
+  size_t hook;
 
   if (!self->priv->launched) {
     /* Launch script. */
@@ -339,32 +565,69 @@ static bool vlock_script_call_hook(VlockPlugin *plugin, const gchar *hook_name)
     }
   }
 
-  if (self->priv->dead)
+  if (self->priv->dead) {
     /* Nothing to do. */
+    errno = EPIPE;
     return false;
+  }
 
-  /* When writing to a pipe when the read end is closed the kernel invariably
-   * sends SIGPIPE.   Ignore it. */
-  (void) sigemptyset(&(act.sa_mask));
-  act.sa_flags = SA_RESTART;
-  act.sa_handler = SIG_IGN;
-  (void) sigaction(SIGPIPE, &act, &oldact);
-
-  /* Send hook name and a newline through the pipe. */
-  length = write(self->priv->fd, hook_name, hook_name_length);
+  for (hook = 0; hook < nr_hooks; hook++)
+    if (strcmp(hook_name, hooks[hook].name) == 0)
+      break;
 
-  if (length > 0)
-    length += write(self->priv->fd, &newline, sizeof newline);
+  if (hook == nr_hooks) {
+    errno = EINVAL;
+    return false;
+  }
 
-  /* Restore the previous SIGPIPE handler. */
-  (void) sigaction(SIGPIPE, &oldact, NULL);
+  /* A full queue is not fatal. */
+  if (!queue_hook(self, hook))
+    return false;
 
   /* If write fails the script is considered dead. */
-  self->priv->dead = (length != hook_name_length + 1);
+  self->priv->dead = !flush_queue(self);
 
   return !self->priv->dead;
 }
 
+static bool vlock_script_get_pending_output(VlockPlugin *plugin, int *fd)
+{
+  VlockScript *self = VLOCK_SCRIPT(plugin);
+
+  if (self->priv->dead || self->priv->queue_length == 0)
+    return false;
+
+  *fd = self->priv->fd;
+
+  return true;
+}
+
+static void vlock_script_flush_output(VlockPlugin *plugin)
+{
+  VlockScript *self = VLOCK_SCRIPT(plugin);
+
+  if (!flush_queue(self))
+    self->priv->dead = true;
+}
+
+static bool vlock_script_get_usage(VlockPlugin *plugin,
+                                   struct child_usage *usage)
+{
+  VlockScript *self = VLOCK_SCRIPT(plugin);
+
+  if (!self->priv->launched)
+    return false;
+
+  /* The cgroup also counts processes that left the process group. */
+  if (self->priv->cgroup != NULL
+      && cgroup_get_usage(self->priv->cgroup, usage))
+    return true;
+
+  return get_child_usage(self->priv->pid, usage);
+}
+
+#ifndef NO_GLIB
+
 /* Initialize script class. */
 static void vlock_script_class_init(VlockScriptClass *klass)
 {
@@ -378,5 +641,34 @@ static void vlock_script_class_init(VlockScriptClass *klass)
 
   plugin_class->open = vlock_script_open;
   plugin_class->call_hook = vlock_script_call_hook;
+  plugin_class->get_pending_output = vlock_script_get_pending_output;
+  plugin_class->flush_output = vlock_script_flush_output;
+  plugin_class->get_usage = vlock_script_get_usage;
+}
+
+#else /* NO_GLIB */
+
+static void vlock_script_instance_init(VlockPlugin *plugin)
+{
+  vlock_script_init(VLOCK_SCRIPT(plugin));
+}
+
+static const VlockScriptClass vlock_script_class = {
+  .parent_class = {
+    .instance_size = sizeof(VlockScript) + sizeof(VlockScriptPrivate),
+    .init = vlock_script_instance_init,
+    .finalize = vlock_script_finalize,
+    .open = vlock_script_open,
+    .call_hook = vlock_script_call_hook,
+    .get_pending_output = vlock_script_get_pending_output,
+    .flush_output = vlock_script_flush_output,
+    .get_usage = vlock_script_get_usage,
+  },
+};
+
+VlockPluginType vlock_script_get_type(void)
+{
+  return &vlock_script_class.parent_class;
 }
 
+#endif /* NO_GLIB */
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <glib-object.h>
+#include "plugin.h"
 
 /*
  * Script type macros.
  */
 #define TYPE_VLOCK_SCRIPT (vlock_script_get_type())
+
+#ifndef NO_GLIB
 #define VLOCK_SCRIPT(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), TYPE_VLOCK_SCRIPT,\
                                                       VlockScript))
 #define VLOCK_SCRIPT_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),\
@@ -18,6 +21,9 @@
 #define VLOCK_SCRIPT_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS((obj),\
                                                                TYPE_VLOCK_SCRIPT,\
                                                                VlockScriptClass))
+#else
+#define VLOCK_SCRIPT(obj) ((VlockScript *)(obj))
+#endif
 
 typedef struct _VlockScript VlockScript;
 typedef struct _VlockScriptClass VlockScriptClass;
@@ -36,4 +42,4 @@ struct _VlockScriptClass
   VlockPluginClass parent_class;
 };
 
-GType vlock_script_get_type(void);
+VlockPluginType vlock_script_get_type(void);
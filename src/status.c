@@ -0,0 +1,193 @@
+/* status.c -- status page for vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "util.h"
+
+#include "status.h"
+
+/* The mapped status record or NULL. */
+static struct vlock_status *status;
+/* Path of the status file. */
+static char status_path[PATH_MAX];
+
+bool status_open(const char *directory)
+{
+  struct vlock_status *s;
+  int fd;
+
+  if (status != NULL)
+    return true;
+
+  if (snprintf(status_path, sizeof status_path, "%s/%lu", directory,
+               (unsigned long) getpid()) >= (int) sizeof status_path) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+
+  if (mkdir(directory, 0755) < 0 && errno != EEXIST)
+    return false;
+
+  /* Remove a stale file from a process with the same PID. */
+  (void) unlink(status_path);
+
+  fd = open(status_path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+
+  if (fd < 0)
+    return false;
+
+  /* Make sure it is readable regardless of the umask. */
+  if (fchmod(fd, 0644) < 0 || ftruncate(fd, sizeof *s) < 0)
+    goto error;
+
+  s = mmap(NULL, sizeof *s, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (s == MAP_FAILED)
+    goto error;
+
+  (void) close(fd);
+
+  /* The file is zero filled.  Write the header last so readers never see
+   * a valid magic number with incomplete contents. */
+  s->pid = getpid();
+  s->vt = -1;
+  s->version = VLOCK_STATUS_VERSION;
+  __atomic_store_n(&s->magic, VLOCK_STATUS_MAGIC, __ATOMIC_RELEASE);
+
+  status = s;
+
+  return true;
+
+error:
+  GUARD_ERRNO((void) close(fd); (void) unlink(status_path));
+  return false;
+}
+
+void status_close(void)
+{
+  if (status == NULL)
+    return;
+
+  status_set_state(VLOCK_STATUS_UNLOCKED);
+
+  (void) unlink(status_path);
+  (void) munmap(status, sizeof *status);
+  status = NULL;
+}
+
+/* Mark the record as being written. */
+static void begin_update(void)
+{
+  __atomic_add_fetch(&status->sequence, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Publish the changes. */
+static void end_update(void)
+{
+  __atomic_add_fetch(&status->sequence, 1, __ATOMIC_RELEASE);
+}
+
+#define STATUS_UPDATE(statement) \
+  do { \
+    if (status != NULL) { \
+      begin_update(); \
+      statement; \
+      end_update(); \
+    } \
+  } while (0)
+
+void status_set_state(uint32_t state)
+{
+  STATUS_UPDATE({
+    status->state = state;
+
+    if (state == VLOCK_STATUS_LOCKED)
+      status->lock_time = time(NULL);
+    else
+      status->lock_time = 0;
+  });
+}
+
+void status_set_mode(uint32_t mode)
+{
+  STATUS_UPDATE(status->mode = mode);
+}
+
+void status_set_vt(int32_t vt)
+{
+  STATUS_UPDATE(status->vt = vt);
+}
+
+void status_set_failed_attempts(uint32_t failed_attempts)
+{
+  STATUS_UPDATE(status->failed_attempts = failed_attempts);
+}
+
+void status_set_save_stage(uint32_t save_stage)
+{
+  STATUS_UPDATE(status->save_stage = save_stage);
+}
+
+void status_set_plugins(const char *plugins)
+{
+  STATUS_UPDATE({
+    strncpy(status->plugins, plugins, sizeof status->plugins - 1);
+    status->plugins[sizeof status->plugins - 1] = '\0';
+  });
+}
+
+struct vlock_counters *status_get_counters(void)
+{
+  return status != NULL ? &status->counters : NULL;
+}
+
+bool vlock_status_read(const struct vlock_status *s,
+                       struct vlock_status *snapshot)
+{
+  if (__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != VLOCK_STATUS_MAGIC
+      || s->version != VLOCK_STATUS_VERSION)
+    return false;
+
+  /* Give up if the writer does not finish, e.g. because it was killed in
+   * the middle of an update. */
+  for (int tries = 0; tries < 1000; tries++) {
+    uint32_t sequence = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE);
+
+    if (sequence % 2 == 0) {
+      memcpy(snapshot, (const void *) s, sizeof *snapshot);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+      if (__atomic_load_n(&s->sequence, __ATOMIC_RELAXED) == sequence) {
+        snapshot->sequence = sequence;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,108 @@
+/* status.h -- header file for the status page of vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* While vlock-main runs it publishes its state in a world readable file
+ * "<pid>" in the status directory (by default /run/vlock).  The file contains
+ * a single struct vlock_status and is updated in place through a shared
+ * mapping.  Monitoring programs should map it read-only and take consistent
+ * snapshots with vlock_status_read().
+ *
+ * Updates are protected by a sequence lock:  the writer increments sequence
+ * before and after every update, so it is odd while an update is in progress.
+ * A reader copies the record and retries if sequence was odd or changed in
+ * the meantime.  The file is removed when vlock-main exits.  If vlock-main
+ * was killed with SIGKILL a stale file is left, so readers should check
+ * that pid is still alive. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "counters.h"
+
+#define VLOCK_STATUS_MAGIC 0x4b434c56 /* "VLCK" in little endian */
+#define VLOCK_STATUS_VERSION 3
+
+/* Lock states. */
+enum {
+  VLOCK_STATUS_STARTING = 0,
+  VLOCK_STATUS_LOCKED = 1,
+  VLOCK_STATUS_UNLOCKED = 2,
+};
+
+/* Lock mode flags. */
+enum {
+  /* Console switching is disabled. */
+  VLOCK_STATUS_MODE_ALL = 1 << 0,
+  /* The lock runs on a newly allocated console. */
+  VLOCK_STATUS_MODE_NEW = 1 << 1,
+};
+
+/* Save stages. */
+enum {
+  VLOCK_STATUS_SAVE_NONE = 0,
+  /* The vlock_save hooks were called, e.g. the screen is blanked. */
+  VLOCK_STATUS_SAVE_ACTIVE = 1,
+};
+
+#define VLOCK_STATUS_PLUGINS_SIZE 256
+
+struct vlock_status
+{
+  uint32_t magic;
+  uint32_t version;
+  /* Odd while the record is being written. */
+  uint32_t sequence;
+  uint32_t pid;
+  uint32_t state;
+  uint32_t mode;
+  /* Number of the locked virtual console or -1 if unknown. */
+  int32_t vt;
+  uint32_t failed_attempts;
+  uint32_t save_stage;
+  uint32_t reserved;
+  /* Seconds since the epoch when the lock was engaged, 0 if not locked. */
+  int64_t lock_time;
+  /* Names of the loaded plugins in the order they are called, separated by
+   * spaces and truncated if too long. */
+  char plugins[VLOCK_STATUS_PLUGINS_SIZE];
+  /* The resource counters, see counters.h.  They change without taking the
+   * sequence lock, but every value is written atomically. */
+  struct vlock_counters counters;
+};
+
+/* Create the status file for this process in the given directory, which is
+ * created if it does not exist.  On failure false is returned and errno is
+ * set.  All other functions do nothing if the status file is not open. */
+bool status_open(const char *directory);
+
+/* Remove the status file. */
+void status_close(void);
+
+void status_set_state(uint32_t state);
+void status_set_mode(uint32_t mode);
+void status_set_vt(int32_t vt);
+void status_set_failed_attempts(uint32_t failed_attempts);
+void status_set_save_stage(uint32_t save_stage);
+void status_set_plugins(const char *plugins);
+
+/* Get the counters on the status page for counters_attach() or NULL if the
+ * status file is not open. */
+struct vlock_counters *status_get_counters(void);
+
+/* Take a consistent snapshot of the given status record, which is usually
+ * mapped from a status file.  Returns false if the record has an unknown
+ * format or no consistent snapshot could be taken. */
+bool vlock_status_read(const struct vlock_status *status,
+                       struct vlock_status *snapshot);
@@ -0,0 +1,604 @@
+/* synthetic.c -- synthetic plugins for vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "plugin.h"
+#include "synthetic.h"
+
+/* The definition of a synthetic plugin. */
+struct definition
+{
+  gchar *name;
+  /* The dependencies in the same format as in a plugin. */
+  gchar **dependencies[nr_dependencies];
+  size_t dependency_counts[nr_dependencies];
+  /* Time each hook takes in microseconds. */
+  unsigned int hook_latency[nr_hooks];
+  /* Errno value each hook fails with or 0. */
+  int hook_error[nr_hooks];
+  /* Timeout of asynchronous hooks in milliseconds or 0. */
+  unsigned int async_timeout;
+  /* Does the plugin use the display? */
+  unsigned int display;
+  /* Is the plugin critical for the lock? */
+  unsigned int critical;
+};
+
+static struct definition *definitions;
+static size_t nr_definitions;
+
+/* Open addressing hash table of definition indices plus one, zero marks an
+ * empty slot.  The size is a power of two and at least twice the number of
+ * definitions.  Large generated graphs would spend all their time looking up
+ * definitions otherwise. */
+static size_t *definition_index;
+static size_t definition_index_size;
+
+unsigned long vlock_synthetic_hook_calls;
+
+/* FNV-1a */
+static size_t hash_name(const char *name)
+{
+  size_t h = 2166136261u;
+
+  for (const unsigned char *p = (const unsigned char *) name; *p != '\0'; p++)
+    h = (h ^ *p) * 16777619u;
+
+  return h;
+}
+
+static void index_definition(size_t n)
+{
+  size_t mask = definition_index_size - 1;
+  size_t i = hash_name(definitions[n].name) & mask;
+
+  while (definition_index[i] != 0)
+    i = (i + 1) & mask;
+
+  definition_index[i] = n + 1;
+}
+
+/* Return the index of the named definition or -1. */
+static ssize_t find_definition(const char *name)
+{
+  size_t mask = definition_index_size - 1;
+
+  if (definition_index_size == 0)
+    return -1;
+
+  for (size_t i = hash_name(name) & mask; definition_index[i] != 0;
+       i = (i + 1) & mask) {
+    size_t n = definition_index[i] - 1;
+
+    if (strcmp(definitions[n].name, name) == 0)
+      return n;
+  }
+
+  return -1;
+}
+
+/* Return the index of the named definition, defining it if necessary. */
+static size_t get_definition(const char *name)
+{
+  ssize_t n = find_definition(name);
+
+  if (n >= 0)
+    return n;
+
+  if (2 * (nr_definitions + 1) > definition_index_size) {
+    size_t size = definition_index_size ? 2 * definition_index_size : 64;
+
+    g_free(definition_index);
+    definition_index = g_new0(size_t, size);
+    definition_index_size = size;
+
+    for (size_t i = 0; i < nr_definitions; i++)
+      index_definition(i);
+  }
+
+  definitions = g_renew(struct definition, definitions, nr_definitions + 1);
+  memset(&definitions[nr_definitions], 0, sizeof definitions[0]);
+  definitions[nr_definitions].name = g_strdup(name);
+  index_definition(nr_definitions);
+
+  return nr_definitions++;
+}
+
+static ssize_t get_dependency_index(const char *dependency)
+{
+  for (size_t i = 0; i < nr_dependencies; i++)
+    if (strcmp(dependency_names[i], dependency) == 0)
+      return i;
+
+  return -1;
+}
+
+static ssize_t get_hook_index(const char *hook_name)
+{
+  for (size_t i = 0; i < nr_hooks; i++)
+    if (strcmp(hooks[i].name, hook_name) == 0)
+      return i;
+
+  return -1;
+}
+
+static void add_dependency(size_t n, size_t dependency, const char *other)
+{
+  struct definition *d = &definitions[n];
+  size_t length = d->dependency_counts[dependency];
+
+  d->dependencies[dependency] = g_renew(gchar *, d->dependencies[dependency],
+                                        length + 2);
+  d->dependencies[dependency][length] = g_strdup(other);
+  d->dependencies[dependency][length + 1] = NULL;
+  d->dependency_counts[dependency]++;
+}
+
+void vlock_synthetic_define(const char *name)
+{
+  (void) get_definition(name);
+}
+
+void vlock_synthetic_add_dependency(const char *name,
+                                    const char *dependency,
+                                    const char *other)
+{
+  ssize_t i = get_dependency_index(dependency);
+
+  g_assert(i >= 0);
+
+  add_dependency(get_definition(name), i, other);
+}
+
+void vlock_synthetic_set_hook_latency(const char *name,
+                                      const char *hook_name,
+                                      unsigned int microseconds)
+{
+  ssize_t i = get_hook_index(hook_name);
+  size_t n;
+
+  g_assert(i >= 0);
+
+  /* get_definition() may move the definitions. */
+  n = get_definition(name);
+  definitions[n].hook_latency[i] = microseconds;
+}
+
+void vlock_synthetic_set_hook_error(const char *name,
+                                    const char *hook_name,
+                                    int error)
+{
+  ssize_t i = get_hook_index(hook_name);
+  size_t n;
+
+  g_assert(i >= 0);
+
+  /* get_definition() may move the definitions. */
+  n = get_definition(name);
+  definitions[n].hook_error[i] = error;
+}
+
+void vlock_synthetic_set_async_timeout(const char *name,
+                                       unsigned int milliseconds)
+{
+  size_t n = get_definition(name);
+
+  definitions[n].async_timeout = milliseconds;
+}
+
+void vlock_synthetic_set_display(const char *name, bool display)
+{
+  size_t n = get_definition(name);
+
+  definitions[n].display = display;
+}
+
+void vlock_synthetic_set_critical(const char *name, bool critical)
+{
+  size_t n = get_definition(name);
+
+  definitions[n].critical = critical;
+}
+
+/* Parse a number for a "key=value" word of a definition. */
+static bool parse_spec_number(const char *value, unsigned int *number,
+                              const char *filename, unsigned int line,
+                              GError **error)
+{
+  char *end;
+  unsigned long n;
+
+  errno = 0;
+  n = strtoul(value, &end, 10);
+
+  if (errno != 0 || *end != '\0' || n > UINT32_MAX) {
+    g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_FAILED,
+                "%s:%u: invalid number '%s'", filename, line, value);
+    errno = 0;
+    return false;
+  }
+
+  *number = n;
+
+  return true;
+}
+
+/* Parse a single "key=value" word of a definition. */
+static bool parse_spec_word(size_t n, char *word, const char *filename,
+                            unsigned int line, GError **error)
+{
+  char *value = strchr(word, '=');
+  ssize_t i;
+
+  if (value == NULL || value[1] == '\0') {
+    g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_FAILED,
+                "%s:%u: '%s' is not of the form key=value", filename, line,
+                word);
+    return false;
+  }
+
+  *value++ = '\0';
+
+  if ((i = get_dependency_index(word)) >= 0) {
+    char *saveptr;
+
+    for (char *other = strtok_r(value, ",", &saveptr); other != NULL;
+         other = strtok_r(NULL, ",", &saveptr))
+      add_dependency(n, i, other);
+  } else if ((i = get_hook_index(word)) >= 0) {
+    return parse_spec_number(value, &definitions[n].hook_latency[i],
+                             filename, line, error);
+  } else if (strcmp(word, "async") == 0) {
+    return parse_spec_number(value, &definitions[n].async_timeout,
+                             filename, line, error);
+  } else if (strcmp(word, "display") == 0) {
+    return parse_spec_number(value, &definitions[n].display,
+                             filename, line, error);
+  } else if (strcmp(word, "critical") == 0) {
+    return parse_spec_number(value, &definitions[n].critical,
+                             filename, line, error);
+  } else {
+    g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_FAILED,
+                "%s:%u: unknown dependency or hook '%s'", filename, line,
+                word);
+    return false;
+  }
+
+  return true;
+}
+
+bool vlock_synthetic_load_spec(FILE *file,
+                               const char *filename,
+                               GError **error)
+{
+  char *buffer = NULL;
+  size_t buffer_size = 0;
+  unsigned int line = 0;
+  bool result = true;
+
+  while (result && getline(&buffer, &buffer_size, file) >= 0) {
+    char *saveptr;
+    char *word = strtok_r(buffer, " \t\n", &saveptr);
+    size_t n;
+
+    line++;
+
+    if (word == NULL || word[0] == '#')
+      continue;
+
+    n = get_definition(word);
+
+    while (result && (word = strtok_r(NULL, " \t\n", &saveptr)) != NULL)
+      result = parse_spec_word(n, word, filename, line, error);
+  }
+
+  if (result && ferror(file)) {
+    g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_FAILED,
+                "%s: %s", filename, g_strerror(errno));
+    errno = 0;
+    result = false;
+  }
+
+  free(buffer);
+
+  return result;
+}
+
+/* xorshift32, never returns 0 */
+static uint32_t next_random(uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  return *state = x;
+}
+
+/* Return floor(average) or floor(average) + 1 such that the mean is the
+ * given average. */
+static size_t random_count(uint32_t *state, double average)
+{
+  size_t count = (size_t) average;
+  double fraction = average - count;
+
+  if (fraction > 0 && next_random(state) < fraction * UINT32_MAX)
+    count++;
+
+  return count;
+}
+
+void vlock_synthetic_generate(size_t nr_plugins,
+                              const struct vlock_synthetic_graph *graph)
+{
+  uint32_t state = graph->seed ? graph->seed : 1;
+  const struct { size_t dependency; double average; } kinds[] = {
+    { get_dependency_index("succeeds"), graph->succeeds },
+    { get_dependency_index("requires"), graph->requires },
+    { get_dependency_index("depends"), graph->depends },
+  };
+  size_t conflicts = get_dependency_index("conflicts");
+  size_t succeeds = kinds[0].dependency;
+  size_t *index = g_new(size_t, nr_plugins);
+  char name[32];
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    snprintf(name, sizeof name, "p%zu", i);
+    index[i] = get_definition(name);
+  }
+
+  for (size_t i = 1; i < nr_plugins; i++)
+    for (size_t k = 0; k < sizeof kinds / sizeof kinds[0]; k++)
+      for (size_t count = random_count(&state, kinds[k].average); count > 0;
+           count--) {
+        size_t j = next_random(&state) % i;
+
+        add_dependency(index[i], kinds[k].dependency,
+                       definitions[index[j]].name);
+      }
+
+  for (size_t i = 0; i < nr_plugins; i++)
+    for (size_t count = random_count(&state, graph->conflicts); count > 0;
+         count--) {
+      snprintf(name, sizeof name, "x%zu",
+               (size_t) next_random(&state) % nr_plugins);
+      add_dependency(index[i], conflicts, name);
+    }
+
+  /* Close the circle p0 -> p1 -> ... -> p<circle_length - 1> -> p0. */
+  if (graph->circle_length > 1 && graph->circle_length <= nr_plugins) {
+    size_t last = graph->circle_length - 1;
+
+    for (size_t i = 1; i <= last; i++)
+      add_dependency(index[i], succeeds, definitions[index[i - 1]].name);
+
+    add_dependency(index[0], succeeds, definitions[index[last]].name);
+  }
+
+  g_free(index);
+}
+
+size_t vlock_synthetic_count(void)
+{
+  return nr_definitions;
+}
+
+const char *vlock_synthetic_get_name(size_t n)
+{
+  g_assert(n < nr_definitions);
+  return definitions[n].name;
+}
+
+void vlock_synthetic_clear(void)
+{
+  for (size_t i = 0; i < nr_definitions; i++) {
+    for (size_t j = 0; j < nr_dependencies; j++) {
+      for (size_t k = 0; k < definitions[i].dependency_counts[j]; k++)
+        g_free(definitions[i].dependencies[j][k]);
+
+      g_free(definitions[i].dependencies[j]);
+    }
+
+    g_free(definitions[i].name);
+  }
+
+  g_free(definitions);
+  definitions = NULL;
+  nr_definitions = 0;
+
+  g_free(definition_index);
+  definition_index = NULL;
+  definition_index_size = 0;
+}
+
+/****************/
+/* plugin class */
+/****************/
+
+static bool vlock_synthetic_open(VlockPlugin *plugin, GError **error)
+{
+  VlockSynthetic *self = VLOCK_SYNTHETIC(plugin);
+  ssize_t n = find_definition(plugin->name);
+
+  if (n < 0) {
+    g_set_error(error, VLOCK_PLUGIN_ERROR, VLOCK_PLUGIN_ERROR_NOT_FOUND,
+                "%s", "no such plugin");
+    return false;
+  }
+
+  self->definition = n;
+
+  if (definitions[n].display)
+    plugin->capabilities |= VLOCK_PLUGIN_DISPLAY;
+
+  if (definitions[n].critical)
+    plugin->capabilities |= VLOCK_PLUGIN_LOCK_CRITICAL;
+
+  for (size_t i = 0; i < nr_dependencies; i++)
+    for (size_t k = 0; k < definitions[n].dependency_counts[i]; k++)
+      vlock_plugin_add_dependency(plugin, i,
+                                  definitions[n].dependencies[i][k]);
+
+  return true;
+}
+
+static bool vlock_synthetic_finish_hook(VlockPlugin *plugin, bool cancel)
+{
+  VlockSynthetic *self = VLOCK_SYNTHETIC(plugin);
+
+  g_assert(self->pending_fd >= 0);
+
+  (void) close(self->pending_fd);
+  self->pending_fd = -1;
+
+  return !cancel;
+}
+
+static bool vlock_synthetic_get_pending_hook(VlockPlugin *plugin,
+                                             int *fd,
+                                             unsigned int *timeout)
+{
+  VlockSynthetic *self = VLOCK_SYNTHETIC(plugin);
+
+  if (self->pending_fd < 0)
+    return false;
+
+  *fd = self->pending_fd;
+  *timeout = definitions[self->definition].async_timeout;
+
+  return true;
+}
+
+static bool vlock_synthetic_call_hook(VlockPlugin *plugin,
+                                      const gchar *hook_name)
+{
+  VlockSynthetic *self = VLOCK_SYNTHETIC(plugin);
+  ssize_t i = get_hook_index(hook_name);
+
+  vlock_synthetic_hook_calls++;
+
+  if (i >= 0 && definitions[self->definition].hook_error[i] != 0) {
+    errno = definitions[self->definition].hook_error[i];
+    return false;
+  }
+
+  if (i >= 0 && definitions[self->definition].hook_latency[i] > 0) {
+    unsigned int microseconds = definitions[self->definition].hook_latency[i];
+    struct timespec t = {
+      microseconds / 1000000,
+      (microseconds % 1000000) * 1000
+    };
+
+    if (definitions[self->definition].async_timeout > 0) {
+      struct itimerspec timer = { .it_value = t };
+
+      if (self->pending_fd >= 0)
+        (void) vlock_synthetic_finish_hook(plugin, true);
+
+      self->pending_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+      return self->pending_fd >= 0
+             && timerfd_settime(self->pending_fd, 0, &timer, NULL) == 0;
+    }
+
+    while (nanosleep(&t, &t) < 0 && errno == EINTR)
+      ;
+
+    errno = 0;
+  }
+
+  return true;
+}
+
+#ifndef NO_GLIB
+
+G_DEFINE_TYPE(VlockSynthetic, vlock_synthetic, TYPE_VLOCK_PLUGIN)
+
+static void vlock_synthetic_init(VlockSynthetic *self)
+{
+  self->definition = 0;
+  self->pending_fd = -1;
+}
+
+static void vlock_synthetic_finalize(GObject *object)
+{
+  VlockSynthetic *self = VLOCK_SYNTHETIC(object);
+
+  if (self->pending_fd >= 0)
+    (void) close(self->pending_fd);
+
+  G_OBJECT_CLASS(vlock_synthetic_parent_class)->finalize(object);
+}
+
+static void vlock_synthetic_class_init(VlockSyntheticClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+  VlockPluginClass *plugin_class = VLOCK_PLUGIN_CLASS(klass);
+
+  gobject_class->finalize = vlock_synthetic_finalize;
+
+  plugin_class->open = vlock_synthetic_open;
+  plugin_class->call_hook = vlock_synthetic_call_hook;
+  plugin_class->get_pending_hook = vlock_synthetic_get_pending_hook;
+  plugin_class->finish_hook = vlock_synthetic_finish_hook;
+}
+
+#else /* NO_GLIB */
+
+static void vlock_synthetic_init(VlockPlugin *plugin)
+{
+  VLOCK_SYNTHETIC(plugin)->pending_fd = -1;
+}
+
+static void vlock_synthetic_finalize(VlockPlugin *plugin)
+{
+  VlockSynthetic *self = VLOCK_SYNTHETIC(plugin);
+
+  if (self->pending_fd >= 0)
+    (void) close(self->pending_fd);
+}
+
+static const VlockSyntheticClass vlock_synthetic_class = {
+  .parent_class = {
+    .instance_size = sizeof(VlockSynthetic),
+    .init = vlock_synthetic_init,
+    .finalize = vlock_synthetic_finalize,
+    .open = vlock_synthetic_open,
+    .call_hook = vlock_synthetic_call_hook,
+    .get_pending_hook = vlock_synthetic_get_pending_hook,
+    .finish_hook = vlock_synthetic_finish_hook,
+  },
+};
+
+VlockPluginType vlock_synthetic_get_type(void)
+{
+  return &vlock_synthetic_class.parent_class;
+}
+
+#endif /* NO_GLIB */
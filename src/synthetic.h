@@ -0,0 +1,149 @@
+/* synthetic.h -- header file for the synthetic plugins of vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <glib-object.h>
+#include "plugin.h"
+
+/* Synthetic plugins stand in for modules and scripts in the tests and
+ * benchmarks.  They exist only in memory and are described by definitions
+ * that give their dependencies and the time each of their hooks takes.
+ * Opening a synthetic plugin fails with VLOCK_PLUGIN_ERROR_NOT_FOUND if there
+ * is no definition with its name.
+ *
+ * plugins.c loads synthetic plugins instead of modules and scripts if it is
+ * compiled with VLOCK_SYNTHETIC_PLUGINS defined. */
+
+/*
+ * Synthetic plugin type macros.
+ */
+#define TYPE_VLOCK_SYNTHETIC (vlock_synthetic_get_type())
+
+#ifndef NO_GLIB
+#define VLOCK_SYNTHETIC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+                                                         TYPE_VLOCK_SYNTHETIC,\
+                                                         VlockSynthetic))
+#define IS_VLOCK_SYNTHETIC(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+                                                            TYPE_VLOCK_SYNTHETIC))
+#else
+#define VLOCK_SYNTHETIC(obj) ((VlockSynthetic *)(obj))
+#endif
+
+typedef struct _VlockSynthetic VlockSynthetic;
+typedef struct _VlockSyntheticClass VlockSyntheticClass;
+
+struct _VlockSynthetic
+{
+  VlockPlugin parent_instance;
+
+  /* Index of the definition. */
+  size_t definition;
+
+  /* Timer of the running asynchronous hook or -1. */
+  int pending_fd;
+};
+
+struct _VlockSyntheticClass
+{
+  VlockPluginClass parent_class;
+};
+
+VlockPluginType vlock_synthetic_get_type(void);
+
+/* Define a plugin with the given name.  Defining a name twice is harmless. */
+void vlock_synthetic_define(const char *name);
+
+/* Add a dependency, e.g. "succeeds", on the other plugin to the definition of
+ * the named plugin, defining it if necessary. */
+void vlock_synthetic_add_dependency(const char *name,
+                                    const char *dependency,
+                                    const char *other);
+
+/* Make the given hook of the named plugin sleep for the given number of
+ * microseconds, defining the plugin if necessary. */
+void vlock_synthetic_set_hook_latency(const char *name,
+                                      const char *hook_name,
+                                      unsigned int microseconds);
+
+/* Make the given hook of the named plugin fail with the given errno value at
+ * once, defining the plugin if necessary.  An error of 0 makes it succeed
+ * again. */
+void vlock_synthetic_set_hook_error(const char *name,
+                                    const char *hook_name,
+                                    int error);
+
+/* Make the hooks of the named plugin asynchronous, defining the plugin if
+ * necessary.  Instead of sleeping a hook starts a timer that expires after the
+ * hook's latency and returns at once.  The hook is cancelled if the timer
+ * has not expired after the given number of milliseconds.  Cancelled hooks
+ * fail.  A timeout of 0 makes the hooks synchronous again. */
+void vlock_synthetic_set_async_timeout(const char *name,
+                                       unsigned int milliseconds);
+
+/* Declare whether the named plugin uses the display, defining it if
+ * necessary. */
+void vlock_synthetic_set_display(const char *name, bool display);
+
+/* Declare whether the named plugin is critical for the lock, defining it if
+ * necessary. */
+void vlock_synthetic_set_critical(const char *name, bool critical);
+
+/* Read definitions from the given file.  Every line consists of a plugin name
+ * followed by any number of "dependency=name,name,...",
+ * "hook_name=microseconds", "async=milliseconds", "display=0|1" and
+ * "critical=0|1" words,
+ * e.g.
+ *
+ *   screensaver requires=all succeeds=new vlock_save=2000 async=100 display=1
+ *
+ * Empty lines and lines starting with "#" are ignored. */
+bool vlock_synthetic_load_spec(FILE *file,
+                               const char *filename,
+                               GError **error);
+
+/* Parameters of a random plugin graph. */
+struct vlock_synthetic_graph
+{
+  /* Average number of dependencies of each kind per plugin. */
+  double succeeds;
+  double requires;
+  double depends;
+  double conflicts;
+  /* Number of plugins whose "succeeds" dependencies form a circle or 0. */
+  size_t circle_length;
+  /* Seed of the pseudo random number generator. */
+  unsigned int seed;
+};
+
+/* Define the plugins "p0" to "p<nr_plugins - 1>".  The "succeeds", "requires"
+ * and "depends" dependencies of a plugin only name plugins with smaller
+ * numbers, so they form a directed acyclic graph unless a circle is requested.
+ * "conflicts" dependencies name plugins "x<n>" which are never defined, so the
+ * conflicts are checked but resolving the dependencies does not fail because
+ * of them.  The same parameters always give the same graph. */
+void vlock_synthetic_generate(size_t nr_plugins,
+                              const struct vlock_synthetic_graph *graph);
+
+/* Get the number of definitions and the name of the nth definition, in the
+ * order they were defined. */
+size_t vlock_synthetic_count(void);
+const char *vlock_synthetic_get_name(size_t n);
+
+/* Forget all definitions.  Must not be called while synthetic plugins are
+ * loaded. */
+void vlock_synthetic_clear(void);
+
+/* Number of hook calls of all synthetic plugins. */
+extern unsigned long vlock_synthetic_hook_calls;
@@ -2,6 +2,8 @@
 #include <termios.h>
 
 #include "terminal.h"
+#include "counters.h"
+#include "trace.h"
 
 static struct termios term;
 static tcflag_t lflag;
@@ -13,6 +15,8 @@ void secure_terminal(void)
   lflag = term.c_lflag;
   term.c_lflag &= ~(ECHO | ISIG);
   (void) tcsetattr(STDIN_FILENO, TCSANOW, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
+  counters_add(VLOCK_COUNTER_TERMIOS, 2);
 }
 
 void restore_terminal(void)
@@ -20,5 +24,7 @@ void restore_terminal(void)
   /* Restore the terminal. */
   term.c_lflag = lflag;
   (void) tcsetattr(STDIN_FILENO, TCSANOW, &term);
+  VLOCK_PROBE1(termios, term.c_lflag);
+  counters_add(VLOCK_COUNTER_TERMIOS, 1);
 }
 
@@ -0,0 +1,60 @@
+/* trace.h -- static tracepoints of vlock,
+ *            the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* If vlock-main is configured with USDT probes (see --enable-usdt) the
+ * following tracepoints of the provider "vlock" can be attached to with perf
+ * or bpftrace, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/local/sbin/vlock-main:vlock:hook__end
+ *                { printf("%s %s %dus\n", str(arg0), str(arg1), arg3); }'
+ *
+ * Without a tracer attached a probe is a single nop instruction.  Without
+ * USDT support the probes compile to nothing and their arguments are not
+ * evaluated.
+ *
+ *   plugin__load__begin(name)
+ *   plugin__load__end(name, loaded)
+ *   resolve__begin(nr_plugins)
+ *   resolve__end(nr_plugins, resolved)
+ *   hook__begin(plugin, hook)
+ *   hook__end(plugin, hook, result, microseconds)
+ *   child__create(path, pid)           path is NULL for a function child
+ *   child__exec(pid, errno)            errno is 0 if exec succeeded
+ *   wait__for__death(pid, dead)
+ *   prompt__start()
+ *   prompt__submit(length)
+ *   auth__begin(user)                  around pam_authenticate(), which
+ *   auth__end(user, authenticated)     includes the prompt, or around the
+ *                                      shadow password check after it
+ *   termios(lflag)                     after every terminal attribute change
+ */
+
+#pragma once
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define VLOCK_PROBE(name) DTRACE_PROBE(vlock, name)
+#define VLOCK_PROBE1(name, a) DTRACE_PROBE1(vlock, name, a)
+#define VLOCK_PROBE2(name, a, b) DTRACE_PROBE2(vlock, name, a, b)
+#define VLOCK_PROBE4(name, a, b, c, d) DTRACE_PROBE4(vlock, name, a, b, c, d)
+
+#else /* !HAVE_SYS_SDT_H */
+
+#define VLOCK_PROBE(name) do { } while (0)
+#define VLOCK_PROBE1(name, a) do { } while (0)
+#define VLOCK_PROBE2(name, a, b) do { } while (0)
+#define VLOCK_PROBE4(name, a, b, c, d) do { } while (0)
+
+#endif /* HAVE_SYS_SDT_H */
@@ -10,103 +10,166 @@
  *
  */
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
+#include <glib.h>
+
 #include "util.h"
 
 #include "tsort.h"
 
-/* Get the zeros of the graph, i.e. nodes with no incoming edges. */
-static GList *get_zeros(GList *nodes, GList *edges)
+/* Open addressing hash table that maps the nodes to their indices plus one.
+ * A slot of zero is empty. */
+struct node_table
 {
-  GList *zeros = g_list_copy(nodes);
+  size_t *slots;
+  size_t mask;
+};
 
-  for (GList *edge_item = edges;
-       edge_item != NULL;
-       edge_item = g_list_next(edge_item)) {
-    struct edge *e = edge_item->data;
-    zeros = g_list_remove(zeros, e->successor);
-  }
+static size_t *node_slot(const struct node_table *table, void **nodes,
+                         void *node)
+{
+  uint64_t h = (uint64_t) (uintptr_t) node * UINT64_C(0x9e3779b97f4a7c15);
 
-  return zeros;
+  for (size_t i = (size_t) (h ^ (h >> 32)) & table->mask;;
+       i = (i + 1) & table->mask) {
+    size_t *slot = &table->slots[i];
+
+    if (*slot == 0 || nodes[*slot - 1] == node)
+      return slot;
+  }
 }
 
-/* Check if the given node is a zero. */
-static bool is_zero(void *node, GList *edges)
+/* Get the index of the given node or nr_nodes if it is not in the graph. */
+static size_t node_index(const struct node_table *table, void **nodes,
+                         size_t nr_nodes, void *node)
 {
-  for (GList *edge_item = edges;
-       edge_item != NULL;
-       edge_item = g_list_next(edge_item)) {
-    struct edge *e = edge_item->data;
-
-    if (e->successor == node)
-      return false;
-  }
+  size_t slot = *node_slot(table, nodes, node);
 
-  return true;
+  return slot == 0 ? nr_nodes : slot - 1;
 }
 
+/* Marks a node in the indegree array that was taken from the queue. */
+#define SORTED ((size_t) -1)
+
 /* For the given directed graph, generate a topological sort of the nodes.
  *
- * Sorts the list and deletes all edges.  If there are circles found in the
- * graph or there are edges that have no corresponding nodes the erroneous
- * edges are left.
- *
- * The algorithm is taken from the Wikipedia:
+ * Sorts the array in place and deletes all edges.  If there are circles found
+ * in the graph or there are edges that have no corresponding nodes the
+ * erroneous edges are left.
  *
- * http://en.wikipedia.org/w/index.php?title=Topological_sorting&oldid=153157450#Algorithms
- *
- */
-GList *tsort(GList *nodes, GList **edges)
+ * This is Kahn's algorithm.  The nodes are looked up in a hash table and the
+ * outgoing edges of each node are collected in one array, so it takes time
+ * linear in the number of nodes plus edges.  Nodes without incoming edges are
+ * taken in the order of the nodes array and edges in the order of the edges
+ * array. */
+bool tsort(void **nodes, size_t nr_nodes, struct edge *edges, size_t *nr_edges)
 {
-  /* Retrieve all zeros. */
-  GList *zeros = get_zeros(nodes, *edges);
+  size_t nr_all_edges = *nr_edges;
+  size_t table_size = 2;
+  struct node_table table;
+  void **sorted;
+  size_t *indegree;
+  size_t *first_out;
+  size_t *out;
+  size_t *queue;
+  size_t first_queued = 0;
+  size_t nr_queued = 0;
+  size_t nr_bad_edges = 0;
+  bool result;
+
+  while (table_size < 2 * nr_nodes)
+    table_size *= 2;
+
+  /* Everything is allocated at once. */
+  sorted = g_malloc0(nr_nodes * sizeof *sorted
+                     + (table_size + 3 * nr_nodes + 1 + nr_all_edges)
+                       * sizeof (size_t));
+  table.slots = (size_t *) (sorted + nr_nodes);
+  table.mask = table_size - 1;
+  indegree = table.slots + table_size;
+  first_out = indegree + nr_nodes;
+  queue = first_out + nr_nodes + 1;
+  out = queue + nr_nodes;
+
+  for (size_t i = 0; i < nr_nodes; i++)
+    *node_slot(&table, nodes, nodes[i]) = i + 1;
+
+  /* Count the outgoing and incoming edges of each node.  Edges with a
+   * missing node are never deleted. */
+  for (size_t i = 0; i < nr_all_edges; i++) {
+    size_t p = node_index(&table, nodes, nr_nodes, edges[i].predecessor);
+    size_t s = node_index(&table, nodes, nr_nodes, edges[i].successor);
+
+    if (p == nr_nodes || s == nr_nodes) {
+      nr_bad_edges++;
+      continue;
+    }
+
+    first_out[p + 1]++;
+    indegree[s]++;
+  }
 
-  GList *sorted_nodes = NULL;
+  for (size_t i = 0; i < nr_nodes; i++)
+    first_out[i + 1] += first_out[i];
 
-  /* While the list of zeros is not empty ... */
-  while (zeros != NULL) {
-    /* ... take the first zero and remove it and ...*/
-    void *zero = zeros->data;
-    zeros = g_list_delete_link(zeros, zeros);
+  /* Fill in the outgoing edges.  queue is used as the insert position of each
+   * node until the sort starts. */
+  memcpy(queue, first_out, nr_nodes * sizeof *queue);
 
-    /* ... add it to the list of sorted nodes. */
-    sorted_nodes = g_list_append(sorted_nodes, zero);
+  for (size_t i = 0; i < nr_all_edges; i++) {
+    size_t p = node_index(&table, nodes, nr_nodes, edges[i].predecessor);
+    size_t s = node_index(&table, nodes, nr_nodes, edges[i].successor);
 
-    /* Then look at each edge ... */
-    for (GList *edge_item = *edges;
-         edge_item != NULL;) {
-      struct edge *e = edge_item->data;
+    if (p != nr_nodes && s != nr_nodes)
+      out[queue[p]++] = s;
+  }
+
+  /* Retrieve all zeros. */
+  for (size_t i = 0; i < nr_nodes; i++)
+    if (indegree[i] == 0)
+      queue[nr_queued++] = i;
+
+  /* While the queue of zeros is not empty ... */
+  while (first_queued < nr_queued) {
+    /* ... take the next zero ... */
+    size_t zero = queue[first_queued++];
+
+    indegree[zero] = SORTED;
+
+    /* ... and delete each of its outgoing edges.  If the successor has become
+     * a zero now add it to the queue. */
+    for (size_t i = first_out[zero]; i < first_out[zero + 1]; i++)
+      if (--indegree[out[i]] == 0)
+        queue[nr_queued++] = out[i];
+  }
 
-      GList *tmp = g_list_next(edge_item);
+  /* If all edges were deleted the algorithm was successful. */
+  result = (nr_bad_edges == 0 && nr_queued == nr_nodes);
 
-      /* ... that has this zero as its predecessor ... */
-      if (e->predecessor == zero) {
-        /* ... and remove it. */
-        *edges = g_list_delete_link(*edges, edge_item);
+  if (result) {
+    for (size_t i = 0; i < nr_nodes; i++)
+      sorted[i] = nodes[queue[i]];
 
-        /* If the successor has become a zero now ... */
-        if (is_zero(e->successor, *edges))
-          /* ... add it to the list of zeros. */
-          zeros = g_list_append(zeros, e->successor);
+    memcpy(nodes, sorted, nr_nodes * sizeof *nodes);
+    *nr_edges = 0;
+  } else {
+    /* Move the edges that were not deleted to the beginning. */
+    *nr_edges = 0;
 
-        g_free(e);
-      }
+    for (size_t i = 0; i < nr_all_edges; i++) {
+      size_t p = node_index(&table, nodes, nr_nodes, edges[i].predecessor);
+      size_t s = node_index(&table, nodes, nr_nodes, edges[i].successor);
 
-      edge_item = tmp;
+      if (p == nr_nodes || s == nr_nodes || indegree[p] != SORTED)
+        edges[(*nr_edges)++] = edges[i];
     }
   }
 
-  /* If all edges were deleted the algorithm was successful. */
-  if (*edges != NULL) {
-    g_list_free(sorted_nodes);
-    sorted_nodes = NULL;
-  }
-
-  g_list_free(zeros);
+  g_free(sorted);
 
-  return sorted_nodes;
-  ;
+  return result;
 }
-
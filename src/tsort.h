@@ -12,7 +12,7 @@
  */
 
 #include <stdbool.h>
-#include <glib.h>
+#include <stddef.h>
 
 /* An edge of the graph, specifying that predecessor must come before
  * successor. */
@@ -22,20 +22,11 @@ struct edge
   void *successor;
 };
 
-static inline struct edge *make_edge(void *p, void *s)
-{
-  struct edge *e = g_malloc(sizeof *e);
-
-  e->predecessor = p;
-  e->successor = s;
-
-  return e;
-}
-
 /* For the given directed graph, generate a topological sort of the nodes.
  *
- * Sorts the list and deletes all edges.  If there are circles found in the
- * graph or there are edges that have no corresponding nodes NULL is returned
- * and the erroneous edges are left. */
-/* XXX: sort the list in place and return a boolean for success */
-GList *tsort(GList *nodes, GList **edges);
+ * Sorts the array of nodes in place and deletes all edges, i.e. *nr_edges is
+ * set to zero.  If there are circles found in the graph or there are edges
+ * that have no corresponding nodes false is returned, the nodes are left
+ * untouched and the erroneous edges are moved to the beginning of the edges
+ * array. */
+bool tsort(void **nodes, size_t nr_nodes, struct edge *edges, size_t *nr_edges);
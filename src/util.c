@@ -51,31 +51,29 @@ struct timespec *parse_seconds(const char *s)
   }
 }
 
-static GList *atexit_functions;
+typedef void (*atexit_function)(void);
 
-typedef union
-{
-  void *as_pointer;
-  void (*as_function)(void);
-} function_pointer;
+/* Functions registered with vlock_atexit() in the order of registration. */
+static atexit_function *atexit_functions;
+static size_t nr_atexit_functions;
 
 void vlock_invoke_atexit(void)
 {
-  while (atexit_functions != NULL) {
-    function_pointer p = { .as_pointer = atexit_functions->data };
-    p.as_function();
-    atexit_functions = g_list_delete_link(atexit_functions,
-                                          atexit_functions);
-  }
+  /* Call the functions in reverse order.  A function may register another
+   * function which is then called next. */
+  while (nr_atexit_functions > 0)
+    atexit_functions[--nr_atexit_functions]();
+
+  g_free(atexit_functions);
+  atexit_functions = NULL;
 }
 
-void vlock_atexit(void (*function)(void))
+void vlock_atexit(atexit_function function)
 {
   if (atexit_functions == NULL)
     atexit(vlock_invoke_atexit);
 
-  function_pointer p = { .as_function = function };
-
-  atexit_functions = g_list_prepend(atexit_functions, p.as_pointer);
+  atexit_functions = g_renew(atexit_function, atexit_functions,
+                             nr_atexit_functions + 1);
+  atexit_functions[nr_atexit_functions++] = function;
 }
-
@@ -0,0 +1,466 @@
+/* vlock-idle.c -- idle lock agent for vlock,
+ *                 the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* vlock-idle runs vlock when no input arrived on the watched input devices
+ * for a given time.  It sleeps in epoll_wait() on the devices and two timers:
+ *
+ * - The idle timer expires at the time of the last input plus the timeout.
+ *   When it expires vlock is run and waited for.
+ *
+ * - After input arrived the devices are not watched for a short while (the
+ *   granularity) so that typing or moving the mouse does not wake vlock-idle
+ *   for every event.  When the rearm timer expires the devices are watched
+ *   again.  Input that arrived in between is seen at once and moves the idle
+ *   deadline again.  So the lock happens at most one granularity late.  The
+ *   granularity is at most half the timeout, and when the idle timer expires
+ *   the devices are read once more before vlock is run, in case the rearm
+ *   timer expired at the same time.
+ *
+ * While the user is idle nothing wakes vlock-idle until the idle deadline and
+ * while the user is active it wakes once per granularity.
+ *
+ * The lock profile is a file in the format of ~/.vlockrc (see rcfile.h).  All
+ * variables assigned there are put into the environment of vlock, so they
+ * choose the plugins (VLOCK_PLUGINS), messages and timeouts of the lock the
+ * same way as for an interactive vlock.  The variables VLOCK_IDLE_TIMEOUT and
+ * VLOCK_IDLE_DEVICES configure vlock-idle itself. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <glob.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "rcfile.h"
+
+#ifndef VLOCK
+#define VLOCK "/usr/local/bin/vlock"
+#endif
+
+#ifndef VLOCK_VERSION
+#define VLOCK_VERSION "unknown"
+#endif
+
+/* Input devices that are watched if none are given. */
+#define DEFAULT_DEVICES "/dev/input/event*"
+
+/* Longest timeout in seconds, so that it fits into a 32 bit long in
+ * milliseconds. */
+#define MAX_TIMEOUT_S 2000000
+
+/* Longest time input is not watched after input arrived. */
+#define MAX_GRANULARITY_MS 1000
+
+/* Input is read in chunks of this size and thrown away. */
+#define DRAIN_BUFFER_SIZE 4096
+
+struct device
+{
+  const char *path;
+  int fd;
+  /* Is the device watched, i.e. armed in the epoll set? */
+  bool armed;
+};
+
+static struct device *devices;
+static size_t nr_devices;
+
+static int epoll_fd;
+static int idle_timer;
+static int rearm_timer;
+
+/* Epoll data of the timers.  Devices use their index. */
+#define IDLE_TIMER_DATA ((uint64_t) -1)
+#define REARM_TIMER_DATA ((uint64_t) -2)
+
+static void fatal_memory_error(void)
+{
+  perror("vlock-idle: could not allocate memory");
+  exit(EXIT_FAILURE);
+}
+
+static void fatal_error(const char *what, const char *name)
+{
+  fprintf(stderr, "vlock-idle: %s %s: %s\n", what, name, strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+static const char *lookup_profile_variable(const char *name,
+                                           void __attribute__((unused)) *data)
+{
+  return getenv(name);
+}
+
+static bool assign_profile_variable(const char *name,
+                                    const char *value,
+                                    bool __attribute__((unused)) exported,
+                                    void __attribute__((unused)) *data)
+{
+  if (value != NULL && setenv(name, value, 1) < 0)
+    fatal_memory_error();
+
+  return true;
+}
+
+/* Put the variables of the profile into the environment. */
+static void read_profile(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  bool result;
+
+  if (f == NULL)
+    fatal_error("could not open", path);
+
+  result = parse_rcfile(f, path, lookup_profile_variable,
+                        assign_profile_variable, NULL);
+
+  (void) fclose(f);
+
+  if (!result)
+    exit(EXIT_FAILURE);
+}
+
+static void add_device(const char *path)
+{
+  devices = realloc(devices, (nr_devices + 1) * sizeof *devices);
+
+  if (devices == NULL || (path = strdup(path)) == NULL)
+    fatal_memory_error();
+
+  devices[nr_devices++] = (struct device) { path, -1, false };
+}
+
+/* Add the devices matching the white space separated patterns. */
+static void add_devices(const char *patterns)
+{
+  char *copy = strdup(patterns);
+
+  if (copy == NULL)
+    fatal_memory_error();
+
+  for (char *p = strtok(copy, " \t\n"); p != NULL; p = strtok(NULL, " \t\n")) {
+    glob_t g;
+
+    if (glob(p, 0, NULL, &g) == 0) {
+      for (size_t i = 0; i < g.gl_pathc; i++)
+        add_device(g.gl_pathv[i]);
+
+      globfree(&g);
+    }
+  }
+
+  free(copy);
+}
+
+static void open_device(struct device *device, size_t index)
+{
+  struct epoll_event event = {
+    .events = EPOLLIN | EPOLLONESHOT,
+    .data.u64 = index,
+  };
+  struct stat st;
+
+  device->fd = open(device->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+  /* A FIFO stand-in is opened for writing, too, so that it never reports
+   * end-of-file when a writer goes away. */
+  if (device->fd >= 0 && fstat(device->fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+    (void) close(device->fd);
+    device->fd = open(device->path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  }
+
+  if (device->fd < 0)
+    fatal_error("could not open", device->path);
+
+  /* Regular files cannot be watched. */
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device->fd, &event) < 0)
+    fatal_error("could not watch", device->path);
+
+  device->armed = true;
+}
+
+static void arm_device(struct device *device, size_t index)
+{
+  struct epoll_event event = {
+    .events = EPOLLIN | EPOLLONESHOT,
+    .data.u64 = index,
+  };
+
+  if (!device->armed && device->fd >= 0
+      && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, device->fd, &event) == 0)
+    device->armed = true;
+}
+
+/* Throw away the pending input of the device.  Returns true if there was
+ * any. */
+static bool drain_device(struct device *device)
+{
+  char buffer[DRAIN_BUFFER_SIZE];
+  bool input = false;
+
+  while (read(device->fd, buffer, sizeof buffer) > 0)
+    input = true;
+
+  return input;
+}
+
+static struct timespec add_ms(struct timespec t, long ms)
+{
+  t.tv_sec += ms / 1000;
+  t.tv_nsec += (ms % 1000) * 1000000L;
+
+  if (t.tv_nsec >= 1000000000L) {
+    t.tv_sec++;
+    t.tv_nsec -= 1000000000L;
+  }
+
+  return t;
+}
+
+/* Set the timer to expire at the given time or never if it is NULL. */
+static void set_timer(int timer, const struct timespec *deadline)
+{
+  struct itimerspec value = {
+    .it_interval = { 0, 0 },
+    .it_value = { 0, 0 },
+  };
+
+  if (deadline != NULL)
+    value.it_value = *deadline;
+
+  (void) timerfd_settime(timer, TFD_TIMER_ABSTIME, &value, NULL);
+}
+
+static int create_timer(uint64_t data)
+{
+  struct epoll_event event = { .events = EPOLLIN, .data.u64 = data };
+  int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  if (timer < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer, &event) < 0)
+    fatal_error("could not create", "timer");
+
+  return timer;
+}
+
+static void clear_timer(int timer)
+{
+  uint64_t expirations;
+
+  (void) read(timer, &expirations, sizeof expirations);
+}
+
+/* Run vlock with the given arguments and wait for it. */
+static void run_vlock(char *const argv[])
+{
+  pid_t pid = fork();
+  int status;
+
+  if (pid == 0) {
+    execv(VLOCK, argv);
+    fprintf(stderr, "vlock-idle: could not execute %s: %s\n", VLOCK,
+            strerror(errno));
+    _exit(EXIT_FAILURE);
+  } else if (pid < 0) {
+    perror("vlock-idle: could not fork");
+    return;
+  }
+
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+static void print_help(void)
+{
+  fputs("vlock-idle: locks the console when the user is idle.\n"
+        "Usage: vlock-idle [options] [-- vlock options and plugins...]\n"
+        "       Where [options] are any of:\n"
+        "-t <seconds>: lock after the given time without input.\n"
+        "-p <file>: read the lock profile from the given file.\n"
+        "-d <device>: watch the given input device instead of\n"
+        "       " DEFAULT_DEVICES ", may be given more than once.\n"
+        "-v: Print the version number of vlock and exit.\n"
+        "-h: Print this help message and exit.\n",
+        stderr);
+}
+
+/* Parse a timeout in seconds, fractions allowed.  Returns the timeout in
+ * milliseconds or 0 if it is not valid or out of range. */
+static long parse_timeout(const char *string)
+{
+  char *end;
+  double seconds = strtod(string, &end);
+
+  if (end == string || *end != '\0' || !isfinite(seconds)
+      || seconds <= 0 || seconds > MAX_TIMEOUT_S)
+    return 0;
+
+  return (long) (seconds * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *timeout_string = NULL;
+  long timeout_ms;
+  long granularity_ms;
+  char **vlock_argv;
+  struct timespec last_input;
+  int c;
+
+  while ((c = getopt(argc, argv, "t:p:d:vh")) != -1) {
+    switch (c) {
+      case 't':
+        timeout_string = optarg;
+        break;
+      case 'p':
+        read_profile(optarg);
+        break;
+      case 'd':
+        add_device(optarg);
+        break;
+      case 'v':
+        fputs("vlock-idle version " VLOCK_VERSION "\n", stderr);
+        exit(EXIT_SUCCESS);
+      case 'h':
+        print_help();
+        exit(EXIT_SUCCESS);
+      default:
+        print_help();
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (timeout_string == NULL)
+    timeout_string = getenv("VLOCK_IDLE_TIMEOUT");
+
+  if (timeout_string == NULL
+      || (timeout_ms = parse_timeout(timeout_string)) <= 0) {
+    fputs("vlock-idle: no valid timeout given\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+
+  /* The devices must be watched again well before the idle deadline. */
+  granularity_ms = timeout_ms / 2 < MAX_GRANULARITY_MS ?
+                   timeout_ms / 2 : MAX_GRANULARITY_MS;
+
+  if (nr_devices == 0)
+    add_devices(getenv("VLOCK_IDLE_DEVICES") != NULL ?
+                getenv("VLOCK_IDLE_DEVICES") : DEFAULT_DEVICES);
+
+  if (nr_devices == 0) {
+    fputs("vlock-idle: no input devices found\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+
+  /* vlock gets the remaining arguments. */
+  vlock_argv = argv + optind - 1;
+  vlock_argv[0] = VLOCK;
+
+  if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    fatal_error("could not create", "epoll instance");
+
+  for (size_t i = 0; i < nr_devices; i++)
+    open_device(&devices[i], i);
+
+  idle_timer = create_timer(IDLE_TIMER_DATA);
+  rearm_timer = create_timer(REARM_TIMER_DATA);
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &last_input);
+
+  for (;;) {
+    struct epoll_event events[16];
+    struct timespec deadline = add_ms(last_input, timeout_ms);
+    bool input = false;
+    bool idle = false;
+    int n;
+
+    set_timer(idle_timer, &deadline);
+
+    n = epoll_wait(epoll_fd, events, sizeof events / sizeof events[0], -1);
+
+    if (n < 0 && errno != EINTR)
+      fatal_error("could not wait for", "input");
+
+    for (int i = 0; i < n; i++) {
+      uint64_t data = events[i].data.u64;
+
+      if (data == IDLE_TIMER_DATA) {
+        clear_timer(idle_timer);
+        idle = true;
+      } else if (data == REARM_TIMER_DATA) {
+        clear_timer(rearm_timer);
+
+        /* Pending input shows up in the next epoll_wait(). */
+        for (size_t j = 0; j < nr_devices; j++)
+          arm_device(&devices[j], j);
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        /* The device went away.  It must not look like input forever. */
+        fprintf(stderr, "vlock-idle: lost %s\n", devices[data].path);
+        (void) close(devices[data].fd);
+        devices[data].fd = -1;
+        devices[data].armed = false;
+      } else {
+        /* The device was disarmed by EPOLLONESHOT. */
+        devices[data].armed = false;
+        (void) drain_device(&devices[data]);
+        input = true;
+      }
+    }
+
+    /* Input that arrived while the devices were not watched has not moved
+     * the idle deadline yet. */
+    if (idle && !input)
+      for (size_t j = 0; j < nr_devices; j++)
+        if (devices[j].fd >= 0 && drain_device(&devices[j]))
+          input = true;
+
+    if (input) {
+      struct timespec rearm;
+
+      (void) clock_gettime(CLOCK_MONOTONIC, &last_input);
+
+      /* Stop watching every device until the rearm timer expires. */
+      for (size_t j = 0; j < nr_devices; j++)
+        if (devices[j].armed
+            && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, devices[j].fd,
+                         &(struct epoll_event) { .events = 0,
+                                                 .data.u64 = j }) == 0)
+          devices[j].armed = false;
+
+      rearm = add_ms(last_input, granularity_ms);
+      set_timer(rearm_timer, &rearm);
+    } else if (idle) {
+      run_vlock(vlock_argv);
+
+      /* Input typed into vlock does not count. */
+      for (size_t j = 0; j < nr_devices; j++)
+        if (devices[j].fd >= 0)
+          (void) drain_device(&devices[j]);
+
+      (void) clock_gettime(CLOCK_MONOTONIC, &last_input);
+    }
+  }
+}
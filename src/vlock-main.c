@@ -20,6 +20,11 @@
 
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
 #include <errno.h>
 #include <time.h>
 
@@ -34,6 +39,10 @@
 #include "terminal.h"
 #include "util.h"
 #include "logging.h"
+#include "status.h"
+#include "counters.h"
+#include "output.h"
+#include "memory.h"
 
 #ifdef USE_PLUGINS
 #include "plugins.h"
@@ -52,6 +61,89 @@ static const char *auth_failure_blurb =
 
 static int auth_tries;
 
+/* When vlock-main started and the microseconds it took to secure the terminal
+ * or -1. */
+static struct timespec start_time;
+static long secure_latency = -1;
+
+/* Resident set size before and after the startup memory was released. */
+static unsigned long startup_rss_kb;
+static unsigned long locked_rss_kb;
+
+/* Give back what was only needed to engage the lock. */
+static void release_startup_memory(void)
+{
+  startup_rss_kb = memory_get_rss_kb();
+
+#ifdef USE_PLUGINS
+  release_plugin_dependencies();
+#endif
+
+  memory_release();
+
+  locked_rss_kb = memory_get_rss_kb();
+}
+
+#ifdef USE_PLUGINS
+/* Plugins may draw on the screen while it is saved. */
+static bool have_plugins;
+
+/* Stop the screen saver after a key was pressed.  The plugins that use the
+ * display are woken up first and the message is shown right after them.  The
+ * time this took is logged before the other plugins are woken up. */
+static void wake_up(const char *message)
+{
+  struct timespec start;
+  struct timespec end;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+  plugin_wake_display();
+
+  if (have_plugins)
+    output_invalidate();
+
+  if (message && *message) {
+    output_add(message);
+    output_add("\n");
+    (void) output_flush();
+  }
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &end);
+  vlock_log_event(VLOCK_EVENT_WAKE, NULL, NULL,
+                  (end.tv_sec - start.tv_sec) * 1000000
+                  + (end.tv_nsec - start.tv_nsec) / 1000);
+
+  plugin_wake_finish();
+}
+#endif
+
+/* How much the nice value of vlock-main is lowered while the password prompt
+ * is shown.  This needs privileges, without them it stays the same. */
+#define PROMPT_PRIORITY_BOOST 5
+
+/* Raise the priority of vlock-main and return the previous nice value. */
+static int raise_priority(void)
+{
+  int priority;
+
+  errno = 0;
+  priority = getpriority(PRIO_PROCESS, 0);
+
+  if (priority == -1 && errno != 0)
+    priority = 0;
+  else
+    (void) setpriority(PRIO_PROCESS, 0, priority - PROMPT_PRIORITY_BOOST);
+
+  return priority;
+}
+
+/* Go back to the given nice value.  This is always allowed. */
+static void restore_priority(int priority)
+{
+  (void) setpriority(PRIO_PROCESS, 0, priority);
+}
+
 static void auth_loop(const char *username)
 {
   GError *err = NULL;
@@ -60,6 +152,8 @@ static void auth_loop(const char *username)
   char *vlock_message;
   char *vlock_password_prompt_message;
   const char *auth_names[] = { username, "root", NULL };
+  bool woken = false;
+  int priority;
 
   /* If NO_ROOT_PASS is defined or the username is "root" ... */
 #ifndef NO_ROOT_PASS
@@ -87,34 +181,81 @@ static void auth_loop(const char *username)
   wait_timeout = NULL;
 #endif
 
+#ifdef USE_PLUGINS
+  /* The terminal is secure now.  Show the lock message before starting the
+   * plugins that are not critical for the lock. */
+  if (vlock_message && *vlock_message) {
+    output_add(vlock_message);
+    output_add("\n");
+  }
+
+  (void) output_flush();
+  plugin_start_best_effort();
+  woken = true;
+#endif
+
+  release_startup_memory();
+
   for (;;) {
     char c;
 
-    /* Print vlock message if there is one. */
-    if (vlock_message && *vlock_message) {
-      fputs(vlock_message, stderr);
-      fputc('\n', stderr);
+    counters_set_phase(VLOCK_PHASE_LOCKED_IDLE);
+
+    /* Print vlock message if there is one and it was not just printed
+     * while starting or waking up. */
+    if (!woken && vlock_message && *vlock_message) {
+      output_add(vlock_message);
+      output_add("\n");
     }
 
+    woken = false;
+
     /* Wait for enter or escape to be pressed. */
     c = wait_for_character("\n\033", wait_timeout, NULL);
 
     /* Escape was pressed or the timeout occurred. */
     if (c == '\033' || c == 0) {
 #ifdef USE_PLUGINS
-      plugin_hook("vlock_save");
-      /* Wait for any key to be pressed. */
-      c = wait_for_character(NULL, NULL, NULL);
-      plugin_hook("vlock_save_abort");
+      unsigned int hold_off = plugin_save_hold_off();
+      struct timespec hold_off_timeout = {
+        .tv_sec = hold_off / 1000,
+        .tv_nsec = (hold_off % 1000) * 1000000L,
+      };
+
+      counters_set_phase(VLOCK_PHASE_SAVE);
+
+      /* Cancel the save before it starts if another key is already waiting,
+       * e.g. the rest of an escape sequence, or is pressed while the plugins
+       * are held back after short saves. */
+      c = wait_for_character(NULL, &hold_off_timeout, NULL);
+
+      if (c != 0) {
+        counters_add(VLOCK_COUNTER_SUPPRESSED_SAVES, 1);
+      } else {
+        status_set_save_stage(VLOCK_STATUS_SAVE_ACTIVE);
+        plugin_hook("vlock_save");
+        /* Wait for any key to be pressed. */
+        c = wait_for_character(NULL, NULL, NULL);
+        /* The message is not needed if the prompt follows at once. */
+        wake_up(c != '\n' ? vlock_message : NULL);
+        status_set_save_stage(VLOCK_STATUS_SAVE_NONE);
+      }
 
       /* Do not require enter to be pressed twice. */
-      if (c != '\n')
+      if (c != '\n') {
+        woken = true;
         continue;
+      }
 #else
       continue;
 #endif
     }
 
+    counters_set_phase(VLOCK_PHASE_AUTH);
+
+    /* Keystrokes at the prompt should not wait for plugin processes. */
+    priority = raise_priority();
+
     for (size_t i = 0; auth_names[i] != NULL; i++) {
       if (auth(auth_names[i], prompt_timeout, vlock_password_prompt_message, &err))
         goto auth_success;
@@ -123,27 +264,38 @@ static void auth_loop(const char *username)
 
       if (g_error_matches(err,
                           VLOCK_PROMPT_ERROR,
-                          VLOCK_PROMPT_ERROR_TIMEOUT))
-        fprintf(stderr, "Timeout!\n");
-      else {
-        fprintf(stderr, "vlock: %s\n", err->message);
+                          VLOCK_PROMPT_ERROR_TIMEOUT)) {
+        vlock_log_event(VLOCK_EVENT_AUTH_TIMEOUT, auth_names[i], NULL, 0);
+        output_add("Timeout!\n");
+      } else {
+        vlock_log_event(VLOCK_EVENT_AUTH_FAILURE, auth_names[i], NULL,
+                        auth_tries + 1);
+        output_printf("vlock: %s\n", err->message);
 
         if (g_error_matches(err,
                             VLOCK_AUTH_ERROR,
                             VLOCK_AUTH_ERROR_FAILED)) {
-          fputs(auth_failure_blurb, stderr);
+          output_add(auth_failure_blurb);
+          (void) output_flush();
           sleep(3);
         }
       }
 
       g_clear_error(&err);
+      (void) output_flush();
       sleep(1);
     }
 
+    restore_priority(priority);
+
     auth_tries++;
+    status_set_failed_attempts(auth_tries);
   }
 
 auth_success:
+  restore_priority(priority);
+  vlock_log_event(VLOCK_EVENT_UNLOCK, username, NULL, auth_tries);
+
   /* Free timeouts memory. */
   free(wait_timeout);
   free(prompt_timeout);
@@ -152,10 +304,43 @@ auth_success:
 void display_auth_tries(void)
 {
   if (auth_tries > 0)
-    fprintf(stderr,
-            "%d failed authentication %s.\n",
-            auth_tries,
-            auth_tries > 1 ? "tries" : "try");
+    output_printf("%d failed authentication %s.\n",
+                  auth_tries,
+                  auth_tries > 1 ? "tries" : "try");
+}
+
+static void flush_output(void)
+{
+  (void) output_flush();
+}
+
+/* Everything that runs on exit belongs to the teardown phase.  This must be
+ * registered last so that it runs first. */
+static void enter_teardown(void)
+{
+  counters_set_phase(VLOCK_PHASE_TEARDOWN);
+}
+
+static void detach_counters(void)
+{
+  counters_attach(NULL);
+}
+
+static void print_counters(void)
+{
+  const char *vlock_debug = g_getenv("VLOCK_DEBUG");
+
+  if (vlock_debug == NULL || *vlock_debug == '\0')
+    return;
+
+  counters_print(stderr);
+
+  if (secure_latency >= 0)
+    fprintf(stderr, "vlock: time-to-secure-us=%ld\n", secure_latency);
+
+  if (locked_rss_kb > 0)
+    fprintf(stderr, "vlock: rss-kb startup=%lu locked=%lu\n",
+            startup_rss_kb, locked_rss_kb);
 }
 
 #ifdef USE_PLUGINS
@@ -164,22 +349,96 @@ static void call_end_hook(void)
   (void) plugin_hook("vlock_end");
 }
 
+static void print_usage(void)
+{
+  const char *vlock_debug = g_getenv("VLOCK_DEBUG");
+
+  if (vlock_debug != NULL && *vlock_debug != '\0')
+    print_plugin_usage(stderr);
+}
+
+#endif
+
+/* Get the number of the virtual console on stdin or -1. */
+static int get_locked_vt(void)
+{
+#ifdef __linux__
+  struct stat st;
+
+  /* Virtual consoles are character devices with major number 4 and minor
+   * numbers 1 to 63. */
+  if (fstat(STDIN_FILENO, &st) == 0 && S_ISCHR(st.st_mode)
+      && major(st.st_rdev) == 4 && minor(st.st_rdev) >= 1
+      && minor(st.st_rdev) <= 63)
+    return minor(st.st_rdev);
+#endif
+
+  return -1;
+}
+
+/* Publish the lock mode and the locked console on the status page and in the
+ * event log. */
+static void update_lock_status(const char *username)
+{
+  uint32_t mode = 0;
+  int vt = get_locked_vt();
+
+  if (console_switch_locked)
+    mode |= VLOCK_STATUS_MODE_ALL;
+
+#ifdef USE_PLUGINS
+  if (is_plugin_loaded("new"))
+    mode |= VLOCK_STATUS_MODE_NEW;
 #endif
 
+  status_set_mode(mode);
+  status_set_vt(vt);
+  status_set_state(VLOCK_STATUS_LOCKED);
+
+  vlock_log_event(VLOCK_EVENT_LOCK, username, NULL, vt);
+}
+
 /* Lock the current terminal until proper authentication is received. */
 int main(int argc, char *const argv[])
 {
   const char *username = NULL;
 
+  (void) clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+#ifndef NO_GLIB
   /* Initialize GLib. */
   g_set_prgname(argv[0]);
   g_type_init();
+#endif
 
   /* Initialize logging. */
   vlock_initialize_logging();
 
+  /* Print the counters after everything else is done. */
+  vlock_atexit(print_counters);
+
+  /* Start the event log.  A log file from the environment is ignored if
+   * vlock-main runs with elevated privileges. */
+  const char *event_log = getenv("VLOCK_EVENT_LOG");
+
+  if (event_log != NULL
+      && (*event_log == '\0' || getuid() != geteuid() || getgid() != getegid()))
+    event_log = NULL;
+
+  /* The exit functions may run in the handler of a fatal signal. */
+  if (vlock_event_log_open(event_log))
+    vlock_atexit(vlock_event_log_stop);
+
   install_signal_handlers();
 
+  /* Publish the status.  Failure is not fatal, e.g. if vlock-main is not
+   * installed setuid root the status directory is not writable. */
+  if (*VLOCK_STATUS_DIR != '\0' && status_open(VLOCK_STATUS_DIR)) {
+    vlock_atexit(status_close);
+    counters_attach(status_get_counters());
+    vlock_atexit(detach_counters);
+  }
+
   /* Get the user name from the environment if started as root. */
   if (getuid() == 0)
     username = g_getenv("USER");
@@ -187,6 +446,8 @@ int main(int argc, char *const argv[])
   if (username == NULL)
     username = g_get_user_name();
 
+  /* Everything printed on exit is written at the very end. */
+  vlock_atexit(flush_output);
   vlock_atexit(display_auth_tries);
 
 #ifdef USE_PLUGINS
@@ -212,6 +473,8 @@ int main(int argc, char *const argv[])
   }
 
   vlock_atexit(unload_plugins);
+  /* Runs after the end hooks and before the plugins are unloaded. */
+  vlock_atexit(print_usage);
 
   if (!resolve_dependencies(&tmp_error)) {
     g_assert(tmp_error != NULL);
@@ -222,6 +485,18 @@ int main(int argc, char *const argv[])
     exit(EXIT_FAILURE);
   }
 
+  have_plugins = argc > 1;
+
+  /* Hook calls that a busy plugin could not take at once are passed on while
+   * waiting for keys. */
+  prompt_set_output_watch(plugin_get_output_fds, plugin_flush_output);
+
+  char *plugin_names = get_plugin_names();
+  status_set_plugins(plugin_names);
+  g_free(plugin_names);
+
+  /* Only the plugins that are critical for the lock are started here, the
+   * others once the lock message is shown, see auth_loop(). */
   plugin_hook("vlock_start");
   vlock_atexit(call_end_hook);
 #else /* !USE_PLUGINS */
@@ -253,6 +528,17 @@ int main(int argc, char *const argv[])
   secure_terminal();
   vlock_atexit(restore_terminal);
 
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+  secure_latency = (now.tv_sec - start_time.tv_sec) * 1000000
+                   + (now.tv_nsec - start_time.tv_nsec) / 1000;
+  vlock_log_event(VLOCK_EVENT_SECURE, NULL, NULL, secure_latency);
+
+  update_lock_status(username);
+
+  vlock_atexit(enter_teardown);
+
   auth_loop(username);
 
   exit(EXIT_SUCCESS);
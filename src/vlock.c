@@ -0,0 +1,416 @@
+/* vlock.c -- start program for vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* This is a compiled replacement for vlock.sh.  It understands the same
+ * options and environment variables and reads ~/.vlockrc, but only accepts
+ * variable assignments there (see rcfile.h).  Afterwards vlock-main is executed
+ * directly. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "rcfile.h"
+
+#ifndef VLOCK_MAIN
+#define VLOCK_MAIN "/usr/local/sbin/vlock-main"
+#endif
+
+#ifndef VLOCK_VERSION
+#define VLOCK_VERSION "unknown"
+#endif
+
+/* Magic characters to clear the terminal. */
+#define CLEAR_SCREEN "\033[H\033[J"
+
+/* Enter message that is common to different the messages. */
+#define VLOCK_ENTER_PROMPT "Please press [ENTER] to unlock."
+
+/* Message that is displayed when console switching is disabled. */
+#define VLOCK_ALL_MESSAGE \
+  CLEAR_SCREEN \
+  "The entire console display is now completely locked.\n" \
+  "You will not be able to switch to another virtual console.\n" \
+  "\n" \
+  VLOCK_ENTER_PROMPT
+
+/* Message that is displayed when only the current terminal is locked. */
+#define VLOCK_CURRENT_MESSAGE \
+  CLEAR_SCREEN \
+  "This TTY is now locked.\n" \
+  "\n" \
+  VLOCK_ENTER_PROMPT
+
+/* Variables that are passed to vlock-main if they are set. */
+static const char *exported_variables[] = {
+  "VLOCK_TIMEOUT",
+  "VLOCK_PROMPT_TIMEOUT",
+  "VLOCK_MESSAGE",
+  "VLOCK_ALL_MESSAGE",
+  "VLOCK_CURRENT_MESSAGE",
+  "VLOCK_PASSWORD_PROMPT_MESSAGE",
+  "VLOCK_EVENT_LOG",
+  "VLOCK_CGROUP",
+  "VLOCK_PLUGIN_CPU_LIMIT",
+  "VLOCK_PLUGIN_CPU_QUOTA",
+  "VLOCK_PLUGIN_MEMORY_LIMIT",
+  "VLOCK_PLUGIN_PROCESS_LIMIT",
+  NULL
+};
+
+/* Variables that were set by this program or the configuration file.  They
+ * shadow the environment just like shell variables do. */
+struct variable
+{
+  char *name;
+  char *value;
+  bool exported;
+  struct variable *next;
+};
+
+static struct variable *variables;
+
+static struct variable *find_variable(const char *name)
+{
+  for (struct variable *v = variables; v != NULL; v = v->next)
+    if (strcmp(v->name, name) == 0)
+      return v;
+
+  return NULL;
+}
+
+static void fatal_memory_error(void)
+{
+  perror("vlock: could not allocate memory");
+  exit(EXIT_FAILURE);
+}
+
+static void set_variable(const char *name, const char *value, bool exported)
+{
+  struct variable *v = find_variable(name);
+
+  if (v == NULL) {
+    if ((v = calloc(1, sizeof *v)) == NULL
+        || (v->name = strdup(name)) == NULL)
+      fatal_memory_error();
+
+    v->next = variables;
+    variables = v;
+  }
+
+  if (value != NULL) {
+    free(v->value);
+
+    if ((v->value = strdup(value)) == NULL)
+      fatal_memory_error();
+  }
+
+  v->exported = v->exported || exported;
+}
+
+/* Get the value of a variable.  Variables set here take precedence over the
+ * environment. */
+static const char *get_variable(const char *name)
+{
+  struct variable *v = find_variable(name);
+
+  if (v != NULL && v->value != NULL)
+    return v->value;
+  else
+    return getenv(name);
+}
+
+static const char *lookup_rcfile_variable(const char *name,
+                                          void __attribute__((unused)) *data)
+{
+  return get_variable(name);
+}
+
+static bool assign_rcfile_variable(const char *name,
+                                   const char *value,
+                                   bool exported,
+                                   void __attribute__((unused)) *data)
+{
+  if (value == NULL && get_variable(name) == NULL)
+    /* "export NAME" of an unset variable does nothing. */
+    return true;
+
+  set_variable(name, value != NULL ? value : get_variable(name), exported);
+  return true;
+}
+
+/* Read ~/.vlockrc if it exists. */
+static void read_vlockrc(void)
+{
+  const char *home = getenv("HOME");
+  char *path;
+  FILE *f;
+  bool result;
+
+  if (home == NULL)
+    return;
+
+  if (asprintf(&path, "%s/.vlockrc", home) < 0)
+    fatal_memory_error();
+
+  if (access(path, R_OK) < 0 || (f = fopen(path, "r")) == NULL) {
+    free(path);
+    return;
+  }
+
+  result = parse_rcfile(f, path, lookup_rcfile_variable,
+                        assign_rcfile_variable, NULL);
+
+  (void) fclose(f);
+  free(path);
+
+  if (!result)
+    exit(EXIT_FAILURE);
+}
+
+static void print_help(void)
+{
+  fputs("vlock: locks virtual consoles, saving your current session.\n",
+        stderr);
+#ifdef USE_PLUGINS
+  fputs("Usage: vlock [options] [plugins...]\n", stderr);
+#else
+  fputs("Usage: vlock [options]\n", stderr);
+#endif
+  fputs("       Where [options] are any of:\n"
+        "-c or --current: lock only this virtual console, allowing user to\n"
+        "       switch to other virtual consoles.\n"
+        "-a or --all: lock all virtual consoles by preventing other users\n"
+        "       from switching virtual consoles.\n",
+        stderr);
+#ifdef USE_PLUGINS
+  fputs("-n or --new: allocate a new virtual console before locking,\n"
+        "       implies --all.\n"
+        "-s or --disable-sysrq: disable SysRq while consoles are locked to\n"
+        "       prevent killing vlock with SAK\n"
+        "-t <seconds> or --timeout <seconds>: run screen saver plugins\n"
+        "       after the given amount of time.\n",
+        stderr);
+#endif
+  fputs("-v or --version: Print the version number of vlock and exit.\n"
+        "-h or --help: Print this help message and exit.\n",
+        stderr);
+}
+
+static void print_version(void)
+{
+#ifdef USE_PLUGINS
+  fputs("vlock version " VLOCK_VERSION "\n", stderr);
+#else
+  fputs("vlock version " VLOCK_VERSION " (no plugin support)\n", stderr);
+#endif
+}
+
+/* A growing argument vector. */
+struct arguments
+{
+  const char **argv;
+  int argc;
+  int size;
+};
+
+static void add_argument(struct arguments *a, const char *argument)
+{
+  if (a->argc + 1 >= a->size) {
+    a->size = a->size ? a->size * 2 : 16;
+
+    if ((a->argv = realloc(a->argv, a->size * sizeof *a->argv)) == NULL)
+      fatal_memory_error();
+  }
+
+  a->argv[a->argc++] = argument;
+  a->argv[a->argc] = NULL;
+}
+
+#ifdef USE_PLUGINS
+/* Append the words of the given space separated list. */
+static void add_arguments(struct arguments *a, const char *list)
+{
+  char *words;
+
+  if (list == NULL)
+    return;
+
+  if ((words = strdup(list)) == NULL)
+    fatal_memory_error();
+
+  for (char *word = strtok(words, " \t\n"); word != NULL;
+       word = strtok(NULL, " \t\n"))
+    add_argument(a, word);
+}
+#endif
+
+static void unknown_option(const char *program_name, const char *option)
+{
+  printf("%s: unknown option '%s'\n", program_name, option);
+  print_help();
+  exit(EXIT_FAILURE);
+}
+
+/* Handle an option that does not take an argument. */
+static void handle_option(const char *program_name,
+                          const char *option,
+                          struct arguments *plugins)
+{
+  if (strcmp(option, "-a") == 0 || strcmp(option, "--all") == 0) {
+    add_argument(plugins, "all");
+  } else if (strcmp(option, "-c") == 0 || strcmp(option, "--current") == 0) {
+    plugins->argc = 0;
+  } else if (strcmp(option, "-n") == 0 || strcmp(option, "--new") == 0) {
+    add_argument(plugins, "new");
+  } else if (strcmp(option, "-s") == 0
+             || strcmp(option, "--disable-sysrq") == 0) {
+    add_argument(plugins, "nosysrq");
+  } else if (strcmp(option, "-h") == 0 || strcmp(option, "--help") == 0) {
+    print_help();
+    exit(EXIT_SUCCESS);
+  } else if (strcmp(option, "-v") == 0 || strcmp(option, "--version") == 0) {
+    print_version();
+    exit(EXIT_SUCCESS);
+  } else {
+    unknown_option(program_name, option);
+  }
+}
+
+static void set_timeout(const char *program_name,
+                        const char *option,
+                        const char *timeout)
+{
+  if (timeout == NULL) {
+    fprintf(stderr, "%s: option '%s' requires an argument\n", program_name,
+            option);
+    exit(EXIT_FAILURE);
+  }
+
+  set_variable("VLOCK_TIMEOUT", timeout, false);
+}
+
+/* Parse the command line.  Option derived plugins are added to plugins and
+ * all other arguments to extra_arguments. */
+static void parse_arguments(int argc, char *argv[],
+                            struct arguments *plugins,
+                            struct arguments *extra_arguments)
+{
+  const char *program_name = argv[0];
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+
+    if (strcmp(arg, "--") == 0) {
+      /* End of option list. */
+      i++;
+      break;
+    } else if (strncmp(arg, "--", 2) == 0) {
+      const char *equals = strchr(arg, '=');
+      size_t length = equals ? (size_t) (equals - arg) : strlen(arg);
+
+      if (length == strlen("--timeout") && strncmp(arg, "--timeout", length) == 0) {
+        set_timeout(program_name, "--timeout",
+                    equals != NULL ? equals + 1 : argv[++i]);
+      } else if (equals != NULL && equals[1] != '\0') {
+        fprintf(stderr, "%s: option '%.*s' does not allow an argument\n",
+                program_name, (int) length, arg);
+        exit(EXIT_FAILURE);
+      } else {
+        handle_option(program_name, arg, plugins);
+      }
+    } else if (arg[0] == '-' && arg[1] != '\0') {
+      /* Clustered short options, e.g. "-ant5". */
+      for (const char *c = arg + 1; *c != '\0'; c++) {
+        if (*c == 't') {
+          set_timeout(program_name, "-t", c[1] != '\0' ? c + 1 : argv[++i]);
+          break;
+        } else {
+          char option[] = { '-', *c, '\0' };
+          handle_option(program_name, option, plugins);
+        }
+      }
+    } else {
+      add_argument(extra_arguments, arg);
+    }
+  }
+
+  for (; i < argc; i++)
+    add_argument(extra_arguments, argv[i]);
+}
+
+/* Do nothing.  Unlike SIG_IGN this is reset by exec(). */
+static void ignore_signal(int __attribute__((unused)) signum)
+{
+}
+
+int main(int argc, char *argv[])
+{
+  struct arguments plugins = { NULL, 0, 0 };
+  struct arguments extra_arguments = { NULL, 0, 0 };
+  struct arguments vlock_main_arguments = { NULL, 0, 0 };
+  struct sigaction sa;
+
+  /* Ignore some signals. */
+  (void) sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  sa.sa_handler = ignore_signal;
+  (void) sigaction(SIGHUP, &sa, NULL);
+  (void) sigaction(SIGINT, &sa, NULL);
+  (void) sigaction(SIGQUIT, &sa, NULL);
+  (void) sigaction(SIGTSTP, &sa, NULL);
+
+  /* Defaults that may be overridden or referenced by the user settings. */
+  set_variable("CLEAR_SCREEN", CLEAR_SCREEN, false);
+  set_variable("VLOCK_ENTER_PROMPT", VLOCK_ENTER_PROMPT, false);
+  set_variable("VLOCK_ALL_MESSAGE", VLOCK_ALL_MESSAGE, false);
+  set_variable("VLOCK_CURRENT_MESSAGE", VLOCK_CURRENT_MESSAGE, false);
+
+  /* Read user settings. */
+  read_vlockrc();
+
+  parse_arguments(argc, argv, &plugins, &extra_arguments);
+
+  /* Export variables for vlock-main. */
+  for (size_t i = 0; exported_variables[i] != NULL; i++)
+    set_variable(exported_variables[i], NULL, true);
+
+  for (struct variable *v = variables; v != NULL; v = v->next)
+    if (v->exported && v->value != NULL && setenv(v->name, v->value, 1) < 0)
+      fatal_memory_error();
+
+  add_argument(&vlock_main_arguments, VLOCK_MAIN);
+
+  for (int i = 0; i < plugins.argc; i++)
+    add_argument(&vlock_main_arguments, plugins.argv[i]);
+
+#ifdef USE_PLUGINS
+  add_arguments(&vlock_main_arguments, get_variable("VLOCK_PLUGINS"));
+
+  for (int i = 0; i < extra_arguments.argc; i++)
+    add_argument(&vlock_main_arguments, extra_arguments.argv[i]);
+#endif
+
+  execv(VLOCK_MAIN, (char *const *) vlock_main_arguments.argv);
+
+  fprintf(stderr, "vlock: could not execute %s: %s\n", VLOCK_MAIN,
+          strerror(errno));
+  exit(EXIT_FAILURE);
+}
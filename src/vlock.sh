@@ -225,6 +225,9 @@ main() {
   export_if_set VLOCK_TIMEOUT VLOCK_PROMPT_TIMEOUT
   export_if_set VLOCK_MESSAGE VLOCK_ALL_MESSAGE VLOCK_CURRENT_MESSAGE
   export_if_set VLOCK_PASSWORD_PROMPT_MESSAGE VLOCK_ALL_MESSAGE VLOCK_CURRENT_MESSAGE
+  export_if_set VLOCK_EVENT_LOG
+  export_if_set VLOCK_CGROUP VLOCK_PLUGIN_CPU_LIMIT VLOCK_PLUGIN_CPU_QUOTA
+  export_if_set VLOCK_PLUGIN_MEMORY_LIMIT VLOCK_PLUGIN_PROCESS_LIMIT
 
   if [ "${VLOCK_ENABLE_PLUGINS}" = "yes" ] ; then
     exec "${VLOCK_MAIN}" ${plugins} ${VLOCK_PLUGINS} "$@"
@@ -0,0 +1,83 @@
+/* Count memory allocations by replacing malloc() and friends.  Allocations
+ * from libraries, e.g. GLib or strdup() in the C library, are counted, too.
+ * This relies on the GNU C library, which allows replacing malloc() and
+ * exports its own implementation under different names. */
+
+#include <stdlib.h>
+
+#include "alloc-count.h"
+
+static bool counting;
+static struct alloc_count counts;
+
+static void count_allocation(size_t size)
+{
+  if (__atomic_load_n(&counting, __ATOMIC_RELAXED)) {
+    __atomic_add_fetch(&counts.allocations, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counts.bytes, size, __ATOMIC_RELAXED);
+  }
+}
+
+void alloc_count_start(void)
+{
+  __atomic_store_n(&counts.allocations, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&counts.bytes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&counts.frees, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&counting, true, __ATOMIC_SEQ_CST);
+}
+
+void alloc_count_stop(struct alloc_count *count)
+{
+  __atomic_store_n(&counting, false, __ATOMIC_SEQ_CST);
+  count->allocations = __atomic_load_n(&counts.allocations, __ATOMIC_RELAXED);
+  count->bytes = __atomic_load_n(&counts.bytes, __ATOMIC_RELAXED);
+  count->frees = __atomic_load_n(&counts.frees, __ATOMIC_RELAXED);
+}
+
+bool alloc_count_supported(void)
+{
+  struct alloc_count count;
+  void *volatile p;
+
+  alloc_count_start();
+  p = malloc(1);
+  alloc_count_stop(&count);
+  free(p);
+
+  return count.allocations == 1;
+}
+
+#ifdef __GLIBC__
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+  count_allocation(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+  count_allocation(nmemb * size);
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  count_allocation(size);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+  if (ptr != NULL && __atomic_load_n(&counting, __ATOMIC_RELAXED))
+    __atomic_add_fetch(&counts.frees, 1, __ATOMIC_RELAXED);
+
+  __libc_free(ptr);
+}
+
+#endif /* __GLIBC__ */
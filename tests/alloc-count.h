@@ -0,0 +1,24 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Allocations made between alloc_count_start() and alloc_count_stop(). */
+struct alloc_count
+{
+  /* Calls of malloc(), calloc() and realloc(). */
+  size_t allocations;
+  /* Bytes requested by these calls. */
+  size_t bytes;
+  /* Calls of free() with a non-NULL pointer. */
+  size_t frees;
+};
+
+/* Whether allocations are counted.  This is not the case on systems other
+ * than GNU and when running under valgrind, which replaces malloc()
+ * itself.  Then the counts are always zero. */
+bool alloc_count_supported(void);
+
+/* Start counting the allocations of all threads. */
+void alloc_count_start(void);
+
+/* Stop counting and store the counts. */
+void alloc_count_stop(struct alloc_count *count);
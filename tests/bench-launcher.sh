@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# bench-launcher.sh -- compare the start up time of vlock launchers
+#
+# Usage: bench-launcher.sh <iterations> <launcher>...
+#
+# Every launcher is run the given number of times with typical options and a
+# typical ~/.vlockrc.  The launchers must be built to execute a program that
+# exits immediately instead of vlock-main, so the measured time is the time
+# from invocation until vlock-main would start locking.
+
+set -e
+
+iterations="$1"
+shift
+
+home=`mktemp -d -t vlock-bench.XXXXXX`
+trap 'rm -rf "${home}"' EXIT
+
+cat > "${home}/.vlockrc" <<'EOT'
+# Typical user settings.
+VLOCK_TIMEOUT=60
+VLOCK_PROMPT_TIMEOUT=30
+VLOCK_MESSAGE="${CLEAR_SCREEN}Locked.
+
+${VLOCK_ENTER_PROMPT}"
+VLOCK_PLUGINS="ttyblank"
+EOT
+
+now() {
+  date +%s%N
+}
+
+for launcher ; do
+  start=`now`
+  i=0
+  while [ "${i}" -lt "${iterations}" ] ; do
+    HOME="${home}" "${launcher}" -ans -t 5 caca
+    i=$((i + 1))
+  done
+  end=`now`
+
+  echo "${launcher}: $(( (end - start) / iterations / 1000 )) us per invocation"
+done
@@ -0,0 +1,184 @@
+/* e2e-standin.c -- stand-in authentication and plugins for the end-to-end
+ *                  tests of vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* This library is preloaded into vlock-main by vlock-e2e.  It replaces the
+ * system's password database so that every user has the password
+ * E2E_PASSWORD and redirects scripts and manifests from the configured script
+ * directory to the stand-ins in E2E_SCRIPT_DIR.  The time authentication
+ * takes can be set in milliseconds with the environment variable
+ * VLOCK_E2E_AUTH_DELAY. */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#ifdef E2E_PAM
+#include <security/pam_appl.h>
+#else
+#include <shadow.h>
+#endif
+
+#define E2E_PASSWORD "vlock-e2e"
+
+/* E2E_PASSWORD hashed with SHA-512. */
+#define E2E_PASSWORD_HASH \
+  "$6$vlocke2e$fMakpRTFI/t7ZVXdi6tilY6PoyI254Zzt6j.9wT9ve.WJVW9nMSU6WFlBw31" \
+  "Lgre91y7jQcRLXwx4Eowkfn.k."
+
+static void auth_delay(void)
+{
+  const char *delay = getenv("VLOCK_E2E_AUTH_DELAY");
+  long ms = delay != NULL ? strtol(delay, NULL, 10) : 0;
+
+  if (ms > 0) {
+    struct timespec t = { ms / 1000, (ms % 1000) * 1000000L };
+
+    while (nanosleep(&t, &t) < 0 && errno == EINTR)
+      ;
+  }
+}
+
+#ifdef E2E_PAM
+
+/* A minimal PAM that asks for the password through the conversation
+ * function of the application. */
+
+struct pam_handle
+{
+  struct pam_conv conv;
+};
+
+static struct pam_handle handle;
+
+int pam_start(const char *service_name __attribute__((unused)),
+              const char *user __attribute__((unused)),
+              const struct pam_conv *pam_conversation,
+              pam_handle_t **pamh)
+{
+  handle.conv = *pam_conversation;
+  *pamh = &handle;
+  return PAM_SUCCESS;
+}
+
+int pam_set_item(pam_handle_t *pamh __attribute__((unused)),
+                 int item_type __attribute__((unused)),
+                 const void *item __attribute__((unused)))
+{
+  return PAM_SUCCESS;
+}
+
+int pam_authenticate(pam_handle_t *pamh, int flags __attribute__((unused)))
+{
+  struct pam_message message = { PAM_PROMPT_ECHO_OFF, "Password: " };
+  const struct pam_message *messages[] = { &message };
+  struct pam_response *response = NULL;
+  int result;
+
+  result = pamh->conv.conv(1, messages, &response, pamh->conv.appdata_ptr);
+
+  if (result != PAM_SUCCESS)
+    return result;
+
+  auth_delay();
+
+  if (response != NULL && response[0].resp != NULL
+      && strcmp(response[0].resp, E2E_PASSWORD) == 0)
+    result = PAM_SUCCESS;
+  else
+    result = PAM_AUTH_ERR;
+
+  if (response != NULL)
+    free(response[0].resp);
+
+  free(response);
+
+  return result;
+}
+
+int pam_end(pam_handle_t *pamh __attribute__((unused)),
+            int pam_status __attribute__((unused)))
+{
+  return PAM_SUCCESS;
+}
+
+const char *pam_strerror(pam_handle_t *pamh __attribute__((unused)),
+                         int errnum)
+{
+  return errnum == PAM_SUCCESS ? "Success" : "Authentication failure";
+}
+
+#else /* !E2E_PAM */
+
+struct spwd *getspnam(const char *name)
+{
+  static struct spwd spw;
+
+  auth_delay();
+
+  spw.sp_namp = (char *) name;
+  spw.sp_pwdp = E2E_PASSWORD_HASH;
+  spw.sp_lstchg = spw.sp_min = spw.sp_max = -1;
+  spw.sp_warn = spw.sp_inact = spw.sp_expire = -1;
+
+  return &spw;
+}
+
+void endspent(void)
+{
+}
+
+#endif /* !E2E_PAM */
+
+/* Get the path of the stand-in for a path in the script directory.  Other
+ * paths are returned unchanged. */
+static const char *get_standin(const char *path, char *standin, size_t size)
+{
+  size_t length = strlen(VLOCK_SCRIPT_DIR);
+
+  if (strncmp(path, VLOCK_SCRIPT_DIR "/", length + 1) == 0
+      && snprintf(standin, size, "%s/%s", E2E_SCRIPT_DIR,
+                  path + length + 1) < (int) size)
+    return standin;
+
+  return path;
+}
+
+/* Run the stand-in for scripts in the script directory. */
+int execv(const char *path, char *const argv[])
+{
+  static int (*real_execv)(const char *, char *const[]);
+  char standin[4096];
+
+  if (real_execv == NULL)
+    *(void **) (&real_execv) = dlsym(RTLD_NEXT, "execv");
+
+  return real_execv(get_standin(path, standin, sizeof standin), argv);
+}
+
+/* Read the stand-in for manifests in the script directory. */
+FILE *fopen(const char *path, const char *mode)
+{
+  static FILE *(*real_fopen)(const char *, const char *);
+  char standin[4096];
+
+  if (real_fopen == NULL)
+    *(void **) (&real_fopen) = dlsym(RTLD_NEXT, "fopen");
+
+  return real_fopen(get_standin(path, standin, sizeof standin), mode);
+}
@@ -0,0 +1,8 @@
+#!/bin/sh
+#
+# idle-standin.sh -- stand-in for vlock that is run by the vlock-idle test
+#
+# Every lock appends a line to the file named by VLOCK_IDLE_TEST_LOG and
+# returns at once.
+
+echo lock >> "${VLOCK_IDLE_TEST_LOG}"
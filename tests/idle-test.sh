@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# idle-test.sh -- test vlock-idle with a FIFO as its input device
+#
+# Usage: idle-test.sh <vlock-idle>
+#
+# The given vlock-idle must be built to run idle-standin.sh instead of vlock.
+# Timeouts that are not valid must be rejected.  Input is written to the FIFO
+# more often than the timeout for a while, which must not lock, and then
+# stops, which must lock.
+
+set -e
+
+agent="$1"
+timeout=1
+
+dir=`mktemp -d -t vlock-idle-test.XXXXXX`
+trap 'kill ${pid} 2>/dev/null; rm -rf "${dir}"' EXIT
+
+mkfifo "${dir}/device"
+
+for bad in 0 -1 nan inf 1e30 0.0001 1x "" ; do
+  if "${agent}" -t "${bad}" -d "${dir}/device" 2>/dev/null ; then
+    echo "idle-test: timeout '${bad}' was accepted" >&2
+    exit 1
+  fi
+done
+VLOCK_IDLE_TEST_LOG="${dir}/locks"
+export VLOCK_IDLE_TEST_LOG
+: > "${VLOCK_IDLE_TEST_LOG}"
+
+"${agent}" -t ${timeout} -d "${dir}/device" &
+pid=$!
+
+locks() {
+  wc -l < "${VLOCK_IDLE_TEST_LOG}" | tr -d ' '
+}
+
+# Type every 0.4 seconds for four seconds.
+i=0
+while [ $i -lt 10 ] ; do
+  echo x > "${dir}/device"
+  sleep 0.4
+  i=`expr $i + 1`
+done
+
+if [ `locks` -ne 0 ] ; then
+  echo "idle-test: locked `locks` times while input arrived" >&2
+  exit 1
+fi
+
+# Stop typing.
+sleep 2
+
+if [ `locks` -eq 0 ] ; then
+  echo "idle-test: did not lock after the timeout" >&2
+  exit 1
+fi
+
+echo "idle-test: ok"
@@ -0,0 +1,95 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "counters.h"
+
+#include "test_counters.h"
+
+void test_counters_phases(void)
+{
+  struct vlock_counters before;
+  struct vlock_counters after;
+
+  counters_get(&before);
+
+  counters_set_phase(VLOCK_PHASE_SAVE);
+  counters_add(VLOCK_COUNTER_HOOKS, 2);
+  counters_set_phase(VLOCK_PHASE_AUTH);
+  counters_add(VLOCK_COUNTER_TERMINAL_BYTES, 10);
+
+  counters_get(&after);
+
+  CU_ASSERT_EQUAL(after.phase, VLOCK_PHASE_AUTH);
+  CU_ASSERT_EQUAL(after.counts[VLOCK_PHASE_SAVE][VLOCK_COUNTER_HOOKS]
+                  - before.counts[VLOCK_PHASE_SAVE][VLOCK_COUNTER_HOOKS], 2);
+  CU_ASSERT_EQUAL(
+    after.counts[VLOCK_PHASE_AUTH][VLOCK_COUNTER_TERMINAL_BYTES]
+    - before.counts[VLOCK_PHASE_AUTH][VLOCK_COUNTER_TERMINAL_BYTES], 10);
+  CU_ASSERT_EQUAL(after.counts[VLOCK_PHASE_AUTH][VLOCK_COUNTER_HOOKS],
+                  before.counts[VLOCK_PHASE_AUTH][VLOCK_COUNTER_HOOKS]);
+
+  counters_set_phase(VLOCK_PHASE_STARTUP);
+}
+
+void test_counters_attach(void)
+{
+  struct vlock_counters storage;
+  struct vlock_counters snapshot;
+  uint64_t spawns;
+
+  counters_set_phase(VLOCK_PHASE_LOCKED_IDLE);
+  counters_add(VLOCK_COUNTER_SPAWNS, 1);
+  counters_get(&snapshot);
+  spawns = snapshot.counts[VLOCK_PHASE_LOCKED_IDLE][VLOCK_COUNTER_SPAWNS];
+
+  /* The values are carried over in both directions. */
+  memset(&storage, 0xff, sizeof storage);
+  counters_attach(&storage);
+  CU_ASSERT_EQUAL(storage.counts[VLOCK_PHASE_LOCKED_IDLE][VLOCK_COUNTER_SPAWNS],
+                  spawns);
+
+  counters_add(VLOCK_COUNTER_SPAWNS, 1);
+  CU_ASSERT_EQUAL(storage.counts[VLOCK_PHASE_LOCKED_IDLE][VLOCK_COUNTER_SPAWNS],
+                  spawns + 1);
+
+  counters_attach(NULL);
+  counters_add(VLOCK_COUNTER_SPAWNS, 1);
+  CU_ASSERT_EQUAL(storage.counts[VLOCK_PHASE_LOCKED_IDLE][VLOCK_COUNTER_SPAWNS],
+                  spawns + 1);
+
+  counters_get(&snapshot);
+  CU_ASSERT_EQUAL(snapshot.counts[VLOCK_PHASE_LOCKED_IDLE][VLOCK_COUNTER_SPAWNS],
+                  spawns + 2);
+
+  counters_set_phase(VLOCK_PHASE_STARTUP);
+}
+
+void test_counters_print(void)
+{
+  char *output = NULL;
+  size_t size = 0;
+  FILE *f = open_memstream(&output, &size);
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(f);
+
+  counters_print(f);
+  fclose(f);
+
+  CU_ASSERT_PTR_NOT_NULL(strstr(output, "vlock: counters locked-idle spawns="));
+  CU_ASSERT_PTR_NOT_NULL(strstr(output, " terminal-bytes="));
+  CU_ASSERT_PTR_NOT_NULL(strstr(output, "vlock: counters teardown "));
+
+  free(output);
+}
+
+CU_TestInfo counters_tests[] = {
+  { "test_counters_phases", test_counters_phases },
+  { "test_counters_attach", test_counters_attach },
+  { "test_counters_print", test_counters_print },
+  CU_TEST_INFO_NULL,
+};
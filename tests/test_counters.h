@@ -0,0 +1 @@
+extern CU_TestInfo counters_tests[];
@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/CUnit.h>
+
+#include "logging.h"
+
+#include "test_logging.h"
+
+void test_event_log_file(void)
+{
+  char filename[] = "/tmp/vlock-test-events.XXXXXX";
+  char line[256];
+  FILE *f;
+  int fd = mkstemp(filename);
+
+  CU_ASSERT_FATAL(fd >= 0);
+  close(fd);
+
+  /* Events are ignored while the log is closed. */
+  vlock_log_event(VLOCK_EVENT_UNLOCK, "nobody", NULL, 0);
+
+  CU_ASSERT_FATAL(vlock_event_log_open(filename));
+
+  vlock_log_event(VLOCK_EVENT_LOCK, "alice", NULL, 3);
+  vlock_log_event(VLOCK_EVENT_AUTH_FAILURE, "root", NULL, 1);
+  vlock_log_event(VLOCK_EVENT_PLUGIN_FAILURE, "bad plugin", "vlock_start", 5);
+
+  /* Stopping alone writes everything, e.g. in a signal handler. */
+  vlock_event_log_stop();
+
+  vlock_log_event(VLOCK_EVENT_UNLOCK, "nobody", NULL, 0);
+
+  f = fopen(filename, "r");
+  CU_ASSERT_FATAL(f != NULL);
+
+  CU_ASSERT(fgets(line, sizeof line, f) != NULL);
+  CU_ASSERT(strstr(line, ": lock user=alice vt=3\n") != NULL);
+  CU_ASSERT(fgets(line, sizeof line, f) != NULL);
+  CU_ASSERT(strstr(line, ": auth-failure user=root attempt=1\n") != NULL);
+  CU_ASSERT(fgets(line, sizeof line, f) != NULL);
+  CU_ASSERT(strstr(line,
+                   ": plugin-failure plugin=bad_plugin hook=vlock_start errno=5\n")
+            != NULL);
+  CU_ASSERT(fgets(line, sizeof line, f) == NULL);
+
+  fclose(f);
+  unlink(filename);
+
+  vlock_event_log_close();
+}
+
+CU_TestInfo logging_tests[] = {
+  { "test_event_log_file", test_event_log_file },
+  CU_TEST_INFO_NULL,
+};
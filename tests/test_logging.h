@@ -0,0 +1 @@
+extern CU_TestInfo logging_tests[];
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include <CUnit/CUnit.h>
+
+#include "plugin.h"
+#include "manifest.h"
+#include "counters.h"
+
+#include "test_manifest.h"
+
+static uint64_t spawns(void)
+{
+  struct vlock_counters counters;
+  counters_get(&counters);
+  return counters.counts[counters.phase][VLOCK_COUNTER_SPAWNS];
+}
+
+static gchar **get_dependency(VlockPlugin *p, const char *name)
+{
+  for (size_t i = 0; i < nr_dependencies; i++)
+    if (strcmp(dependency_names[i], name) == 0)
+      return p->dependencies[i];
+
+  return NULL;
+}
+
+void test_manifest_dependencies(void)
+{
+  VlockPlugin *p = vlock_plugin_new(TYPE_VLOCK_MANIFEST, "good");
+  GError *err = NULL;
+  uint64_t before = spawns();
+  gchar **depends;
+  gchar **succeeds;
+  gchar **conflicts;
+
+  CU_ASSERT(vlock_plugin_open(p, &err));
+  CU_ASSERT_PTR_NULL(err);
+
+  /* Reading the manifest starts no process. */
+  CU_ASSERT_EQUAL(spawns(), before);
+
+  depends = get_dependency(p, "depends");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(depends);
+  CU_ASSERT_STRING_EQUAL(depends[0], "all");
+  CU_ASSERT_PTR_NULL(depends[1]);
+
+  succeeds = get_dependency(p, "succeeds");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(succeeds);
+  CU_ASSERT_STRING_EQUAL(succeeds[0], "new");
+  CU_ASSERT_STRING_EQUAL(succeeds[1], "nosysrq");
+  CU_ASSERT_PTR_NULL(succeeds[2]);
+
+  conflicts = get_dependency(p, "conflicts");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(conflicts);
+  CU_ASSERT_STRING_EQUAL(conflicts[0], "other");
+
+  CU_ASSERT_PTR_NULL(get_dependency(p, "requires"));
+
+  vlock_plugin_unref(p);
+}
+
+void test_manifest_hooks(void)
+{
+  VlockPlugin *p = vlock_plugin_new(TYPE_VLOCK_MANIFEST, "good");
+  uint64_t before;
+
+  CU_ASSERT_FATAL(vlock_plugin_open(p, NULL));
+
+  before = spawns();
+
+  /* A command is only started when its hook is called. */
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_start"));
+  CU_ASSERT_EQUAL(spawns(), before + 1);
+
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_end"));
+  CU_ASSERT_EQUAL(spawns(), before + 1);
+
+  /* The screen saver is killed when the save is aborted. */
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_save"));
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_save_abort"));
+  CU_ASSERT_EQUAL(spawns(), before + 2);
+
+  vlock_plugin_unref(p);
+}
+
+/* Get the pid of an exited child that was not collected yet or 0. */
+static pid_t exited_child(void)
+{
+  siginfo_t info;
+
+  info.si_pid = 0;
+
+  if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) < 0)
+    return 0;
+
+  return info.si_pid;
+}
+
+void test_manifest_reap(void)
+{
+  VlockPlugin *p = vlock_plugin_new(TYPE_VLOCK_MANIFEST, "good");
+  struct timespec nap = { 0, 10000000 };
+
+  /* Collect what other tests left behind. */
+  while (waitpid(-1, NULL, WNOHANG) > 0)
+    ;
+
+  CU_ASSERT_FATAL(vlock_plugin_open(p, NULL));
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_start"));
+
+  for (int i = 0; i < 500 && exited_child() == 0; i++)
+    (void) nanosleep(&nap, NULL);
+
+  CU_ASSERT_FATAL(exited_child() != 0);
+
+  /* Any hook collects the command of vlock_start. */
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_end"));
+  CU_ASSERT_EQUAL(exited_child(), 0);
+
+  vlock_plugin_unref(p);
+}
+
+void test_manifest_errors(void)
+{
+  const char *names[] = { "relative", "unknown" };
+  VlockPlugin *p = vlock_plugin_new(TYPE_VLOCK_MANIFEST, "missing");
+  GError *err = NULL;
+
+  CU_ASSERT(!vlock_plugin_open(p, &err));
+  CU_ASSERT(g_error_matches(err, VLOCK_PLUGIN_ERROR,
+                            VLOCK_PLUGIN_ERROR_NOT_FOUND));
+  g_clear_error(&err);
+  vlock_plugin_unref(p);
+
+  for (size_t i = 0; i < sizeof names / sizeof names[0]; i++) {
+    p = vlock_plugin_new(TYPE_VLOCK_MANIFEST, names[i]);
+
+    CU_ASSERT(!vlock_plugin_open(p, &err));
+    CU_ASSERT(g_error_matches(err, VLOCK_PLUGIN_ERROR,
+                              VLOCK_PLUGIN_ERROR_FAILED));
+    g_clear_error(&err);
+    vlock_plugin_unref(p);
+  }
+}
+
+CU_TestInfo manifest_tests[] = {
+  { "test_manifest_dependencies", test_manifest_dependencies },
+  { "test_manifest_hooks", test_manifest_hooks },
+  { "test_manifest_reap", test_manifest_reap },
+  { "test_manifest_errors", test_manifest_errors },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo manifest_tests[];
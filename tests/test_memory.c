@@ -0,0 +1,54 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "memory.h"
+
+#include "test_memory.h"
+
+#define NR_BLOCKS 2048
+#define BLOCK_SIZE 4096
+
+void test_memory_get_rss_kb(void)
+{
+  CU_ASSERT(memory_get_rss_kb() > 0);
+}
+
+void test_memory_release(void)
+{
+  static char *blocks[NR_BLOCKS];
+  unsigned long before;
+  unsigned long after;
+
+  /* Fill the heap with small blocks. */
+  for (size_t i = 0; i < NR_BLOCKS; i++) {
+    blocks[i] = malloc(BLOCK_SIZE);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(blocks[i]);
+    memset(blocks[i], 0x55, BLOCK_SIZE);
+  }
+
+  /* Free all but the last block, which keeps free() from shrinking the
+   * heap by itself. */
+  for (size_t i = 0; i < NR_BLOCKS - 1; i++)
+    free(blocks[i]);
+
+  before = memory_get_rss_kb();
+  memory_release();
+  after = memory_get_rss_kb();
+
+#ifdef __GLIBC__
+  /* Most of the freed eight megabytes are given back. */
+  CU_ASSERT(after + (NR_BLOCKS * BLOCK_SIZE / 1024) / 2 < before);
+#else
+  CU_ASSERT(after > 0);
+#endif
+
+  free(blocks[NR_BLOCKS - 1]);
+}
+
+CU_TestInfo memory_tests[] = {
+  { "test_memory_get_rss_kb", test_memory_get_rss_kb },
+  { "test_memory_release", test_memory_release },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo memory_tests[];
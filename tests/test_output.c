@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <CUnit/CUnit.h>
+
+#include "output.h"
+
+#include "test_output.h"
+
+static int pipe_fds[2];
+
+/* Read everything that was written to the pipe. */
+static char *read_pipe(char *buffer, size_t size)
+{
+  ssize_t length = read(pipe_fds[0], buffer, size - 1);
+
+  buffer[length > 0 ? length : 0] = '\0';
+  return buffer;
+}
+
+static void open_pipe(void)
+{
+  CU_ASSERT_FATAL(pipe(pipe_fds) == 0);
+  (void) fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+  output_set_fd(pipe_fds[1]);
+}
+
+static void close_pipe(void)
+{
+  output_invalidate();
+  output_set_fd(STDERR_FILENO);
+  (void) close(pipe_fds[0]);
+  (void) close(pipe_fds[1]);
+}
+
+void test_output_frame(void)
+{
+  char buffer[256];
+
+  open_pipe();
+
+  /* Nothing is written before the frame is flushed. */
+  output_add("alice's ");
+  output_printf("%s: ", "Password");
+  CU_ASSERT_STRING_EQUAL(read_pipe(buffer, sizeof buffer), "");
+
+  CU_ASSERT(output_flush());
+  CU_ASSERT_STRING_EQUAL(read_pipe(buffer, sizeof buffer),
+                         "alice's Password: ");
+
+  /* More pieces than fit into one frame. */
+  for (int i = 0; i < 40; i++)
+    if (i % 2 == 0)
+      output_add("x");
+    else
+      output_printf("%d", i % 10);
+
+  CU_ASSERT(output_flush());
+  CU_ASSERT_EQUAL(strlen(read_pipe(buffer, sizeof buffer)), 40);
+
+  close_pipe();
+}
+
+void test_output_clear_screen(void)
+{
+  char buffer[256];
+
+  open_pipe();
+
+  /* Text before the clear screen sequence would be erased anyway. */
+  output_add("Timeout!\n");
+  output_add(OUTPUT_CLEAR_SCREEN "locked\n");
+  CU_ASSERT(output_flush());
+  CU_ASSERT_STRING_EQUAL(read_pipe(buffer, sizeof buffer),
+                         OUTPUT_CLEAR_SCREEN "locked\n");
+
+  /* The screen already shows the same frame. */
+  output_add(OUTPUT_CLEAR_SCREEN "locked\n");
+  CU_ASSERT(output_flush());
+  CU_ASSERT_STRING_EQUAL(read_pipe(buffer, sizeof buffer), "");
+
+  /* Unless something else changed it. */
+  output_invalidate();
+  output_add(OUTPUT_CLEAR_SCREEN "locked\n");
+  CU_ASSERT(output_flush());
+  CU_ASSERT_STRING_EQUAL(read_pipe(buffer, sizeof buffer),
+                         OUTPUT_CLEAR_SCREEN "locked\n");
+
+  output_add("Password: ");
+  CU_ASSERT(output_flush());
+  (void) read_pipe(buffer, sizeof buffer);
+
+  output_add(OUTPUT_CLEAR_SCREEN "locked\n");
+  CU_ASSERT(output_flush());
+  CU_ASSERT_STRING_EQUAL(read_pipe(buffer, sizeof buffer),
+                         OUTPUT_CLEAR_SCREEN "locked\n");
+
+  close_pipe();
+}
+
+CU_TestInfo output_tests[] = {
+  { "test_output_frame", test_output_frame },
+  { "test_output_clear_screen", test_output_clear_screen },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo output_tests[];
@@ -0,0 +1,135 @@
+#include <stdlib.h>
+
+#include <CUnit/CUnit.h>
+
+#include "plugin.h"
+
+#include "alloc-count.h"
+#include "test_plugin.h"
+
+static const char *hook_names[] = {
+  "vlock_start",
+  "vlock_end",
+  "vlock_save",
+  "vlock_save_abort",
+};
+
+#define NR_HOOK_NAMES (sizeof hook_names / sizeof hook_names[0])
+
+static unsigned int hook_calls;
+
+static bool counting_call_hook(VlockPlugin *self __attribute__((unused)),
+                               const gchar *hook_name __attribute__((unused)))
+{
+  hook_calls++;
+  return true;
+}
+
+#ifndef NO_GLIB
+
+/* A plugin class that only counts hook calls. */
+typedef VlockPlugin TestPlugin;
+typedef VlockPluginClass TestPluginClass;
+
+G_DEFINE_TYPE(TestPlugin, test_plugin, TYPE_VLOCK_PLUGIN)
+
+static void test_plugin_init(TestPlugin *self __attribute__((unused)))
+{
+}
+
+static void test_plugin_class_init(TestPluginClass *klass)
+{
+  klass->call_hook = counting_call_hook;
+}
+
+#define TEST_PLUGIN_TYPE (test_plugin_get_type())
+
+#else /* NO_GLIB */
+
+static const VlockPluginClass test_plugin_class = {
+  .instance_size = sizeof (VlockPlugin),
+  .call_hook = counting_call_hook,
+};
+
+#define TEST_PLUGIN_TYPE (&test_plugin_class)
+
+#endif /* NO_GLIB */
+
+void test_plugin_add_dependency(void)
+{
+  VlockPlugin *p = vlock_plugin_new(TEST_PLUGIN_TYPE, "test");
+  struct alloc_count count;
+
+  alloc_count_start();
+  vlock_plugin_add_dependency(p, 0, "first");
+  alloc_count_stop(&count);
+
+  vlock_plugin_add_dependency(p, 0, "second");
+
+  CU_ASSERT_STRING_EQUAL(p->dependencies[0][0], "first");
+  CU_ASSERT_STRING_EQUAL(p->dependencies[0][1], "second");
+  CU_ASSERT_PTR_NULL(p->dependencies[0][2]);
+
+  /* The array and the copy of the name.  This also checks that allocations
+   * are counted at all. */
+  if (alloc_count_supported())
+    CU_ASSERT_EQUAL(count.allocations, 2);
+
+  vlock_plugin_unref(p);
+}
+
+void test_plugin_static_dependency(void)
+{
+  static const char *const names[] = { "first", NULL };
+  VlockPlugin *p = vlock_plugin_new(TEST_PLUGIN_TYPE, "test");
+  struct alloc_count count;
+
+  alloc_count_start();
+  vlock_plugin_set_static_dependency(p, 0, names);
+  alloc_count_stop(&count);
+
+  /* The array is used in place. */
+  CU_ASSERT_PTR_EQUAL(p->dependencies[0], names);
+  CU_ASSERT_EQUAL(count.allocations, 0);
+
+  /* Adding a name copies the array first. */
+  vlock_plugin_add_dependency(p, 0, "second");
+
+  CU_ASSERT_PTR_NOT_EQUAL(p->dependencies[0], names);
+  CU_ASSERT_STRING_EQUAL(p->dependencies[0][0], "first");
+  CU_ASSERT_STRING_EQUAL(p->dependencies[0][1], "second");
+  CU_ASSERT_PTR_NULL(p->dependencies[0][2]);
+  CU_ASSERT_PTR_NULL(names[1]);
+
+  vlock_plugin_unref(p);
+}
+
+void test_plugin_call_hook(void)
+{
+  VlockPlugin *p = vlock_plugin_new(TEST_PLUGIN_TYPE, "test");
+  struct alloc_count count;
+
+  hook_calls = 0;
+
+  alloc_count_start();
+
+  for (int i = 0; i < 100; i++)
+    for (size_t j = 0; j < NR_HOOK_NAMES; j++)
+      (void) vlock_plugin_call_hook(p, hook_names[j]);
+
+  alloc_count_stop(&count);
+
+  CU_ASSERT_EQUAL(hook_calls, 100 * NR_HOOK_NAMES);
+
+  /* Dispatching hooks must not allocate. */
+  CU_ASSERT_EQUAL(count.allocations, 0);
+
+  vlock_plugin_unref(p);
+}
+
+CU_TestInfo plugin_tests[] = {
+  { "test_plugin_add_dependency", test_plugin_add_dependency },
+  { "test_plugin_static_dependency", test_plugin_static_dependency },
+  { "test_plugin_call_hook", test_plugin_call_hook },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo plugin_tests[];
@@ -0,0 +1,508 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <CUnit/CUnit.h>
+
+#include "plugin.h"
+#include "plugins.h"
+#include "synthetic.h"
+#include "counters.h"
+
+#include "test_plugins.h"
+
+static bool load_all_plugins(void)
+{
+  for (size_t i = 0; i < vlock_synthetic_count(); i++)
+    if (!load_plugin(vlock_synthetic_get_name(i), NULL))
+      return false;
+
+  return true;
+}
+
+/* Return the position of the name in the list or -1. */
+static long position_of(char **names, size_t nr_names, const char *name)
+{
+  for (size_t i = 0; i < nr_names; i++)
+    if (strcmp(names[i], name) == 0)
+      return i;
+
+  return -1;
+}
+
+static double elapsed_milliseconds(const struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1e3
+         + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void test_plugins_requires(void)
+{
+  vlock_synthetic_add_dependency("a", "requires", "b");
+  vlock_synthetic_add_dependency("b", "requires", "c");
+  vlock_synthetic_define("c");
+
+  CU_ASSERT(load_plugin("a", NULL));
+  CU_ASSERT(!is_plugin_loaded("c"));
+  CU_ASSERT(resolve_dependencies(NULL));
+  CU_ASSERT(is_plugin_loaded("b"));
+  CU_ASSERT(is_plugin_loaded("c"));
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_conflicts(void)
+{
+  GError *err = NULL;
+
+  vlock_synthetic_add_dependency("a", "conflicts", "b");
+  vlock_synthetic_define("b");
+
+  CU_ASSERT(load_all_plugins());
+  CU_ASSERT(!resolve_dependencies(&err));
+  CU_ASSERT(g_error_matches(err, VLOCK_PLUGIN_ERROR,
+                            VLOCK_PLUGIN_ERROR_DEPENDENCY));
+  g_clear_error(&err);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_random_graph(void)
+{
+  const struct vlock_synthetic_graph graph = {
+    .succeeds = 2.0,
+    .requires = 0.5,
+    .depends = 0.5,
+    .conflicts = 0.5,
+    .seed = 7,
+  };
+  char *names;
+  char *list[1000];
+  size_t nr_names = 0;
+  bool ordered = true;
+
+  vlock_synthetic_generate(1000, &graph);
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+
+  names = get_plugin_names();
+
+  for (char *p = strtok(names, " "); p != NULL && nr_names < 1000;
+       p = strtok(NULL, " "))
+    list[nr_names++] = p;
+
+  CU_ASSERT_EQUAL(nr_names, 1000);
+
+  /* Every plugin comes after the plugins it succeeds. */
+  for (size_t i = 0; i < nr_names; i++) {
+    VlockPlugin *p = vlock_plugin_new(TYPE_VLOCK_SYNTHETIC, list[i]);
+
+    CU_ASSERT(vlock_plugin_open(p, NULL));
+
+    for (gchar **d = p->dependencies[0]; d != NULL && *d != NULL; d++)
+      if (position_of(list, nr_names, *d) >= (long) i)
+        ordered = false;
+
+    vlock_plugin_unref(p);
+  }
+
+  CU_ASSERT(ordered);
+
+  g_free(names);
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_circle(void)
+{
+  const struct vlock_synthetic_graph graph = {
+    .succeeds = 1.0,
+    .circle_length = 1000,
+    .seed = 7,
+  };
+  GError *err = NULL;
+
+  vlock_synthetic_generate(1000, &graph);
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT(!resolve_dependencies(&err));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(err);
+  CU_ASSERT(g_error_matches(err, VLOCK_PLUGIN_ERROR,
+                            VLOCK_PLUGIN_ERROR_DEPENDENCY));
+
+  /* The edge closing the circle is reported. */
+  CU_ASSERT_PTR_NOT_NULL(strstr(err->message,
+                                "circular dependencies detected:"));
+  CU_ASSERT_PTR_NOT_NULL(strstr(err->message,
+                                "'p999'\tmust come before\t'p0'"));
+  g_clear_error(&err);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_async_hooks(void)
+{
+  const char *names[] = { "a", "b", "c" };
+  struct timespec start;
+  unsigned long hook_calls;
+  double elapsed;
+
+  for (size_t i = 0; i < 3; i++) {
+    vlock_synthetic_set_hook_latency(names[i], "vlock_end", 100000);
+    vlock_synthetic_set_async_timeout(names[i], 1000);
+  }
+
+  /* This one is cancelled after 20 ms and fails. */
+  vlock_synthetic_set_hook_latency("d", "vlock_save_abort", 10000000);
+  vlock_synthetic_set_async_timeout("d", 20);
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+
+  /* The hooks run at the same time. */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  plugin_hook("vlock_end");
+  elapsed = elapsed_milliseconds(&start);
+
+  CU_ASSERT(elapsed >= 100);
+  CU_ASSERT(elapsed < 250);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  plugin_hook("vlock_save_abort");
+  elapsed = elapsed_milliseconds(&start);
+
+  CU_ASSERT(elapsed >= 20);
+  CU_ASSERT(elapsed < 1000);
+
+  /* The failed plugin is not saved again. */
+  hook_calls = vlock_synthetic_hook_calls;
+  plugin_hook("vlock_save");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 3);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_wake(void)
+{
+  struct timespec start;
+  unsigned long hook_calls;
+  double elapsed;
+
+  /* "saver" uses the display, "lights" takes 100 ms to fade in. */
+  vlock_synthetic_set_display("saver", true);
+  vlock_synthetic_set_hook_latency("lights", "vlock_save_abort", 100000);
+  vlock_synthetic_set_async_timeout("lights", 1000);
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+
+  plugin_hook("vlock_save");
+
+  /* Only the display is woken up at first. */
+  hook_calls = vlock_synthetic_hook_calls;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  plugin_wake_display();
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 1);
+
+  /* The lights fade in the background. */
+  plugin_wake_finish();
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 2);
+  CU_ASSERT(elapsed_milliseconds(&start) < 50);
+
+  /* They are finished before the next hook is called. */
+  plugin_hook("vlock_save");
+  elapsed = elapsed_milliseconds(&start);
+
+  CU_ASSERT(elapsed >= 100);
+  CU_ASSERT(elapsed < 1000);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_depends_chain(void)
+{
+  /* "c" is not defined, so "b" is removed and then "a". */
+  vlock_synthetic_add_dependency("a", "depends", "b");
+  vlock_synthetic_add_dependency("b", "depends", "c");
+  vlock_synthetic_define("d");
+
+  CU_ASSERT(load_all_plugins());
+  CU_ASSERT(resolve_dependencies(NULL));
+  CU_ASSERT(!is_plugin_loaded("a"));
+  CU_ASSERT(!is_plugin_loaded("b"));
+  CU_ASSERT(is_plugin_loaded("d"));
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+/* Plugins of the brute force test, the last names are never defined. */
+#define NR_DEFINED 8
+#define NR_NAMES 10
+
+static const char *brute_force_kinds[] = {
+  "requires", "needs", "depends", "conflicts",
+};
+
+/* Resolve the dependencies by applying the rules until nothing changes.
+ * Returns whether resolving succeeds and the plugins that remain. */
+static bool brute_force_resolve(bool edges[4][NR_DEFINED][NR_NAMES],
+                                bool loaded[NR_DEFINED])
+{
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (size_t p = 0; p < NR_DEFINED; p++)
+      for (size_t q = 0; loaded[p] && q < NR_NAMES; q++)
+        if (edges[0][p][q]) {
+          if (q >= NR_DEFINED)
+            return false;
+
+          changed |= !loaded[q];
+          loaded[q] = true;
+        }
+  }
+
+  changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (size_t p = 0; p < NR_DEFINED; p++)
+      for (size_t q = 0; loaded[p] && q < NR_NAMES; q++)
+        if (edges[2][p][q] && (q >= NR_DEFINED || !loaded[q]))
+          loaded[p] = false, changed = true;
+  }
+
+  for (size_t p = 0; p < NR_DEFINED; p++)
+    for (size_t q = 0; loaded[p] && q < NR_NAMES; q++) {
+      bool present = q < NR_DEFINED && loaded[q];
+
+      if ((edges[0][p][q] || edges[1][p][q]) && !present)
+        return false;
+
+      if (edges[3][p][q] && present)
+        return false;
+    }
+
+  return true;
+}
+
+void test_plugins_brute_force(void)
+{
+  bool agree = true;
+
+  for (unsigned int seed = 1; seed <= 2000 && agree; seed++) {
+    bool edges[4][NR_DEFINED][NR_NAMES] = { { { false } } };
+    bool loaded[NR_DEFINED];
+    char names[NR_NAMES][8];
+    unsigned int state = seed;
+    bool expected;
+    bool result;
+
+    for (size_t q = 0; q < NR_NAMES; q++)
+      sprintf(names[q], "%c%zu", q < NR_DEFINED ? 'p' : 'x', q);
+
+    for (size_t p = 0; p < NR_DEFINED; p++) {
+      vlock_synthetic_define(names[p]);
+
+      for (size_t k = 0; k < 4; k++)
+        for (size_t q = 0; q < NR_NAMES; q++)
+          if (q != p && rand_r(&state) % 12 == 0) {
+            edges[k][p][q] = true;
+            vlock_synthetic_add_dependency(names[p],
+                                           brute_force_kinds[k],
+                                           names[q]);
+          }
+    }
+
+    for (size_t p = 0; p < NR_DEFINED; p++) {
+      loaded[p] = rand_r(&state) % 2 == 0;
+
+      if (loaded[p])
+        CU_ASSERT(load_plugin(names[p], NULL));
+    }
+
+    expected = brute_force_resolve(edges, loaded);
+    result = resolve_dependencies(NULL);
+
+    if (result != expected)
+      agree = false;
+
+    for (size_t p = 0; result && p < NR_DEFINED; p++)
+      if (is_plugin_loaded(names[p]) != loaded[p])
+        agree = false;
+
+    unload_plugins();
+    vlock_synthetic_clear();
+  }
+
+  CU_ASSERT(agree);
+}
+
+void test_plugins_lock_critical(void)
+{
+  unsigned long hook_calls;
+  struct timespec start;
+
+  /* "first" must come before the critical "lock", so it is critical, too.
+   * "slow" is cancelled after 20 ms and fails. */
+  vlock_synthetic_set_critical("lock", true);
+  vlock_synthetic_add_dependency("first", "preceeds", "lock");
+  vlock_synthetic_add_dependency("slow", "succeeds", "lock");
+  vlock_synthetic_set_hook_latency("slow", "vlock_start", 10000000);
+  vlock_synthetic_set_async_timeout("slow", 20);
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+
+  hook_calls = vlock_synthetic_hook_calls;
+  plugin_hook("vlock_start");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 2);
+
+  /* The best-effort hook is not waited for. */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  plugin_start_best_effort();
+  CU_ASSERT(elapsed_milliseconds(&start) < 20);
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 3);
+
+  /* Its failure is collected before the next hook and it is not ended. */
+  plugin_hook("vlock_end");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 5);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_best_effort(void)
+{
+  unsigned long hook_calls;
+
+  vlock_synthetic_define("saver");
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+
+  /* A plugin that is not critical is only started after the lock. */
+  hook_calls = vlock_synthetic_hook_calls;
+  plugin_hook("vlock_start");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 0);
+
+  plugin_start_best_effort();
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 1);
+
+  /* Once started it gets all other hooks. */
+  plugin_hook("vlock_save");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 2);
+  plugin_hook("vlock_save_abort");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 3);
+  plugin_hook("vlock_end");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 4);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+static uint64_t suppressed_saves(void)
+{
+  struct vlock_counters counters;
+  uint64_t sum = 0;
+
+  counters_get(&counters);
+
+  for (size_t i = 0; i < VLOCK_NR_PHASES; i++)
+    sum += counters.counts[i][VLOCK_COUNTER_SUPPRESSED_SAVES];
+
+  return sum;
+}
+
+void test_plugins_save_storm(void)
+{
+  unsigned long hook_calls;
+  uint64_t suppressed;
+  unsigned int hold_off;
+
+  vlock_synthetic_define("saver");
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+  CU_ASSERT_EQUAL(plugin_save_hold_off(), 0);
+
+  /* A save that is aborted at once is short. */
+  plugin_hook("vlock_save");
+  plugin_hook("vlock_save_abort");
+
+  hold_off = plugin_save_hold_off();
+  CU_ASSERT(hold_off > 0);
+  CU_ASSERT(hold_off <= 1000);
+
+  /* The next save is held back and so is its abort. */
+  hook_calls = vlock_synthetic_hook_calls;
+  suppressed = suppressed_saves();
+  plugin_hook("vlock_save");
+  plugin_hook("vlock_save_abort");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 0);
+  CU_ASSERT_EQUAL(suppressed_saves() - suppressed, 1);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+void test_plugins_busy_save(void)
+{
+  unsigned long hook_calls;
+  uint64_t suppressed;
+
+  vlock_synthetic_set_hook_error("busy", "vlock_save", EAGAIN);
+
+  CU_ASSERT_FATAL(load_all_plugins());
+  CU_ASSERT_FATAL(resolve_dependencies(NULL));
+
+  /* A busy plugin skips the save and its abort. */
+  hook_calls = vlock_synthetic_hook_calls;
+  suppressed = suppressed_saves();
+  plugin_hook("vlock_save");
+  plugin_hook("vlock_save_abort");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 1);
+  CU_ASSERT_EQUAL(suppressed_saves() - suppressed, 1);
+
+  /* It is not given up and gets the next save. */
+  vlock_synthetic_set_hook_error("busy", "vlock_save", 0);
+  hook_calls = vlock_synthetic_hook_calls;
+  plugin_hook("vlock_save");
+  plugin_hook("vlock_save_abort");
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls - hook_calls, 2);
+
+  unload_plugins();
+  vlock_synthetic_clear();
+}
+
+CU_TestInfo plugins_tests[] = {
+  { "test_plugins_requires", test_plugins_requires },
+  { "test_plugins_conflicts", test_plugins_conflicts },
+  { "test_plugins_depends_chain", test_plugins_depends_chain },
+  { "test_plugins_brute_force", test_plugins_brute_force },
+  { "test_plugins_random_graph", test_plugins_random_graph },
+  { "test_plugins_circle", test_plugins_circle },
+  { "test_plugins_async_hooks", test_plugins_async_hooks },
+  { "test_plugins_wake", test_plugins_wake },
+  { "test_plugins_lock_critical", test_plugins_lock_critical },
+  { "test_plugins_best_effort", test_plugins_best_effort },
+  { "test_plugins_save_storm", test_plugins_save_storm },
+  { "test_plugins_busy_save", test_plugins_busy_save },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo plugins_tests[];
@@ -1,5 +1,14 @@
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 #include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
@@ -10,6 +19,7 @@
 
 #include "process.h"
 
+#include "alloc-count.h"
 #include "test_process.h"
 
 void test_wait_for_death(void)
@@ -43,6 +53,60 @@ void test_ensure_death(void)
   CU_ASSERT(errno == ECHILD);
 }
 
+void test_ensure_group_death(void)
+{
+  const char *argv[] = { "sh", "-c", "trap '' TERM; sleep 10 & sleep 10",
+                         NULL };
+  struct child_process child = {
+    .path = "/bin/sh",
+    .argv = argv,
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+    .function = NULL,
+    .new_group = true,
+  };
+  struct child_usage usage;
+  bool dead = false;
+
+#ifdef PR_SET_CHILD_SUBREAPER
+  /* Become the parent of the background child so it can be reaped here. */
+  (void) prctl(PR_SET_CHILD_SUBREAPER, 1);
+#endif
+
+  CU_ASSERT_FATAL(create_child(&child, NULL));
+  CU_ASSERT(getpgid(child.pid) == child.pid);
+
+  /* Wait for the background child.  The shell may exec the other one. */
+  for (int i = 0; i < 100; i++) {
+    CU_ASSERT_FATAL(get_child_usage(child.pid, &usage));
+
+    if (usage.processes >= 2)
+      break;
+
+    usleep(10000);
+  }
+
+  CU_ASSERT(usage.processes >= 2);
+
+  ensure_group_death(child.pid);
+
+  /* Without a subreaper the background child is reaped by init. */
+  for (int i = 0; i < 100 && !dead; i++) {
+    while (waitpid(-child.pid, NULL, WNOHANG) > 0)
+      ;
+
+    dead = kill(-child.pid, 0) < 0 && errno == ESRCH;
+    usleep(10000);
+  }
+
+  CU_ASSERT(dead);
+
+#ifdef PR_SET_CHILD_SUBREAPER
+  (void) prctl(PR_SET_CHILD_SUBREAPER, 0);
+#endif
+}
+
 int child_function(void *a)
 {
   char *s = a;
@@ -83,7 +147,7 @@ void test_create_child_function(void)
   int status;
   char buffer[LINE_MAX];
 
-  CU_ASSERT(create_child(&child));
+  CU_ASSERT(create_child(&child, NULL));
 
   CU_ASSERT(child.pid > 0);
 
@@ -123,7 +187,7 @@ void test_create_child_process(void)
   };
   char buffer[LINE_MAX];
 
-  CU_ASSERT(create_child(&child));
+  CU_ASSERT(create_child(&child, NULL));
 
   CU_ASSERT(write(child.stdin_fd, s1, l1) == l1);
   (void) close(child.stdin_fd);
@@ -136,10 +200,70 @@ void test_create_child_process(void)
   CU_ASSERT(wait_for_death(child.pid, 0, 0));
 }
 
+static int exit_function(void *argument __attribute__((unused)))
+{
+  return 0;
+}
+
+void test_create_child_allocations(void)
+{
+  struct child_process child = {
+    .function = exit_function,
+    .stdin_fd = REDIRECT_PIPE,
+    .stdout_fd = REDIRECT_PIPE,
+    .stderr_fd = REDIRECT_DEV_NULL,
+  };
+  struct alloc_count count;
+  bool result;
+
+  alloc_count_start();
+  result = create_child(&child, NULL);
+  alloc_count_stop(&count);
+
+  CU_ASSERT_FATAL(result);
+
+  /* Allocations of the child are not counted because they happen in another
+   * process.  The parent should not allocate at all. */
+  CU_ASSERT_EQUAL(count.allocations, 0);
+
+  CU_ASSERT(wait_for_death(child.pid, 1, 0));
+  (void) close(child.stdin_fd);
+  (void) close(child.stdout_fd);
+}
+
+static int check_background(void *argument __attribute__((unused)))
+{
+#ifdef SCHED_IDLE
+  if (sched_getscheduler(0) == SCHED_IDLE)
+    return 0;
+#endif
+
+  return getpriority(PRIO_PROCESS, 0) == 19 ? 0 : 1;
+}
+
+void test_create_child_background(void)
+{
+  struct child_process child = {
+    .function = check_background,
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+    .background = true,
+  };
+  int status;
+
+  CU_ASSERT_FATAL(create_child(&child, NULL));
+  CU_ASSERT(waitpid(child.pid, &status, 0) == child.pid);
+  CU_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
 CU_TestInfo process_tests[] = {
   { "test_wait_for_death", test_wait_for_death },
   { "test_ensure_death", test_ensure_death },
+  { "test_ensure_group_death", test_ensure_group_death },
   { "test_create_child_function", test_create_child_function },
   { "test_create_child_process", test_create_child_process },
+  { "test_create_child_allocations", test_create_child_allocations },
+  { "test_create_child_background", test_create_child_background },
   CU_TEST_INFO_NULL,
 };
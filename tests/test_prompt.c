@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/select.h>
+
+#include <CUnit/CUnit.h>
+
+#include "prompt.h"
+
+#include "alloc-count.h"
+#include "test_prompt.h"
+
+/* Feed the given input to stdin and call prompt() with a timeout. */
+static char *prompt_input(const char *input, struct alloc_count *count)
+{
+  struct timespec timeout = { 10, 0 };
+  int saved_stdin = dup(STDIN_FILENO);
+  int input_pipe[2];
+  char *result;
+
+  if (saved_stdin < 0 || pipe(input_pipe) < 0)
+    return NULL;
+
+  (void) write(input_pipe[1], input, strlen(input));
+  (void) close(input_pipe[1]);
+  (void) dup2(input_pipe[0], STDIN_FILENO);
+  (void) close(input_pipe[0]);
+
+  alloc_count_start();
+  result = prompt(NULL, &timeout, NULL);
+  alloc_count_stop(count);
+
+  (void) dup2(saved_stdin, STDIN_FILENO);
+  (void) close(saved_stdin);
+
+  return result;
+}
+
+void test_prompt(void)
+{
+  struct alloc_count count;
+  char *result = prompt_input("secret\n", &count);
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(result);
+  CU_ASSERT_STRING_EQUAL(result, "secret");
+  free(result);
+
+  /* Only the result is allocated, not anything per character. */
+  CU_ASSERT(count.allocations <= 1);
+  CU_ASSERT(count.bytes <= sizeof "secret");
+}
+
+/* An output fd that is always writable. */
+static int watch_fd = -1;
+static int watch_flushes;
+
+static int watch_add_fds(fd_set *fds)
+{
+  FD_SET(watch_fd, fds);
+  return watch_fd + 1;
+}
+
+static void watch_flush(const fd_set *fds)
+{
+  struct timespec nap = { 0, 50000000 };
+
+  (void) fds;
+  (void) nanosleep(&nap, NULL);
+
+  /* Give up after two seconds so a broken timeout cannot hang the tests. */
+  if (++watch_flushes >= 40)
+    prompt_set_output_watch(NULL, NULL);
+}
+
+void test_read_character_timeout(void)
+{
+  struct timespec timeout = { 0, 200000000 };
+  struct timespec start;
+  struct timespec end;
+  int saved_stdin = dup(STDIN_FILENO);
+  int input_pipe[2];
+  int output_pipe[2];
+  GError *err = NULL;
+  long elapsed_ms;
+  char c;
+
+  CU_ASSERT_FATAL(saved_stdin >= 0);
+  CU_ASSERT_FATAL(pipe(input_pipe) == 0);
+  CU_ASSERT_FATAL(pipe(output_pipe) == 0);
+
+  /* No input arrives but the writing end stays open. */
+  (void) dup2(input_pipe[0], STDIN_FILENO);
+  (void) close(input_pipe[0]);
+
+  watch_fd = output_pipe[1];
+  watch_flushes = 0;
+  prompt_set_output_watch(watch_add_fds, watch_flush);
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &start);
+  c = read_character(&timeout, &err);
+  (void) clock_gettime(CLOCK_MONOTONIC, &end);
+
+  prompt_set_output_watch(NULL, NULL);
+
+  elapsed_ms = (end.tv_sec - start.tv_sec) * 1000
+               + (end.tv_nsec - start.tv_nsec) / 1000000;
+
+  CU_ASSERT(c == 0);
+  CU_ASSERT_PTR_NOT_NULL(err);
+  CU_ASSERT(err != NULL && err->code == VLOCK_PROMPT_ERROR_TIMEOUT);
+  g_clear_error(&err);
+
+  /* Flushing output does not restart the timeout. */
+  CU_ASSERT(watch_flushes > 0);
+  CU_ASSERT(elapsed_ms < 1000);
+
+  (void) dup2(saved_stdin, STDIN_FILENO);
+  (void) close(saved_stdin);
+  (void) close(input_pipe[1]);
+  (void) close(output_pipe[0]);
+  (void) close(output_pipe[1]);
+}
+
+CU_TestInfo prompt_tests[] = {
+  { "test_prompt", test_prompt },
+  { "test_read_character_timeout", test_read_character_timeout },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo prompt_tests[];
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "rcfile.h"
+
+#include "test_rcfile.h"
+
+/* Variables assigned by the parser. */
+struct assignments
+{
+  char names[8][32];
+  char values[8][256];
+  bool exported[8];
+  int count;
+};
+
+static const char *lookup(const char *name, void *data)
+{
+  struct assignments *a = data;
+
+  for (int i = a->count - 1; i >= 0; i--)
+    if (strcmp(a->names[i], name) == 0)
+      return a->values[i];
+
+  if (strcmp(name, "GREETING") == 0)
+    return "hello";
+
+  return NULL;
+}
+
+static bool assign(const char *name, const char *value, bool exported,
+                   void *data)
+{
+  struct assignments *a = data;
+
+  if (a->count >= 8)
+    return false;
+
+  snprintf(a->names[a->count], sizeof a->names[0], "%s", name);
+  snprintf(a->values[a->count], sizeof a->values[0], "%s",
+           value ? value : "(null)");
+  a->exported[a->count] = exported;
+  a->count++;
+
+  return true;
+}
+
+static bool parse_string(const char *s, struct assignments *a)
+{
+  FILE *f = fmemopen((void *) s, strlen(s), "r");
+  bool result;
+
+  memset(a, 0, sizeof *a);
+  result = parse_rcfile(f, "test", lookup, assign, a);
+  fclose(f);
+
+  return result;
+}
+
+void test_parse_rcfile_assignments(void)
+{
+  struct assignments a;
+
+  CU_ASSERT(parse_string(
+              "# comment\n"
+              "\n"
+              "  A=plain # trailing comment\n"
+              "B='single $GREETING'\n"
+              "C=\"double $GREETING ${A}\"\n"
+              "D=mixed\\ word\"s\"'!'\n"
+              "export E=\"multi\n"
+              "line\" F=2\n"
+              "G=\"\\$\\\"\\\\\\a\"\n",
+              &a));
+
+  CU_ASSERT_EQUAL(a.count, 7);
+  CU_ASSERT_STRING_EQUAL(a.values[0], "plain");
+  CU_ASSERT_STRING_EQUAL(a.values[1], "single $GREETING");
+  CU_ASSERT_STRING_EQUAL(a.values[2], "double hello plain");
+  CU_ASSERT_STRING_EQUAL(a.values[3], "mixed words!");
+  CU_ASSERT_STRING_EQUAL(a.values[4], "multi\nline");
+  CU_ASSERT(a.exported[4]);
+  CU_ASSERT_STRING_EQUAL(a.names[5], "F");
+  CU_ASSERT(a.exported[5]);
+  CU_ASSERT(!a.exported[0]);
+  CU_ASSERT_STRING_EQUAL(a.values[6], "$\"\\\\a");
+}
+
+void test_parse_rcfile_export(void)
+{
+  struct assignments a;
+
+  CU_ASSERT(parse_string("export A\n", &a));
+  CU_ASSERT_EQUAL(a.count, 1);
+  CU_ASSERT_STRING_EQUAL(a.names[0], "A");
+  CU_ASSERT_STRING_EQUAL(a.values[0], "(null)");
+  CU_ASSERT(a.exported[0]);
+}
+
+void test_parse_rcfile_rejects_commands(void)
+{
+  struct assignments a;
+
+  CU_ASSERT(!parse_string("A=`id`\n", &a));
+  CU_ASSERT(!parse_string("A=\"$(id)\"\n", &a));
+  CU_ASSERT(!parse_string("A=1; rm -rf /\n", &a));
+  CU_ASSERT(!parse_string("echo hello\n", &a));
+  CU_ASSERT(!parse_string("A=${B:-x}\n", &a));
+  CU_ASSERT(!parse_string("A=\"unterminated\n", &a));
+  CU_ASSERT(!parse_string("A=1 cmd\n", &a));
+}
+
+CU_TestInfo rcfile_tests[] = {
+  { "test_parse_rcfile_assignments", test_parse_rcfile_assignments },
+  { "test_parse_rcfile_export", test_parse_rcfile_export },
+  { "test_parse_rcfile_rejects_commands", test_parse_rcfile_rejects_commands },
+  CU_TEST_INFO_NULL,
+};
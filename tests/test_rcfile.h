@@ -0,0 +1 @@
+extern CU_TestInfo rcfile_tests[];
@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+#include <CUnit/CUnit.h>
+
+#include "status.h"
+
+#include "test_status.h"
+
+void test_status_page(void)
+{
+  char directory[] = "/tmp/vlock-test-status.XXXXXX";
+  char path[PATH_MAX];
+  struct vlock_status *mapped;
+  struct vlock_status snapshot;
+  struct vlock_status busy;
+  int fd;
+
+  CU_ASSERT_FATAL(mkdtemp(directory) != NULL);
+  CU_ASSERT_FATAL(status_open(directory));
+
+  snprintf(path, sizeof path, "%s/%d", directory, (int) getpid());
+  fd = open(path, O_RDONLY);
+  CU_ASSERT_FATAL(fd >= 0);
+
+  mapped = mmap(NULL, sizeof *mapped, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  CU_ASSERT_FATAL(mapped != MAP_FAILED);
+
+  CU_ASSERT(vlock_status_read(mapped, &snapshot));
+  CU_ASSERT(snapshot.pid == (uint32_t) getpid());
+  CU_ASSERT(snapshot.state == VLOCK_STATUS_STARTING);
+  CU_ASSERT(snapshot.vt == -1);
+  CU_ASSERT(snapshot.sequence % 2 == 0);
+
+  status_set_mode(VLOCK_STATUS_MODE_ALL);
+  status_set_vt(3);
+  status_set_state(VLOCK_STATUS_LOCKED);
+  status_set_failed_attempts(2);
+  status_set_save_stage(VLOCK_STATUS_SAVE_ACTIVE);
+  status_set_plugins("all new");
+
+  CU_ASSERT(vlock_status_read(mapped, &snapshot));
+  CU_ASSERT(snapshot.state == VLOCK_STATUS_LOCKED);
+  CU_ASSERT(snapshot.mode == VLOCK_STATUS_MODE_ALL);
+  CU_ASSERT(snapshot.vt == 3);
+  CU_ASSERT(snapshot.failed_attempts == 2);
+  CU_ASSERT(snapshot.save_stage == VLOCK_STATUS_SAVE_ACTIVE);
+  CU_ASSERT(snapshot.lock_time != 0);
+  CU_ASSERT_STRING_EQUAL(snapshot.plugins, "all new");
+
+  /* A record in the middle of an update is never returned. */
+  memcpy(&busy, mapped, sizeof busy);
+  busy.sequence++;
+  CU_ASSERT(!vlock_status_read(&busy, &snapshot));
+
+  status_close();
+  CU_ASSERT(access(path, F_OK) != 0);
+
+  munmap(mapped, sizeof *mapped);
+  rmdir(directory);
+}
+
+CU_TestInfo status_tests[] = {
+  { "test_status_page", test_status_page },
+  CU_TEST_INFO_NULL,
+};
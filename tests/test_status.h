@@ -0,0 +1 @@
+extern CU_TestInfo status_tests[];
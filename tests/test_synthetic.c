@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "plugin.h"
+#include "synthetic.h"
+
+#include "test_synthetic.h"
+
+static bool load_spec(const char *spec, GError **error)
+{
+  FILE *f = fmemopen((void *) spec, strlen(spec), "r");
+  bool result;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(f);
+
+  result = vlock_synthetic_load_spec(f, "spec", error);
+  (void) fclose(f);
+
+  return result;
+}
+
+static size_t count_dependencies(VlockPlugin *p, size_t dependency)
+{
+  size_t n = 0;
+
+  while (p->dependencies[dependency] != NULL
+         && p->dependencies[dependency][n] != NULL)
+    n++;
+
+  return n;
+}
+
+void test_synthetic_load_spec(void)
+{
+  GError *err = NULL;
+  VlockPlugin *p;
+
+  CU_ASSERT(load_spec("# comment\n"
+                      "\n"
+                      "a requires=b,c vlock_save=10\n"
+                      "b\tsucceeds=c\n",
+                      &err));
+  CU_ASSERT_PTR_NULL(err);
+
+  /* c is only named as a dependency. */
+  CU_ASSERT_EQUAL(vlock_synthetic_count(), 2);
+  CU_ASSERT_STRING_EQUAL(vlock_synthetic_get_name(0), "a");
+  CU_ASSERT_STRING_EQUAL(vlock_synthetic_get_name(1), "b");
+
+  p = vlock_plugin_new(TYPE_VLOCK_SYNTHETIC, "a");
+  CU_ASSERT(vlock_plugin_open(p, NULL));
+  CU_ASSERT_STRING_EQUAL(p->dependencies[2][0], "b");
+  CU_ASSERT_STRING_EQUAL(p->dependencies[2][1], "c");
+  CU_ASSERT_PTR_NULL(p->dependencies[2][2]);
+
+  vlock_synthetic_hook_calls = 0;
+  CU_ASSERT(vlock_plugin_call_hook(p, "vlock_save"));
+  CU_ASSERT_EQUAL(vlock_synthetic_hook_calls, 1);
+  vlock_plugin_unref(p);
+
+  p = vlock_plugin_new(TYPE_VLOCK_SYNTHETIC, "c");
+  CU_ASSERT(!vlock_plugin_open(p, &err));
+  CU_ASSERT(g_error_matches(err, VLOCK_PLUGIN_ERROR,
+                            VLOCK_PLUGIN_ERROR_NOT_FOUND));
+  g_clear_error(&err);
+  vlock_plugin_unref(p);
+
+  CU_ASSERT(!load_spec("a\nb bogus=c\n", &err));
+  CU_ASSERT_PTR_NOT_NULL(err);
+  CU_ASSERT_PTR_NOT_NULL(strstr(err->message, "spec:2:"));
+  g_clear_error(&err);
+
+  CU_ASSERT(!load_spec("a vlock_save=soon\n", &err));
+  CU_ASSERT_PTR_NOT_NULL(err);
+  g_clear_error(&err);
+
+  vlock_synthetic_clear();
+  CU_ASSERT_EQUAL(vlock_synthetic_count(), 0);
+}
+
+void test_synthetic_generate(void)
+{
+  const struct vlock_synthetic_graph graph = {
+    .succeeds = 1.5,
+    .requires = 0.5,
+    .depends = 0.5,
+    .conflicts = 0.5,
+    .seed = 42,
+  };
+  size_t nr_edges[nr_dependencies] = { 0 };
+  bool acyclic = true;
+
+  vlock_synthetic_generate(1000, &graph);
+  CU_ASSERT_EQUAL(vlock_synthetic_count(), 1000);
+
+  for (size_t i = 0; i < 1000; i++) {
+    const char *name = vlock_synthetic_get_name(i);
+    VlockPlugin *p = vlock_plugin_new(TYPE_VLOCK_SYNTHETIC, name);
+
+    CU_ASSERT(vlock_plugin_open(p, NULL));
+
+    for (size_t d = 0; d < nr_dependencies; d++) {
+      nr_edges[d] += count_dependencies(p, d);
+
+      /* Edges only point to plugins with smaller numbers. */
+      for (size_t k = 0; k < count_dependencies(p, d); k++)
+        if (p->dependencies[d][k][0] == 'p'
+            && strtoul(p->dependencies[d][k] + 1, NULL, 10) >= i)
+          acyclic = false;
+    }
+
+    vlock_plugin_unref(p);
+  }
+
+  CU_ASSERT(acyclic);
+
+  /* succeeds, requires, depends and conflicts; roughly the averages. */
+  CU_ASSERT(nr_edges[0] > 1300 && nr_edges[0] < 1700);
+  CU_ASSERT(nr_edges[2] > 400 && nr_edges[2] < 600);
+  CU_ASSERT(nr_edges[4] > 400 && nr_edges[4] < 600);
+  CU_ASSERT(nr_edges[5] > 400 && nr_edges[5] < 600);
+
+  vlock_synthetic_clear();
+}
+
+CU_TestInfo synthetic_tests[] = {
+  { "test_synthetic_load_spec", test_synthetic_load_spec },
+  { "test_synthetic_generate", test_synthetic_generate },
+  CU_TEST_INFO_NULL,
+};
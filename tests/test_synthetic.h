@@ -0,0 +1 @@
+extern CU_TestInfo synthetic_tests[];
@@ -1,11 +1,10 @@
 #include <stdlib.h>
 
-#include <glib.h>
-
 #include <CUnit/CUnit.h>
 
 #include "tsort.h"
 
+#include "alloc-count.h"
 #include "test_tsort.h"
 
 #define A ((void *)1)
@@ -17,25 +16,19 @@
 #define G ((void *)7)
 #define H ((void *)8)
 
-GList *get_test_list(void)
+#define NR_NODES 8
+
+void get_test_list(void **list)
 {
-  GList *list = NULL;
-
-  list = g_list_prepend(list, A);
-  list = g_list_prepend(list, B);
-  list = g_list_prepend(list, C);
-  list = g_list_prepend(list, D);
-  list = g_list_prepend(list, E);
-  list = g_list_prepend(list, F);
-  list = g_list_prepend(list, G);
-  list = g_list_prepend(list, H);
-
-  return list;
+  void *nodes[NR_NODES] = { H, G, F, E, D, C, B, A };
+
+  for (size_t i = 0; i < NR_NODES; i++)
+    list[i] = nodes[i];
 }
 
-GList *get_test_edges(void)
+size_t get_test_edges(struct edge *edges)
 {
-  GList *edges = NULL;
+  size_t nr_edges = 0;
 
   /* Edges:
    *
@@ -45,18 +38,18 @@ GList *get_test_edges(void)
    *   \|/    |
    *    A   F G
    */
-  edges = g_list_append(edges, make_edge(A, B));
-  edges = g_list_append(edges, make_edge(A, C));
-  edges = g_list_append(edges, make_edge(A, D));
-  edges = g_list_append(edges, make_edge(B, E));
-  edges = g_list_append(edges, make_edge(G, H));
+  edges[nr_edges++] = (struct edge) { A, B };
+  edges[nr_edges++] = (struct edge) { A, C };
+  edges[nr_edges++] = (struct edge) { A, D };
+  edges[nr_edges++] = (struct edge) { B, E };
+  edges[nr_edges++] = (struct edge) { G, H };
 
-  return edges;  
+  return nr_edges;
 }
 
-GList *get_faulty_test_edges(void)
+size_t get_faulty_test_edges(struct edge *edges)
 {
-  GList *edges = NULL;
+  size_t nr_edges = 0;
 
   /* Edges:
    *
@@ -72,67 +65,120 @@ GList *get_faulty_test_edges(void)
    *
    */
 
-  edges = g_list_append(edges, make_edge(A, B));
-  edges = g_list_append(edges, make_edge(A, C));
-  edges = g_list_append(edges, make_edge(A, D));
-  edges = g_list_append(edges, make_edge(B, E));
-  edges = g_list_append(edges, make_edge(E, F));
-  edges = g_list_append(edges, make_edge(F, A));
-  edges = g_list_append(edges, make_edge(G, H));
+  edges[nr_edges++] = (struct edge) { A, B };
+  edges[nr_edges++] = (struct edge) { A, C };
+  edges[nr_edges++] = (struct edge) { A, D };
+  edges[nr_edges++] = (struct edge) { B, E };
+  edges[nr_edges++] = (struct edge) { E, F };
+  edges[nr_edges++] = (struct edge) { F, A };
+  edges[nr_edges++] = (struct edge) { G, H };
+
+  return nr_edges;
+}
+
+static size_t index_of(void **list, void *node)
+{
+  size_t i;
+
+  for (i = 0; i < NR_NODES; i++)
+    if (list[i] == node)
+      break;
 
-  return edges;
+  return i;
 }
 
 void test_tsort_succeed(void)
 {
-  GList *list = get_test_list();
-  GList *edges = get_test_edges();
-  GList *sorted_list = tsort(list, &edges);
+  void *list[NR_NODES];
+  void *sorted_list[NR_NODES];
+  struct edge edges[16];
+  size_t nr_edges = get_test_edges(edges);
 
-  CU_ASSERT_PTR_NULL(edges);
+  get_test_list(list);
+  get_test_list(sorted_list);
 
-  CU_ASSERT_PTR_NOT_NULL(sorted_list);
+  CU_ASSERT(tsort(sorted_list, NR_NODES, edges, &nr_edges));
 
-  CU_ASSERT_EQUAL(g_list_length(list), g_list_length(sorted_list));
+  CU_ASSERT_EQUAL(nr_edges, 0);
 
   /* Check that all items from the original list are in the sorted list. */
-  for (GList *item = list; item != NULL; item = g_list_next(item))
-    CU_ASSERT_PTR_NOT_NULL(g_list_find(sorted_list, item->data));
+  for (size_t i = 0; i < NR_NODES; i++)
+    CU_ASSERT(index_of(sorted_list, list[i]) < NR_NODES);
 
   /* Check that all items are in the order that is given by the edges. */
-  edges = get_test_edges();
-
-  while (edges != NULL) {
-    struct edge *e = edges->data;
-    CU_ASSERT(g_list_index(sorted_list, e->predecessor) < g_list_index(sorted_list, e->successor));
-    free(e);
-    edges = g_list_delete_link(edges, edges);
-  }
+  nr_edges = get_test_edges(edges);
 
-  g_list_free(sorted_list);
-  g_list_free(list);
+  for (size_t i = 0; i < nr_edges; i++)
+    CU_ASSERT(index_of(sorted_list, edges[i].predecessor)
+              < index_of(sorted_list, edges[i].successor));
 }
 
 void test_tsort_fail(void)
 {
-  GList *list = get_test_list();
-  GList *edges = get_faulty_test_edges();
-  GList *sorted_list = tsort(list, &edges);
+  void *list[NR_NODES];
+  void *sorted_list[NR_NODES];
+  struct edge edges[16];
+  size_t nr_edges = get_faulty_test_edges(edges);
+
+  get_test_list(list);
+  get_test_list(sorted_list);
+
+  CU_ASSERT(!tsort(sorted_list, NR_NODES, edges, &nr_edges));
+
+  CU_ASSERT(nr_edges > 0);
+
+  /* The nodes are left untouched. */
+  for (size_t i = 0; i < NR_NODES; i++)
+    CU_ASSERT_PTR_EQUAL(sorted_list[i], list[i]);
+}
+
+void test_tsort_allocations(void)
+{
+  void *list[NR_NODES];
+  struct edge edges[16];
+  size_t nr_edges = get_test_edges(edges);
+  struct alloc_count count;
+
+  get_test_list(list);
+
+  alloc_count_start();
+  CU_ASSERT(tsort(list, NR_NODES, edges, &nr_edges));
+  alloc_count_stop(&count);
+
+  /* One block that is linear in the number of nodes and edges. */
+  CU_ASSERT(count.allocations <= 1);
+  CU_ASSERT(count.bytes <= NR_NODES * sizeof (void *)
+                           + (6 * NR_NODES + 5) * sizeof (size_t));
+}
+
+void test_tsort_missing_node(void)
+{
+  void *list[NR_NODES];
+  void *sorted_list[NR_NODES];
+  struct edge edges[16];
+  size_t nr_edges = get_test_edges(edges);
+
+  get_test_list(list);
+  get_test_list(sorted_list);
 
-  CU_ASSERT_PTR_NULL(sorted_list);
+  /* An edge to a node that is not in the graph. */
+  edges[nr_edges++] = (struct edge) { C, (void *)9 };
 
-  CU_ASSERT(edges != NULL);
+  CU_ASSERT(!tsort(sorted_list, NR_NODES, edges, &nr_edges));
 
-  while (edges != NULL) {
-    free(edges->data);
-    edges = g_list_delete_link(edges, edges);
-  }
+  /* Only the erroneous edge is left. */
+  CU_ASSERT_FATAL(nr_edges == 1);
+  CU_ASSERT_PTR_EQUAL(edges[0].predecessor, C);
+  CU_ASSERT_PTR_EQUAL(edges[0].successor, (void *)9);
 
-  g_list_free(list);
+  for (size_t i = 0; i < NR_NODES; i++)
+    CU_ASSERT_PTR_EQUAL(sorted_list[i], list[i]);
 }
 
 CU_TestInfo tsort_tests[] = {
   { "test_tsort_succeed", test_tsort_succeed },
   { "test_tsort_fail", test_tsort_fail },
+  { "test_tsort_allocations", test_tsort_allocations },
+  { "test_tsort_missing_node", test_tsort_missing_node },
   CU_TEST_INFO_NULL,
 };
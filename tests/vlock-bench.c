@@ -0,0 +1,560 @@
+/* vlock-bench.c -- microbenchmarks for vlock,
+ *                  the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Every benchmark is first calibrated so that one sample takes at least the
+ * minimum sample time.  Then the given number of samples is taken and the
+ * minimum, median, mean and standard deviation of the time per operation are
+ * reported.  A table is printed to stderr and the results are written as
+ * JSON to stdout or the given file. */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <glib.h>
+
+#include "tsort.h"
+#include "util.h"
+#include "process.h"
+#include "prompt.h"
+#include "plugins.h"
+
+#include "synthetic.h"
+
+struct result
+{
+  char name[64];
+  unsigned long iterations;
+  double min;
+  double median;
+  double mean;
+  double stddev;
+};
+
+static int repetitions = 10;
+static double min_sample_ms = 20.0;
+static size_t max_plugins = 1000;
+static const char *filter;
+
+static struct result *results;
+static size_t nr_results;
+
+static double now_ns(void)
+{
+  struct timespec t;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static double time_iterations(void (*function)(void *), void *argument,
+                              unsigned long iterations)
+{
+  double start = now_ns();
+
+  for (unsigned long i = 0; i < iterations; i++)
+    function(argument);
+
+  return now_ns() - start;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+/* Measure the function.  Every call performs ops operations. */
+static void run_benchmark(const char *name, void (*function)(void *),
+                          void *argument, unsigned long ops)
+{
+  unsigned long iterations = 1;
+  double samples[repetitions];
+  double sum = 0;
+  double squares = 0;
+  struct result *r;
+
+  if (filter != NULL && strstr(name, filter) == NULL)
+    return;
+
+  /* Warm up and calibrate. */
+  while (time_iterations(function, argument, iterations) < min_sample_ms * 1e6
+         && iterations < (1UL << 30))
+    iterations *= 2;
+
+  for (int i = 0; i < repetitions; i++) {
+    samples[i] = time_iterations(function, argument, iterations)
+                 / ((double) iterations * ops);
+    sum += samples[i];
+  }
+
+  results = g_renew(struct result, results, nr_results + 1);
+  r = &results[nr_results++];
+
+  snprintf(r->name, sizeof r->name, "%s", name);
+  r->iterations = iterations * ops;
+  r->mean = sum / repetitions;
+
+  for (int i = 0; i < repetitions; i++)
+    squares += (samples[i] - r->mean) * (samples[i] - r->mean);
+
+  r->stddev = repetitions > 1 ? sqrt(squares / (repetitions - 1)) : 0;
+
+  qsort(samples, repetitions, sizeof samples[0], compare_doubles);
+  r->min = samples[0];
+  r->median = samples[repetitions / 2];
+
+  fprintf(stderr, "%-40s %12.1f %12.1f %12.1f %10.1f\n", r->name, r->min,
+          r->median, r->mean, r->stddev);
+}
+
+/*********/
+/* tsort */
+/*********/
+
+#define MAX_NODES 64
+#define MAX_EDGES (2 * MAX_NODES)
+
+struct graph
+{
+  void *nodes[MAX_NODES];
+  size_t nr_nodes;
+  struct edge edges[MAX_EDGES];
+  size_t nr_edges;
+};
+
+#define NODE(i) ((void *) (uintptr_t) ((i) + 1))
+
+/* Nodes are given in reverse order so that sorting has to do some work. */
+static void make_graph(struct graph *g, const char *shape, size_t nr_nodes)
+{
+  size_t width = 1;
+
+  while (width * width < nr_nodes)
+    width++;
+
+  g->nr_nodes = nr_nodes;
+  g->nr_edges = 0;
+
+  for (size_t i = 0; i < nr_nodes; i++)
+    g->nodes[i] = NODE(nr_nodes - i - 1);
+
+  for (size_t i = 0; i < nr_nodes; i++) {
+    if (strcmp(shape, "chain") == 0 && i > 0) {
+      g->edges[g->nr_edges++] = (struct edge) { NODE(i - 1), NODE(i) };
+    } else if (strcmp(shape, "star") == 0 && i > 0) {
+      g->edges[g->nr_edges++] = (struct edge) { NODE(0), NODE(i) };
+    } else if (strcmp(shape, "layered") == 0 && i + width < nr_nodes) {
+      /* Each node precedes two nodes of the next layer. */
+      size_t next = i + width;
+      size_t neighbour = (i / width + 1) * width + (i + 1) % width;
+
+      g->edges[g->nr_edges++] = (struct edge) { NODE(i), NODE(next) };
+
+      if (neighbour < nr_nodes && neighbour != next)
+        g->edges[g->nr_edges++] = (struct edge) { NODE(i), NODE(neighbour) };
+    }
+  }
+}
+
+static void bench_tsort(void *argument)
+{
+  const struct graph *template = argument;
+  struct graph g;
+
+  /* tsort() works in place. */
+  memcpy(g.nodes, template->nodes, template->nr_nodes * sizeof g.nodes[0]);
+  memcpy(g.edges, template->edges, template->nr_edges * sizeof g.edges[0]);
+  g.nr_edges = template->nr_edges;
+
+  if (!tsort(g.nodes, template->nr_nodes, g.edges, &g.nr_edges))
+    abort();
+}
+
+static void tsort_benchmarks(void)
+{
+  const char *shapes[] = { "empty", "chain", "star", "layered" };
+  const size_t sizes[] = { 8, 64 };
+
+  for (size_t i = 0; i < sizeof shapes / sizeof shapes[0]; i++)
+    for (size_t j = 0; j < sizeof sizes / sizeof sizes[0]; j++) {
+      struct graph g;
+      char name[64];
+
+      make_graph(&g, shapes[i], sizes[j]);
+      snprintf(name, sizeof name, "tsort/%s/%zu", shapes[i], sizes[j]);
+      run_benchmark(name, bench_tsort, &g, 1);
+    }
+}
+
+/***********/
+/* plugins */
+/***********/
+
+struct plugin_set
+{
+  size_t nr_plugins;
+  char names[MAX_NODES][24];
+};
+
+/* Define synthetic plugins whose "succeeds" dependencies form the graph of
+ * the given shape. */
+static void define_plugins(struct plugin_set *set, const char *shape,
+                           size_t nr_plugins)
+{
+  struct graph g;
+
+  make_graph(&g, shape, nr_plugins);
+  vlock_synthetic_clear();
+  set->nr_plugins = nr_plugins;
+
+  for (size_t i = 0; i < nr_plugins; i++) {
+    snprintf(set->names[i], sizeof set->names[i], "p%zu", i);
+    vlock_synthetic_define(set->names[i]);
+  }
+
+  for (size_t i = 0; i < g.nr_edges; i++) {
+    uintptr_t predecessor = (uintptr_t) g.edges[i].predecessor - 1;
+    uintptr_t successor = (uintptr_t) g.edges[i].successor - 1;
+
+    vlock_synthetic_add_dependency(set->names[successor], "succeeds",
+                                   set->names[predecessor]);
+  }
+}
+
+static void load_plugins(const struct plugin_set *set)
+{
+  for (size_t i = 0; i < set->nr_plugins; i++)
+    if (!load_plugin(set->names[i], NULL))
+      abort();
+
+  if (!resolve_dependencies(NULL))
+    abort();
+}
+
+static void bench_resolve(void *argument)
+{
+  load_plugins(argument);
+  unload_plugins();
+}
+
+static void bench_hook(void *argument __attribute__((unused)))
+{
+  plugin_hook("vlock_save");
+}
+
+static void plugin_benchmarks(void)
+{
+  struct plugin_set set;
+  const char *shapes[] = { "empty", "chain", "layered" };
+  const size_t sizes[] = { 8, 64 };
+  const size_t hook_sizes[] = { 1, 8, 64 };
+  char name[64];
+
+  for (size_t i = 0; i < sizeof shapes / sizeof shapes[0]; i++)
+    for (size_t j = 0; j < sizeof sizes / sizeof sizes[0]; j++) {
+      define_plugins(&set, shapes[i], sizes[j]);
+      snprintf(name, sizeof name, "plugins/load+resolve/%s/%zu", shapes[i],
+               sizes[j]);
+      run_benchmark(name, bench_resolve, &set, 1);
+    }
+
+  /* Reported per plugin. */
+  for (size_t i = 0; i < sizeof hook_sizes / sizeof hook_sizes[0]; i++) {
+    define_plugins(&set, "empty", hook_sizes[i]);
+    load_plugins(&set);
+    snprintf(name, sizeof name, "plugins/hook-per-plugin/%zu", hook_sizes[i]);
+    run_benchmark(name, bench_hook, NULL, hook_sizes[i]);
+    unload_plugins();
+  }
+
+  vlock_synthetic_clear();
+}
+
+/* Load all defined plugins. */
+static void bench_resolve_all(void *argument __attribute__((unused)))
+{
+  for (size_t i = 0, n = vlock_synthetic_count(); i < n; i++)
+    if (!load_plugin(vlock_synthetic_get_name(i), NULL))
+      abort();
+
+  if (!resolve_dependencies(NULL))
+    abort();
+
+  unload_plugins();
+}
+
+/* Random plugin graphs of growing size.  Sizes above the maximum given with
+ * -p are skipped to keep the default run short. */
+static void scaling_benchmarks(void)
+{
+  const struct vlock_synthetic_graph graph = {
+    .succeeds = 1.0,
+    .requires = 0.5,
+    .depends = 0.5,
+    .conflicts = 0.25,
+    .seed = 1,
+  };
+  const size_t sizes[] = { 10, 1000, 100000 };
+  char name[64];
+
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+    if (sizes[i] > max_plugins)
+      break;
+
+    vlock_synthetic_generate(sizes[i], &graph);
+
+    snprintf(name, sizeof name, "plugins/random/load+resolve/%zu", sizes[i]);
+    run_benchmark(name, bench_resolve_all, NULL, 1);
+
+    for (size_t j = 0; j < sizes[i]; j++)
+      if (!load_plugin(vlock_synthetic_get_name(j), NULL))
+        abort();
+
+    if (!resolve_dependencies(NULL))
+      abort();
+
+    /* Reported per plugin. */
+    snprintf(name, sizeof name, "plugins/random/hook-per-plugin/%zu",
+             sizes[i]);
+    run_benchmark(name, bench_hook, NULL, sizes[i]);
+
+    unload_plugins();
+    vlock_synthetic_clear();
+  }
+}
+
+/***********/
+/* process */
+/***********/
+
+static int exit_function(void *argument __attribute__((unused)))
+{
+  return 0;
+}
+
+/* Block until stdin is closed. */
+static int block_function(void *argument __attribute__((unused)))
+{
+  char c;
+
+  while (read(STDIN_FILENO, &c, 1) > 0)
+    ;
+
+  return 0;
+}
+
+static void bench_create_child_wait(void *argument __attribute__((unused)))
+{
+  struct child_process child = {
+    .function = exit_function,
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+  };
+
+  if (!create_child(&child, NULL) || !wait_for_death(child.pid, 1, 0))
+    abort();
+}
+
+static void bench_create_child_ensure_death(void *argument
+                                            __attribute__((unused)))
+{
+  struct child_process child = {
+    .function = block_function,
+    .stdin_fd = REDIRECT_PIPE,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+  };
+
+  if (!create_child(&child, NULL))
+    abort();
+
+  ensure_death(child.pid);
+  (void) close(child.stdin_fd);
+}
+
+static void process_benchmarks(void)
+{
+  run_benchmark("process/create_child+wait_for_death",
+                bench_create_child_wait, NULL, 1);
+  run_benchmark("process/create_child+ensure_death",
+                bench_create_child_ensure_death, NULL, 1);
+}
+
+/********/
+/* util */
+/********/
+
+static void bench_parse_seconds(void *argument)
+{
+  free(parse_seconds(argument));
+}
+
+static void util_benchmarks(void)
+{
+  run_benchmark("util/parse_seconds/valid", bench_parse_seconds, "300", 1);
+  run_benchmark("util/parse_seconds/invalid", bench_parse_seconds, "5min", 1);
+}
+
+/**********/
+/* prompt */
+/**********/
+
+struct prompt_input
+{
+  int fd;
+  const char *input;
+  struct timespec *timeout;
+};
+
+static void bench_prompt(void *argument)
+{
+  struct prompt_input *p = argument;
+  size_t length = strlen(p->input);
+  char *result;
+
+  if (write(p->fd, p->input, length) != (ssize_t) length)
+    abort();
+
+  if ((result = prompt(NULL, p->timeout, NULL)) == NULL)
+    abort();
+
+  free(result);
+}
+
+static void prompt_benchmarks(void)
+{
+  struct timespec timeout = { 10, 0 };
+  struct prompt_input p = { -1, "password\n", NULL };
+  int saved_stdin = dup(STDIN_FILENO);
+  int input_pipe[2];
+
+  if (saved_stdin < 0 || pipe(input_pipe) < 0) {
+    perror("vlock-bench: could not create pipe");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Read from the pipe instead of a terminal. */
+  (void) dup2(input_pipe[0], STDIN_FILENO);
+  (void) close(input_pipe[0]);
+  p.fd = input_pipe[1];
+
+  run_benchmark("prompt/pipe/password", bench_prompt, &p, 1);
+
+  p.timeout = &timeout;
+  run_benchmark("prompt/pipe/password+timeout", bench_prompt, &p, 1);
+
+  (void) close(input_pipe[1]);
+  (void) dup2(saved_stdin, STDIN_FILENO);
+  (void) close(saved_stdin);
+}
+
+/********/
+/* main */
+/********/
+
+static void write_json(FILE *f)
+{
+  fprintf(f, "{\n");
+  fprintf(f, "  \"unit\": \"ns/op\",\n");
+  fprintf(f, "  \"repetitions\": %d,\n", repetitions);
+  fprintf(f, "  \"min_sample_ms\": %.1f,\n", min_sample_ms);
+  fprintf(f, "  \"timestamp\": %ld,\n", (long) time(NULL));
+  fprintf(f, "  \"benchmarks\": [");
+
+  for (size_t i = 0; i < nr_results; i++) {
+    struct result *r = &results[i];
+
+    fprintf(f, "%s\n    {\"name\": \"%s\", \"iterations\": %lu, "
+            "\"min\": %.2f, \"median\": %.2f, \"mean\": %.2f, "
+            "\"stddev\": %.2f}", i > 0 ? "," : "", r->name, r->iterations,
+            r->min, r->median, r->mean, r->stddev);
+  }
+
+  fprintf(f, "\n  ]\n}\n");
+}
+
+static void usage(void)
+{
+  fputs("usage: vlock-bench [-r repetitions] [-t min-sample-ms] "
+        "[-p max-plugins] [-f filter] [-o file]\n", stderr);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *output = NULL;
+  FILE *f = stdout;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:t:p:f:o:")) != -1) {
+    switch (opt) {
+      case 'r':
+        repetitions = atoi(optarg);
+        break;
+      case 't':
+        min_sample_ms = atof(optarg);
+        break;
+      case 'p':
+        max_plugins = strtoul(optarg, NULL, 10);
+        break;
+      case 'f':
+        filter = optarg;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        usage();
+    }
+  }
+
+  if (optind != argc || repetitions < 1 || min_sample_ms <= 0)
+    usage();
+
+  fprintf(stderr, "%-40s %12s %12s %12s %10s\n", "benchmark (ns/op)", "min",
+          "median", "mean", "stddev");
+
+  tsort_benchmarks();
+  plugin_benchmarks();
+  scaling_benchmarks();
+  process_benchmarks();
+  util_benchmarks();
+  prompt_benchmarks();
+
+  if (output != NULL && (f = fopen(output, "w")) == NULL) {
+    perror("vlock-bench: could not open output file");
+    exit(EXIT_FAILURE);
+  }
+
+  write_json(f);
+
+  if (f != stdout && fclose(f) != 0) {
+    perror("vlock-bench: could not write output file");
+    exit(EXIT_FAILURE);
+  }
+
+  g_free(results);
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,563 @@
+/* vlock-e2e.c -- end-to-end latency tests for vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Runs vlock-main on a pseudo terminal, types the keystrokes a user would
+ * type and measures how long it takes until
+ *
+ *   terminal-secured vlock-main secured the terminal after it started, as
+ *                    reported by vlock-main itself,
+ *   lock-engaged     the lock message is shown after starting vlock-main,
+ *   wake-shown       the lock message is shown again after pressing escape
+ *                    to start the screen saver and then another key,
+ *   prompt-shown     the password prompt is shown after pressing enter,
+ *   unlock-complete  vlock-main exited after the password was entered.
+ *
+ * This is done for each given plugin combination.  The medians are compared
+ * with the baselines from a file with lines of the form
+ *
+ *   <combination> <phase> <milliseconds>
+ *
+ * and the program fails if one of them exceeds its baseline by more than
+ * the tolerance factor and a small absolute slack.  The password database is replaced by a preloaded
+ * stand-in library, see e2e-standin.c.
+ *
+ * Every run also checks the counters vlock-main prints with VLOCK_DEBUG set:
+ * while the terminal is locked and idle no process may be spawned and the
+ * only wakeups allowed are the key presses that end the idle phases. */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define E2E_PASSWORD "vlock-e2e"
+#define LOCK_MESSAGE "vlock-e2e: locked"
+#define PROMPT "Password: "
+
+/* How long to wait for each phase. */
+#define PHASE_TIMEOUT_MS 10000
+/* vlock-main discards everything that was typed before the password prompt
+ * was set up, so wait this long before typing like a user would. */
+#define TYPING_DELAY_MS 20
+
+/* Differences below this are scheduling noise and never a regression. */
+#define SLACK_MS 1.0
+
+/* Budget of the locked-idle phase.  One escape and one enter are typed while
+ * idle. */
+#define IDLE_SPAWNS 0
+#define IDLE_WAKEUPS 2
+
+enum
+{
+  TERMINAL_SECURED,
+  LOCK_ENGAGED,
+  WAKE_SHOWN,
+  PROMPT_SHOWN,
+  UNLOCK_COMPLETE,
+  NR_PHASES
+};
+
+static const char *phase_names[NR_PHASES] = {
+  "terminal-secured",
+  "lock-engaged",
+  "wake-shown",
+  "prompt-shown",
+  "unlock-complete",
+};
+
+/* A running vlock-main. */
+struct session
+{
+  pid_t pid;
+  int master;
+  /* Output that was not yet matched. */
+  char output[4096];
+  size_t length;
+};
+
+static const char *preload;
+
+/* Written to by the SIGCHLD handler. */
+static int sigchld_pipe[2];
+
+static void sigchld_handler(int signum __attribute__((unused)))
+{
+  int errsv = errno;
+  (void) write(sigchld_pipe[1], "", 1);
+  errno = errsv;
+}
+
+static double now_ms(void)
+{
+  struct timespec t;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+/* Start vlock-main with the given plugins on a new pseudo terminal. */
+static bool start_session(struct session *s, const char *vlock_main,
+                          char *const plugins[])
+{
+  char *slave_name;
+
+  s->length = 0;
+  s->master = posix_openpt(O_RDWR | O_NOCTTY);
+
+  if (s->master < 0 || grantpt(s->master) < 0 || unlockpt(s->master) < 0
+      || (slave_name = ptsname(s->master)) == NULL) {
+    perror("vlock-e2e: could not allocate a pseudo terminal");
+    return false;
+  }
+
+  s->pid = fork();
+
+  if (s->pid == 0) {
+    int slave;
+    size_t nr_plugins = 0;
+
+    while (plugins[nr_plugins] != NULL)
+      nr_plugins++;
+
+    char *argv[nr_plugins + 2];
+
+    /* Make the pseudo terminal the controlling terminal. */
+    (void) setsid();
+
+    if ((slave = open(slave_name, O_RDWR)) < 0)
+      _exit(127);
+
+    (void) dup2(slave, STDIN_FILENO);
+    (void) dup2(slave, STDOUT_FILENO);
+    (void) dup2(slave, STDERR_FILENO);
+
+    if (slave > STDERR_FILENO)
+      (void) close(slave);
+
+    (void) close(s->master);
+
+    (void) setenv("VLOCK_MESSAGE", LOCK_MESSAGE, 1);
+    (void) setenv("VLOCK_DEBUG", "1", 1);
+    (void) unsetenv("VLOCK_TIMEOUT");
+    (void) unsetenv("VLOCK_PROMPT_TIMEOUT");
+
+    if (preload != NULL)
+      (void) setenv("LD_PRELOAD", preload, 1);
+
+    argv[0] = (char *) vlock_main;
+    memcpy(argv + 1, plugins, (nr_plugins + 1) * sizeof argv[0]);
+
+    (void) execv(vlock_main, argv);
+    _exit(127);
+  } else if (s->pid < 0) {
+    perror("vlock-e2e: could not fork");
+    (void) close(s->master);
+    return false;
+  }
+
+  return true;
+}
+
+/* Read from the terminal until the output contains the given string or
+ * vlock-main exits.  If string is NULL wait for vlock-main to exit
+ * successfully. */
+static bool wait_for(struct session *s, const char *string)
+{
+  double deadline = now_ms() + PHASE_TIMEOUT_MS;
+
+  for (;;) {
+    struct pollfd fds[2] = {
+      { s->master, POLLIN, 0 },
+      { sigchld_pipe[0], POLLIN, 0 },
+    };
+    int timeout = (int) (deadline - now_ms());
+    int status;
+
+    if (string != NULL && memmem(s->output, s->length, string,
+                                 strlen(string)) != NULL) {
+      s->length = 0;
+      return true;
+    }
+
+    if (timeout <= 0) {
+      fprintf(stderr, "vlock-e2e: timeout waiting for %s\n",
+              string != NULL ? string : "vlock-main to exit");
+      fprintf(stderr, "vlock-e2e: output: %.*s\n", (int) s->length,
+              s->output);
+      return false;
+    }
+
+    if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+      perror("vlock-e2e: poll failed");
+      return false;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      ssize_t length;
+
+      /* Keep the tail of the output if the buffer is full. */
+      if (s->length == sizeof s->output) {
+        memmove(s->output, s->output + sizeof s->output / 2,
+                sizeof s->output / 2);
+        s->length = sizeof s->output / 2;
+      }
+
+      length = read(s->master, s->output + s->length,
+                    sizeof s->output - s->length);
+
+      if (length > 0)
+        s->length += length;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char buffer[64];
+      (void) read(sigchld_pipe[0], buffer, sizeof buffer);
+    }
+
+    if (waitpid(s->pid, &status, WNOHANG) == s->pid) {
+      ssize_t length;
+
+      s->pid = -1;
+
+      /* Collect what was written right before the exit. */
+      while (s->length < sizeof s->output
+             && poll(fds, 1, 0) > 0 && (fds[0].revents & POLLIN)
+             && (length = read(s->master, s->output + s->length,
+                               sizeof s->output - s->length)) > 0)
+        s->length += length;
+
+      if (string == NULL && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        return true;
+
+      fprintf(stderr, "vlock-e2e: vlock-main exited unexpectedly\n");
+      fprintf(stderr, "vlock-e2e: output: %.*s\n", (int) s->length,
+              s->output);
+      return false;
+    }
+  }
+}
+
+/* Check the counters of the locked-idle phase in the output. */
+static bool check_idle_budget(const struct session *s)
+{
+  const char *marker = "vlock: counters locked-idle ";
+  char line[256];
+  const char *p = memmem(s->output, s->length, marker, strlen(marker));
+  unsigned long spawns;
+  unsigned long wakeups;
+
+  if (p == NULL) {
+    fprintf(stderr, "vlock-e2e: vlock-main did not print its counters\n");
+    return false;
+  }
+
+  snprintf(line, sizeof line, "%.*s",
+           (int) (s->output + s->length - p), p);
+  line[strcspn(line, "\r\n")] = '\0';
+
+  if (sscanf(line, "vlock: counters locked-idle spawns=%lu termios=%*u "
+             "hooks=%*u wakeups=%lu", &spawns, &wakeups) != 2) {
+    fprintf(stderr, "vlock-e2e: malformed counters: %s\n", line);
+    return false;
+  }
+
+  if (spawns > IDLE_SPAWNS || wakeups > IDLE_WAKEUPS) {
+    fprintf(stderr, "vlock-e2e: idle budget exceeded: %s\n", line);
+    return false;
+  }
+
+  return true;
+}
+
+/* Get the time vlock-main took to secure the terminal from the output. */
+static bool get_secure_latency(const struct session *s, double *latency)
+{
+  const char *marker = "vlock: time-to-secure-us=";
+  const char *p = memmem(s->output, s->length, marker, strlen(marker));
+  char line[64];
+  long usec;
+
+  if (p == NULL) {
+    fprintf(stderr, "vlock-e2e: vlock-main did not print its time to secure\n");
+    return false;
+  }
+
+  snprintf(line, sizeof line, "%.*s",
+           (int) (s->output + s->length - p), p);
+
+  if (sscanf(line, "vlock: time-to-secure-us=%ld", &usec) != 1) {
+    fprintf(stderr, "vlock-e2e: malformed time to secure: %s\n", line);
+    return false;
+  }
+
+  *latency = usec / 1000.0;
+
+  return true;
+}
+
+static void end_session(struct session *s)
+{
+  if (s->pid > 0) {
+    (void) kill(s->pid, SIGTERM);
+    (void) waitpid(s->pid, NULL, 0);
+    s->pid = -1;
+  }
+
+  (void) close(s->master);
+}
+
+/* Lock and unlock once and store the latency of each phase. */
+static bool run_once(const char *vlock_main, char *const plugins[],
+                     double latency[NR_PHASES])
+{
+  struct session s;
+  double start;
+  bool result = false;
+
+  start = now_ms();
+
+  if (!start_session(&s, vlock_main, plugins))
+    return false;
+
+  if (!wait_for(&s, LOCK_MESSAGE))
+    goto out;
+
+  latency[LOCK_ENGAGED] = now_ms() - start;
+
+  /* Start the screen saver and give the save hooks time to run. */
+  if (write(s.master, "\033", 1) != 1)
+    goto out;
+
+  (void) poll(NULL, 0, TYPING_DELAY_MS);
+  start = now_ms();
+
+  if (write(s.master, " ", 1) != 1 || !wait_for(&s, LOCK_MESSAGE))
+    goto out;
+
+  latency[WAKE_SHOWN] = now_ms() - start;
+
+  start = now_ms();
+
+  if (write(s.master, "\n", 1) != 1 || !wait_for(&s, PROMPT))
+    goto out;
+
+  latency[PROMPT_SHOWN] = now_ms() - start;
+
+  (void) poll(NULL, 0, TYPING_DELAY_MS);
+  start = now_ms();
+
+  if (write(s.master, E2E_PASSWORD "\n", sizeof E2E_PASSWORD) !=
+      sizeof E2E_PASSWORD || !wait_for(&s, NULL))
+    goto out;
+
+  latency[UNLOCK_COMPLETE] = now_ms() - start;
+  result = check_idle_budget(&s)
+           && get_secure_latency(&s, &latency[TERMINAL_SECURED]);
+
+out:
+  end_session(&s);
+  return result;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+/* Look up the baseline for the given combination and phase.  Returns a
+ * negative value if there is none. */
+static double get_baseline(FILE *baselines, const char *combination,
+                           const char *phase)
+{
+  char line[256];
+
+  if (baselines == NULL)
+    return -1;
+
+  rewind(baselines);
+
+  while (fgets(line, sizeof line, baselines) != NULL) {
+    char c[128];
+    char p[64];
+    double ms;
+
+    if (line[0] == '#')
+      continue;
+
+    if (sscanf(line, "%127s %63s %lf", c, p, &ms) == 3
+        && strcmp(c, combination) == 0 && strcmp(p, phase) == 0)
+      return ms;
+  }
+
+  return -1;
+}
+
+static void usage(void)
+{
+  fputs("usage: vlock-e2e [-n runs] [-t tolerance] [-l preload] [-w]\n"
+        "                 baselines vlock-main combination...\n"
+        "\n"
+        "A combination is \"none\" or plugin names joined with \"+\".\n",
+        stderr);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  int runs = 20;
+  double tolerance = 1.5;
+  bool write_baselines = false;
+  const char *baselines_file;
+  const char *vlock_main;
+  FILE *baselines;
+  FILE *new_baselines = NULL;
+  bool failed = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:t:l:w")) != -1) {
+    switch (opt) {
+      case 'n':
+        runs = atoi(optarg);
+        break;
+      case 't':
+        tolerance = atof(optarg);
+        break;
+      case 'l':
+        preload = optarg;
+        break;
+      case 'w':
+        write_baselines = true;
+        break;
+      default:
+        usage();
+    }
+  }
+
+  if (argc - optind < 3 || runs < 1 || tolerance <= 0)
+    usage();
+
+  baselines_file = argv[optind];
+  vlock_main = argv[optind + 1];
+
+  if (write_baselines) {
+    baselines = NULL;
+
+    if ((new_baselines = fopen(baselines_file, "w")) == NULL) {
+      perror("vlock-e2e: could not write baselines");
+      exit(EXIT_FAILURE);
+    }
+
+    fprintf(new_baselines, "# combination phase milliseconds\n");
+  } else {
+    baselines = fopen(baselines_file, "r");
+  }
+
+  if (pipe(sigchld_pipe) < 0) {
+    perror("vlock-e2e: could not create pipe");
+    exit(EXIT_FAILURE);
+  }
+
+  (void) fcntl(sigchld_pipe[1], F_SETFL, O_NONBLOCK);
+  (void) signal(SIGCHLD, sigchld_handler);
+
+  printf("%-24s %-16s %10s %10s %10s\n", "combination", "phase",
+         "median/ms", "p90/ms", "baseline");
+
+  for (int i = optind + 2; i < argc; i++) {
+    const char *combination = argv[i];
+    char names[256];
+    char *plugins[32];
+    size_t nr_plugins = 0;
+    double latency[NR_PHASES][runs];
+
+    /* Split the combination into plugin names. */
+    snprintf(names, sizeof names, "%s", combination);
+
+    if (strcmp(names, "none") != 0)
+      for (char *p = strtok(names, "+"); p != NULL && nr_plugins < 31;
+           p = strtok(NULL, "+"))
+        plugins[nr_plugins++] = p;
+
+    plugins[nr_plugins] = NULL;
+
+    for (int run = 0; run < runs; run++) {
+      double l[NR_PHASES];
+
+      if (!run_once(vlock_main, plugins, l)) {
+        fprintf(stderr, "vlock-e2e: %s: run %d failed\n", combination,
+                run + 1);
+        exit(EXIT_FAILURE);
+      }
+
+      for (int phase = 0; phase < NR_PHASES; phase++)
+        latency[phase][run] = l[phase];
+    }
+
+    for (int phase = 0; phase < NR_PHASES; phase++) {
+      double median;
+      double p90;
+      double baseline;
+
+      qsort(latency[phase], runs, sizeof latency[phase][0], compare_doubles);
+      median = latency[phase][runs / 2];
+      p90 = latency[phase][(runs * 9) / 10 < runs ? (runs * 9) / 10 : runs - 1];
+      baseline = get_baseline(baselines, combination, phase_names[phase]);
+
+      printf("%-24s %-16s %10.3f %10.3f", combination, phase_names[phase],
+             median, p90);
+
+      if (baseline < 0) {
+        printf(" %10s\n", "-");
+      } else if (median > baseline * tolerance + SLACK_MS) {
+        printf(" %10.3f  REGRESSION\n", baseline);
+        failed = true;
+      } else {
+        printf(" %10.3f\n", baseline);
+      }
+
+      if (new_baselines != NULL)
+        fprintf(new_baselines, "%s %s %.3f\n", combination,
+                phase_names[phase], median);
+    }
+  }
+
+  if (baselines != NULL)
+    (void) fclose(baselines);
+
+  if (new_baselines != NULL && fclose(new_baselines) != 0) {
+    perror("vlock-e2e: could not write baselines");
+    exit(EXIT_FAILURE);
+  }
+
+  if (failed) {
+    fprintf(stderr, "vlock-e2e: latency exceeds the baseline by more than "
+            "a factor of %.2f\n", tolerance);
+    exit(EXIT_FAILURE);
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -7,11 +7,33 @@
 #include "test_tsort.h"
 #include "test_util.h"
 #include "test_process.h"
+#include "test_rcfile.h"
+#include "test_status.h"
+#include "test_logging.h"
+#include "test_prompt.h"
+#include "test_plugin.h"
+#include "test_plugins.h"
+#include "test_synthetic.h"
+#include "test_counters.h"
+#include "test_manifest.h"
+#include "test_output.h"
+#include "test_memory.h"
 
 CU_SuiteInfo vlock_test_suites[] = {
   { "test_tsort", NULL, NULL, tsort_tests },
   { "test_util", NULL, NULL, util_tests },
   { "test_process", NULL, NULL, process_tests },
+  { "test_rcfile", NULL, NULL, rcfile_tests },
+  { "test_status", NULL, NULL, status_tests },
+  { "test_logging", NULL, NULL, logging_tests },
+  { "test_prompt", NULL, NULL, prompt_tests },
+  { "test_plugin", NULL, NULL, plugin_tests },
+  { "test_plugins", NULL, NULL, plugins_tests },
+  { "test_synthetic", NULL, NULL, synthetic_tests },
+  { "test_counters", NULL, NULL, counters_tests },
+  { "test_manifest", NULL, NULL, manifest_tests },
+  { "test_output", NULL, NULL, output_tests },
+  { "test_memory", NULL, NULL, memory_tests },
   CU_SUITE_INFO_NULL,
 };
 